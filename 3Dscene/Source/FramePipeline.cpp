@@ -0,0 +1,224 @@
+///////////////////////////////////////////////////////////////////////////////
+// framepipeline.cpp
+// ============
+// runs the camera and animation on a simulation thread one frame ahead of
+// the main thread, which only gathers input and submits to OpenGL; each
+// simulated frame is handed over as a snapshot through a triple buffer
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FramePipeline.h"
+
+#include <chrono>
+
+namespace
+{
+    // how long the simulation thread sleeps while the main
+    // thread hasn't taken the last snapshot yet
+    const std::chrono::microseconds g_SimulationWait(200);
+
+    // input with no keys held and no mouse movement
+    ViewManager::VIEW_INPUT NoInput()
+    {
+        ViewManager::VIEW_INPUT input = ViewManager::VIEW_INPUT();
+        return input;
+    }
+}
+
+/***********************************************************
+ *  FramePipeline()
+ *
+ *  The constructor for the class.
+ ***********************************************************/
+FramePipeline::FramePipeline(ViewManager* pViewManager)
+    : m_bStopping(false)
+{
+    m_pViewManager = pViewManager;
+    m_pendingInput = NoInput();
+    m_bHasSnapshot = false;
+    m_repeatedFrames = 0;
+    m_simulatedFrames = 0;
+}
+
+/***********************************************************
+ *  ~FramePipeline()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+FramePipeline::~FramePipeline()
+{
+    Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  Starts the simulation thread, which begins on the first
+ *  snapshot right away.
+ ***********************************************************/
+void FramePipeline::Start()
+{
+    if (m_thread.joinable())
+    {
+        return;
+    }
+
+    m_bStopping = false;
+    m_thread = std::thread(&FramePipeline::SimulationLoop, this);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  Stops the simulation thread and waits for it to finish
+ *  the frame it is on.
+ ***********************************************************/
+void FramePipeline::Stop()
+{
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+
+    m_bStopping = true;
+    m_thread.join();
+}
+
+/***********************************************************
+ *  SubmitInput()
+ *
+ *  Hands input over to the simulation thread. Input is only
+ *  published once the previous input was taken, so mouse
+ *  movement keeps adding up instead of being replaced.
+ ***********************************************************/
+void FramePipeline::SubmitInput(const ViewManager::VIEW_INPUT& input)
+{
+    float mouseXOffset = m_pendingInput.mouseXOffset + input.mouseXOffset;
+    float mouseYOffset = m_pendingInput.mouseYOffset + input.mouseYOffset;
+    float scrollOffset = m_pendingInput.scrollOffset + input.scrollOffset;
+
+    // the keys held now replace the ones sampled before
+    m_pendingInput = input;
+    m_pendingInput.mouseXOffset = mouseXOffset;
+    m_pendingInput.mouseYOffset = mouseYOffset;
+    m_pendingInput.scrollOffset = scrollOffset;
+
+    if (!m_input.IsConsumed())
+    {
+        return;
+    }
+
+    m_input.GetWriteBuffer() = m_pendingInput;
+    m_input.Publish();
+
+    m_pendingInput.mouseXOffset = 0.0f;
+    m_pendingInput.mouseYOffset = 0.0f;
+    m_pendingInput.scrollOffset = 0.0f;
+}
+
+/***********************************************************
+ *  ApplyLatestFrame()
+ *
+ *  Takes the newest snapshot and passes it on to the view
+ *  and scene. When the simulation has not finished a new
+ *  one, the last snapshot is drawn again rather than
+ *  holding up the frame.
+ ***********************************************************/
+void FramePipeline::ApplyLatestFrame(SceneManager* pSceneManager)
+{
+    bool bNewSnapshot = m_snapshots.Acquire();
+    while (!bNewSnapshot && !m_bHasSnapshot)
+    {
+        std::this_thread::yield();
+        bNewSnapshot = m_snapshots.Acquire();
+    }
+    m_bHasSnapshot = true;
+
+    if (!bNewSnapshot)
+    {
+        m_repeatedFrames++;
+    }
+
+    const FRAME_SNAPSHOT& frame = m_snapshots.GetReadBuffer();
+
+    m_pViewManager->SetShaderView(frame.view, frame.projection, frame.viewPosition);
+    pSceneManager->SetViewParameters(frame.view, frame.projection, frame.viewPosition);
+    pSceneManager->SetPointLightPositions(frame.pointLightPositions);
+
+    // the moves were made since the previous snapshot, which
+    // has already been applied
+    if (bNewSnapshot)
+    {
+        for (size_t i = 0; i < frame.movedObjects.size(); i++)
+        {
+            pSceneManager->SetObjectTransform(frame.movedObjects[i].objectIndex, frame.movedObjects[i].modelMatrix);
+        }
+    }
+}
+
+/***********************************************************
+ *  SimulationLoop()
+ *
+ *  This method is run by the simulation thread. It stays one
+ *  snapshot ahead: the next frame is simulated as soon as
+ *  the main thread takes the last one, so it is ready by the
+ *  time the main thread is done submitting. Every snapshot
+ *  is taken, so no object moves are lost.
+ ***********************************************************/
+void FramePipeline::SimulationLoop()
+{
+    ViewManager::VIEW_INPUT input = NoInput();
+    double lastTime = glfwGetTime();
+
+    while (!m_bStopping)
+    {
+        if (!m_snapshots.IsConsumed())
+        {
+            std::this_thread::sleep_for(g_SimulationWait);
+            continue;
+        }
+
+        if (m_input.Acquire())
+        {
+            input = m_input.GetReadBuffer();
+        }
+
+        // glfwGetTime() may be called from any thread
+        double time = glfwGetTime();
+        float deltaTime = (float)(time - lastTime);
+        lastTime = time;
+
+        SimulateFrame(input, time, deltaTime, m_snapshots.GetWriteBuffer());
+        m_snapshots.Publish();
+
+        // the keys stay held until new input says otherwise,
+        // but the mouse movement has been used up
+        input.mouseXOffset = 0.0f;
+        input.mouseYOffset = 0.0f;
+        input.scrollOffset = 0.0f;
+    }
+}
+
+/***********************************************************
+ *  SimulateFrame()
+ *
+ *  Moves the camera and the lights to where they are at the
+ *  given time, and writes them into a snapshot.
+ ***********************************************************/
+void FramePipeline::SimulateFrame(const ViewManager::VIEW_INPUT& input, double time, float deltaTime, FRAME_SNAPSHOT& frame)
+{
+    m_pViewManager->UpdateCamera(input, deltaTime);
+
+    frame.frameNumber = ++m_simulatedFrames;
+    frame.view = m_pViewManager->GetViewMatrix();
+    frame.projection = m_pViewManager->GetProjectionMatrix();
+    frame.viewPosition = m_pViewManager->GetViewPosition();
+
+    SceneManager::AnimatePointLights(time, frame.pointLightPositions);
+
+    // none of the scene objects are animated yet; animations
+    // add the objects they move here, and the snapshot's
+    // storage is reused so that doesn't allocate every frame
+    frame.movedObjects.clear();
+}
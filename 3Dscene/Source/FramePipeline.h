@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+// framepipeline.h
+// ============
+// runs the camera and animation on a simulation thread one frame ahead of
+// the main thread, which only gathers input and submits to OpenGL; each
+// simulated frame is handed over as a snapshot through a triple buffer
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ViewManager.h"
+#include "SceneManager.h"
+#include "TripleBuffer.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class FramePipeline
+{
+public:
+	// constructor
+	FramePipeline(ViewManager* pViewManager);
+	// destructor, stops the simulation thread
+	~FramePipeline();
+
+	// a scene object moved by the simulation
+	struct OBJECT_TRANSFORM
+	{
+		int objectIndex;
+		glm::mat4 modelMatrix;
+	};
+
+	// everything the main thread needs from one simulated frame;
+	// it is not changed again once it has been handed over
+	struct FRAME_SNAPSHOT
+	{
+		unsigned int frameNumber;
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec3 viewPosition;
+		glm::vec3 pointLightPositions[SceneManager::TOTAL_POINT_LIGHTS];
+		// objects moved since the previous snapshot
+		std::vector<OBJECT_TRANSFORM> movedObjects;
+	};
+
+	// start and stop the simulation thread; while it runs, the
+	// camera belongs to it, so ViewManager::PrepareSceneView()
+	// must not be called
+	void Start();
+	void Stop();
+
+	// main thread: hand over the input sampled for this frame
+	void SubmitInput(const ViewManager::VIEW_INPUT& input);
+	// main thread: send the latest snapshot to the shaders and
+	// the scene, waiting only before the first one exists
+	void ApplyLatestFrame(SceneManager* pSceneManager);
+
+	// frames the main thread drew again from an old snapshot,
+	// because the simulation had not finished the next one
+	int GetRepeatedFrames() const { return m_repeatedFrames; }
+
+private:
+	ViewManager* m_pViewManager;
+	std::thread m_thread;
+	std::atomic<bool> m_bStopping;
+
+	// main thread to simulation thread
+	TripleBuffer<ViewManager::VIEW_INPUT> m_input;
+	// input sampled since the simulation thread last took some
+	ViewManager::VIEW_INPUT m_pendingInput;
+
+	// simulation thread to main thread
+	TripleBuffer<FRAME_SNAPSHOT> m_snapshots;
+	bool m_bHasSnapshot;
+	int m_repeatedFrames;
+
+	// frames simulated so far, numbering the snapshots
+	unsigned int m_simulatedFrames;
+
+	// the loop run by the simulation thread
+	void SimulationLoop();
+	// simulate one frame into a snapshot
+	void SimulateFrame(const ViewManager::VIEW_INPUT& input, double time, float deltaTime, FRAME_SNAPSHOT& frame);
+};
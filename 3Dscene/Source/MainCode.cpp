@@ -11,6 +11,7 @@
 
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -24,6 +25,8 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "GLStateCache.h"
+#include "FramePipeline.h"
 
 // Namespace for declaring global variables
 namespace
@@ -40,6 +43,8 @@ namespace
     ShaderManager* g_ShaderManager = nullptr;
     // view manager object for managing the 3D view setup and projection to 2D
     ViewManager* g_ViewManager = nullptr;
+    // simulates the next frame while the current one is drawn
+    FramePipeline* g_FramePipeline = nullptr;
 }
 
 // Function declarations - all functions that are called manually
@@ -56,6 +61,16 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+    // benchmark the object tree instead of running the scene
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--benchmark-object-tree") == 0)
+        {
+            SceneManager::BenchmarkObjectTree();
+            return(EXIT_SUCCESS);
+        }
+    }
+
     // if GLFW fails initialization, then terminate the application
     if (InitializeGLFW() == false)
     {
@@ -84,7 +99,8 @@ int main(int argc, char* argv[])
     // load the shader code from the external GLSL files
     GLuint ShaderProgramID = g_ShaderManager->LoadShaders(
         "shaders/vertexShader.glsl",
-        "shaders/fragmentShader.glsl");
+        "shaders/fragmentShader.glsl",
+        SceneManager::GetShaderDefines().c_str());
 
     g_ShaderManager->use();
 
@@ -92,19 +108,37 @@ int main(int argc, char* argv[])
     g_SceneManager = new SceneManager(g_ShaderManager, screenWidth, screenHeight, ShaderProgramID);
     g_SceneManager->PrepareScene();
 
+    // the camera and the light animation move to the simulation
+    // thread from here on, leaving this thread the OpenGL calls
+    g_FramePipeline = new FramePipeline(g_ViewManager);
+    g_FramePipeline->Start();
+
     // loop will keep running until the application is closed 
     // or until an error has occurred
+    int frameCount = 0;
     while (!glfwWindowShouldClose(g_Window))
     {
+        GLStateCache& stateCache = GLStateCache::Get();
+        stateCache.BeginFrame();
+        // report the second frame, the first one that reuses
+        // the cached shadow map and the state left by setup
+        if (++frameCount == 3)
+        {
+            std::cout << "GL state cache: " << stateCache.GetIssuedCalls() << " calls issued, "
+                << stateCache.GetElidedCalls() << " redundant calls skipped" << std::endl;
+        }
+
         // Enable z-depth
-        glEnable(GL_DEPTH_TEST);
+        stateCache.SetEnabled(GL_DEPTH_TEST, true);
 
         // Clear the frame and z buffers
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // convert from 3D object space to 2D view
-        g_ViewManager->PrepareSceneView();
+        // hand the input to the simulation thread for the next
+        // frame, and draw the frame it has already simulated
+        g_FramePipeline->SubmitInput(g_ViewManager->SampleInput());
+        g_FramePipeline->ApplyLatestFrame(g_SceneManager);
 
         // refresh the 3D scene
         g_SceneManager->RenderSceneWithShadows();
@@ -116,6 +150,17 @@ int main(int argc, char* argv[])
         glfwPollEvents();
     }
 
+    // the simulation thread uses the view manager, so it has
+    // to stop before anything is deleted
+    if (NULL != g_FramePipeline)
+    {
+        g_FramePipeline->Stop();
+        std::cout << "Frame pipeline: " << g_FramePipeline->GetRepeatedFrames()
+            << " frames drawn again while the simulation caught up" << std::endl;
+        delete g_FramePipeline;
+        g_FramePipeline = NULL;
+    }
+
     // clear the allocated manager objects from memory
     if (NULL != g_SceneManager)
     {
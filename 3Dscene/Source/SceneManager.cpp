@@ -10,6 +10,8 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
+#include "GLStateCache.h"
+#include "JobSystem.h"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -19,6 +21,13 @@
 #include <glm/gtx/transform.hpp>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
 #define VERTEX_SHADER_PATH "path/to/vertex_shader.vs"
 constexpr auto FRAGMENT_SHADER_PATH = "path/to/fragment_shader.fs";
 
@@ -26,12 +35,93 @@ constexpr auto FRAGMENT_SHADER_PATH = "path/to/fragment_shader.fs";
 namespace
 {
 	const char* g_ModelName = "model";
+
+	// projected radius, in pixels, an object needs to be drawn
+	// at each level of detail but the coarsest
+	const float g_LodPixelRadius[MeshLibrary::LOD_COUNT - 1] = { 48.0f, 16.0f };
+	// how far past a threshold the projected radius has to go
+	// before the level changes, so it doesn't flicker on the edge
+	const float g_LodHysteresis = 0.15f;
 	const char* g_ColorValueName = "objectColor";
-	const char* g_TextureValueName = "objectTexture";
+	const char* g_TextureValueName = "objectTextures";
+	const char* g_TextureLayerName = "textureLayer";
 	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
-	constexpr int TOTAL_LIGHTS = 6; // Updated to include new lights
+	const char* g_UseInstancingName = "bUseInstancing";
 	const char* g_ShadowMapName = "shadowMap";
+	const char* g_CascadeMatricesName = "cascadeMatrices";
+	const char* g_CascadeSplitsName = "cascadeSplits";
+	const char* g_PointShadowMapName = "pointShadowMaps";
+	const char* g_PointShadowMatricesName = "pointShadowMatrices";
+	const char* g_PointShadowMaskName = "pointShadowMask";
+	const char* g_FaceCountName = "faceCount";
+	const char* g_FaceLayersName = "faceLayers";
+	const char* g_FaceMatricesName = "faceMatrices";
+	const char* g_LightBlockName = "LightBlock";
+	const char* g_MaterialBlockName = "MaterialBlock";
+	const char* g_MaterialIndexName = "materialIndex";
+	const char* g_UseMultiDrawName = "bUseMultiDraw";
+	const char* g_DrawBaseName = "drawBase";
+
+	// uniform buffer binding point of the light block
+	const GLuint g_LightBlockBinding = 0;
+	// uniform buffer binding point of the material table
+	const GLuint g_MaterialBlockBinding = 1;
+	// texture units of the scene's texture array, the shadow map
+	// and the point lights' shadow maps
+	const GLuint g_TextureArrayUnit = 0;
+	const GLuint g_ShadowMapUnit = 1;
+	const GLuint g_PointShadowUnit = 2;
+
+	// program values used in the render queue sort keys
+	const unsigned int g_BasicProgram = 0;
+	const unsigned int g_InstancedProgram = 1;
+	const unsigned int g_StaticProgram = 2;
+	// distance that maps to the far end of the queue's depth range
+	const float g_QueueDepthRange = 100.0f;
+	// single objects culled and queued by each job
+	const size_t g_ObjectsPerJob = 64;
+	// the jobs that start each frame's render queue, once the
+	// objects are culled against the camera, ending with one
+	// per shadow cascade
+	enum CULL_JOB
+	{
+		CULL_CAMERA_BATCHES = 0,
+		RENDER_OCCLUDERS,
+		CULL_FIRST_CASCADE,
+		CULL_JOB_COUNT = CULL_FIRST_CASCADE + SceneManager::SHADOW_CASCADES
+	};
+	// each cascade is drawn in a render queue pass of its own,
+	// followed by the pass of the point lights' cube shadows
+	static_assert(SceneManager::SHADOW_CASCADES + 1 <= RenderQueue::MAX_SHADOW_VIEWS,
+		"the render queue has too few shadow passes for the cascades");
+	const RenderQueue::RENDER_PASS g_PointShadowPass =
+		(RenderQueue::RENDER_PASS)(RenderQueue::PASS_SHADOW + SceneManager::SHADOW_CASCADES);
+	// size of each cube face of the point light shadows
+	const unsigned int g_PointShadowSize = 256;
+	// depth range of the cube faces, which covers about as far
+	// as the point lights reach
+	const float g_PointShadowNear = 0.1f;
+	const float g_PointShadowFar = 25.0f;
+	// cube faces rendered each frame, whatever the number of
+	// moving lights
+	const int g_PointShadowFaceBudget = 4;
+	// view space distance the shadow cascades reach out to
+	const float g_ShadowDistance = 40.0f;
+	// blend of logarithmic (1) and even (0) cascade splits
+	const float g_CascadeSplitLambda = 0.75f;
+	// step the cascade radii are rounded up to, so rounding
+	// errors can't change a cascade's size from frame to frame
+	const float g_CascadeRadiusStep = 1.0f / 16.0f;
+	// step the near and far planes of the cascades are moved
+	// out to, so small camera moves don't change them
+	const float g_CascadeDepthStep = 0.5f;
+	// filtered shadow map fetches per side of the PCF kernel;
+	// each covers 2 x 2 texels, so 2 filters 3 x 3 texels
+	const int g_ShadowFilterSize = 2;
+	// bytes of the frame ring buffer given to each frame, enough
+	// for the light block and a few thousand multi-draw draws
+	const size_t g_FrameRingSize = 256 * 1024;
 }
 
 /***********************************************************
@@ -43,28 +133,113 @@ SceneManager::SceneManager(ShaderManager* pShaderManager, unsigned int screenWid
 	: m_ScreenWidth(screenWidth), m_ScreenHeight(screenHeight), m_ShaderProgramID(shaderProgramID)
 {
 	m_pShaderManager = pShaderManager;
+	m_pDepthShaderManager = new ShaderManager();
+	m_pPointShadowShaderManager = new ShaderManager();
 	m_basicMeshes = new ShapeMeshes();
-	m_loadedTextures = 0;
+	m_instancedMeshes = new MeshLibrary();
+
+	// each shadow cascade is rendered on the first frame, then
+	// only again when the light, a shadow caster or the part
+	// of the view it covers moves
+	m_shadowLightPosition = glm::vec3(0.0f, 14.0f, -9.85f);
+	m_shadowLightTarget = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_bShadowMapDirty = true;
+	m_bInstanceBatchesDirty = false;
+	m_bStaticBatchesDirty = false;
+	m_bReportedQueueStats = false;
+	m_viewMatrix = glm::mat4(1.0f);
+	m_projectionMatrix = glm::mat4(1.0f);
+	m_viewPosition = glm::vec3(0.0f);
+	m_lightBlockBuffer = 0;
+	m_bLightBlockDirty = false;
+	m_bLightBlockInRing = false;
+	m_materialBlockBuffer = 0;
+	m_lightBlock = LIGHT_BLOCK();
+	m_bUseMultiDraw = false;
+	m_culledMainDraws = 0;
+	m_culledShadowDraws = 0;
+	m_occludedDraws = 0;
+	m_bObjectTreeDirty = true;
+	m_bRecordingDirty = true;
+	m_recordedViewMatrix = glm::mat4(1.0f);
+	m_recordedProjectionMatrix = glm::mat4(1.0f);
+	for (int lod = 0; lod < MeshLibrary::LOD_COUNT; lod++)
+	{
+		m_lodTriangles[lod] = 0;
+	}
+	for (int cascade = 0; cascade < SHADOW_CASCADES; cascade++)
+	{
+		m_cascadeMatrices[cascade] = glm::mat4(1.0f);
+		m_cascadeCullMatrices[cascade] = glm::mat4(1.0f);
+		m_cascadeSplits[cascade] = 0.0f;
+		m_bCascadeDirty[cascade] = true;
+	}
 
-	// Shadow map setup
-	const GLuint SHADOW_WIDTH = 2048, SHADOW_HEIGHT = 2048;
+	// Shadow map setup, one layer for each cascade
 	glGenFramebuffers(1, &depthMapFBO);
 
 	glGenTextures(1, &depthMap);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	GLStateCache::Get().BindTexture(g_ShadowMapUnit, GL_TEXTURE_2D_ARRAY, depthMap);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, SHADOW_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	// the texture unit compares the depths itself and filters
+	// the results of the four nearest texels, so each fetch
+	// of the shadow sampler is already a 2 x 2 PCF
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
 	float borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+	// the cascade being rendered is attached in its place
+	// before each one is drawn
+	GLStateCache::Get().BindFramebuffer(depthMapFBO);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMap, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	// Point light shadow setup, six faces per light, stored as
+	// layers of a 2D array rather than cube maps, since cube map
+	// arrays need a newer context than the 3.3 one on macOS
+	for (int i = 0; i < TOTAL_POINT_LIGHTS; i++)
+	{
+		m_bPointLightShadow[i] = false;
+	}
+	for (int layer = 0; layer < TOTAL_POINT_LIGHTS * PointShadowScheduler::FACE_COUNT; layer++)
+	{
+		m_pointShadowMatrices[layer] = glm::mat4(1.0f);
+	}
+	m_bPointShadowMatricesDirty = true;
+	m_pointShadowScheduler.Resize(TOTAL_POINT_LIGHTS);
+
+	glGenTextures(1, &m_pointShadowMap);
+	GLStateCache::Get().BindTexture(g_PointShadowUnit, GL_TEXTURE_2D_ARRAY, m_pointShadowMap);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, g_PointShadowSize, g_PointShadowSize,
+		TOTAL_POINT_LIGHTS * PointShadowScheduler::FACE_COUNT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// the geometry shader picks the layer of every triangle
+	glGenFramebuffers(1, &m_pointShadowFBO);
+	GLStateCache::Get().BindFramebuffer(m_pointShadowFBO);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_pointShadowMap, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
+	// clearing the layered framebuffer would clear every face,
+	// so the faces are cleared one at a time through this one
+	glGenFramebuffers(1, &m_pointShadowClearFBO);
+	GLStateCache::Get().BindFramebuffer(m_pointShadowClearFBO);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_pointShadowMap, 0, 0);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLStateCache::Get().BindFramebuffer(0);
 }
 
 /***********************************************************
@@ -75,154 +250,65 @@ SceneManager::SceneManager(ShaderManager* pShaderManager, unsigned int screenWid
 SceneManager::~SceneManager()
 {
 	m_pShaderManager = NULL;
+	delete m_pDepthShaderManager;
+	m_pDepthShaderManager = NULL;
+	delete m_pPointShadowShaderManager;
+	m_pPointShadowShaderManager = NULL;
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
-}
-
-/***********************************************************
- *  CreateGLTexture()
- *
- *  Loads textures from files because plain colors are boring.
- ***********************************************************/
-bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
-{
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
-
-	// Flip the image, because it was upside down. Thanks, stbi.
-	stbi_set_flip_vertically_on_load(true);
 
-	// Load the image, because blank textures are no fun.
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
-
-	// Check if image loading was a success. If not, we'll just cry in a corner.
-	if (image)
+	for (size_t i = 0; i < m_instanceBatches.size(); i++)
 	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
-
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// Because texture wrapping is a thing.
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// Because blurry textures are just ugly.
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// Determine the format and load the image.
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
-		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
-		}
-
-		// Generate mipmaps, because they're the cool thing to do.
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// Free up the image memory.
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0);
-
-		// Store the texture with a tag, like a librarian with a fetish for textures.
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
-
-		return true;
+		m_instancedMeshes->DestroyInstanceBuffer(m_instanceBatches[i].instanceBuffer);
 	}
-
-	std::cout << "Could not load image:" << filename << std::endl;
-
-	return false;
-}
-
-/***********************************************************
- *  BindGLTextures()
- *
- *  Binds loaded textures, so OpenGL knows what's up.
- ***********************************************************/
-void SceneManager::BindGLTextures()
-{
-	for (int i = 0; i < m_loadedTextures; i++)
+	m_instanceBatches.clear();
+	for (size_t i = 0; i < m_staticBatches.size(); i++)
 	{
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		m_instancedMeshes->DestroyInstanceBuffer(m_staticBatches[i].instanceBuffer);
 	}
-}
+	m_staticBatches.clear();
+	delete m_instancedMeshes;
+	m_instancedMeshes = NULL;
 
-/***********************************************************
- *  DestroyGLTextures()
- *
- *  Frees up texture memory, because we care about memory leaks.
- ***********************************************************/
-void SceneManager::DestroyGLTextures()
-{
-	for (int i = 0; i < m_loadedTextures; i++)
+	if (m_lightBlockBuffer != 0)
 	{
-		glDeleteTextures(1, &m_textureIDs[i].ID);
+		glDeleteBuffers(1, &m_lightBlockBuffer);
+		m_lightBlockBuffer = 0;
 	}
-}
-
-/***********************************************************
- *  FindTextureID()
- *
- *  Gets the ID of a texture by tag. It's like a treasure hunt.
- ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
-{
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	if (m_materialBlockBuffer != 0)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
-		}
-		else
-			index++;
+		glDeleteBuffers(1, &m_materialBlockBuffer);
+		m_materialBlockBuffer = 0;
 	}
 
-	return(textureID);
+	if (m_pointShadowMap != 0)
+	{
+		GLStateCache::Get().ForgetTexture(m_pointShadowMap);
+		glDeleteTextures(1, &m_pointShadowMap);
+		m_pointShadowMap = 0;
+	}
+	if (m_pointShadowFBO != 0)
+	{
+		glDeleteFramebuffers(1, &m_pointShadowFBO);
+		m_pointShadowFBO = 0;
+	}
+	if (m_pointShadowClearFBO != 0)
+	{
+		glDeleteFramebuffers(1, &m_pointShadowClearFBO);
+		m_pointShadowClearFBO = 0;
+	}
 }
 
 /***********************************************************
- *  FindTextureSlot()
+ *  BindGLTextures()
  *
- *  Finds the slot index for a texture by tag. Slots are important.
+ *  Binds the texture array holding every scene texture.
+ *  It has texture unit 0 to itself, so it never collides
+ *  with the shadow map on unit 1.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+void SceneManager::BindGLTextures()
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
-	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureSlot = index;
-			bFound = true;
-		}
-		else
-			index++;
-	}
-
-	return(textureSlot);
+	m_textureArray.Bind(g_TextureArrayUnit);
 }
 
 /***********************************************************
@@ -240,6 +326,7 @@ void SceneManager::DefineObjectMaterials()
 	defaultMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	defaultMaterial.shininess = 32.0f;
 	defaultMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	defaultMaterial.bUseTexture = false;
 
 	m_objectMaterials.push_back(defaultMaterial);
 
@@ -251,6 +338,7 @@ void SceneManager::DefineObjectMaterials()
 	glowingOrangeMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	glowingOrangeMaterial.shininess = 32.0f;
 	glowingOrangeMaterial.emissiveColor = glm::vec3(1.0f, 0.5f, 0.0f);
+	glowingOrangeMaterial.bUseTexture = false;
 
 	m_objectMaterials.push_back(glowingOrangeMaterial);
 
@@ -262,6 +350,7 @@ void SceneManager::DefineObjectMaterials()
 	floorMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	floorMaterial.shininess = 32.0f;
 	floorMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	floorMaterial.bUseTexture = true;
 
 	m_objectMaterials.push_back(floorMaterial);
 
@@ -273,6 +362,7 @@ void SceneManager::DefineObjectMaterials()
 	wallMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	wallMaterial.shininess = 32.0f;
 	wallMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	wallMaterial.bUseTexture = true;
 
 	m_objectMaterials.push_back(wallMaterial);
 
@@ -284,6 +374,7 @@ void SceneManager::DefineObjectMaterials()
 	ceilingMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	ceilingMaterial.shininess = 32.0f;
 	ceilingMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	ceilingMaterial.bUseTexture = true;
 
 	m_objectMaterials.push_back(ceilingMaterial);
 
@@ -295,6 +386,7 @@ void SceneManager::DefineObjectMaterials()
 	glowingBeamMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	glowingBeamMaterial.shininess = 32.0f;
 	glowingBeamMaterial.emissiveColor = glm::vec3(1.0f, 0.5f, 0.0f);
+	glowingBeamMaterial.bUseTexture = false;
 
 	m_objectMaterials.push_back(glowingBeamMaterial);
 
@@ -306,6 +398,7 @@ void SceneManager::DefineObjectMaterials()
 	sofaMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	sofaMaterial.shininess = 32.0f;
 	sofaMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	sofaMaterial.bUseTexture = true;
 
 	m_objectMaterials.push_back(sofaMaterial);
 
@@ -317,6 +410,7 @@ void SceneManager::DefineObjectMaterials()
 	sofaFeetMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	sofaFeetMaterial.shininess = 32.0f;
 	sofaFeetMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	sofaFeetMaterial.bUseTexture = false;
 
 	m_objectMaterials.push_back(sofaFeetMaterial);
 
@@ -328,6 +422,7 @@ void SceneManager::DefineObjectMaterials()
 	rugMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	rugMaterial.shininess = 32.0f;
 	rugMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	rugMaterial.bUseTexture = true;
 	rugMaterial.tint = glm::vec3(0.9f, 0.9f, 0.9f);
 
 	m_objectMaterials.push_back(rugMaterial);
@@ -340,6 +435,7 @@ void SceneManager::DefineObjectMaterials()
 	drawerMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	drawerMaterial.shininess = 32.0f;
 	drawerMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	drawerMaterial.bUseTexture = false;
 
 	m_objectMaterials.push_back(drawerMaterial);
 
@@ -351,6 +447,7 @@ void SceneManager::DefineObjectMaterials()
 	spaceHeaterMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	spaceHeaterMaterial.shininess = 32.0f;
 	spaceHeaterMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	spaceHeaterMaterial.bUseTexture = false;
 
 	m_objectMaterials.push_back(spaceHeaterMaterial);
 
@@ -362,6 +459,8 @@ void SceneManager::DefineObjectMaterials()
 	windowGlassMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	windowGlassMaterial.shininess = 32.0f;
 	windowGlassMaterial.emissiveColor = glm::vec3(0.7f, 0.7f, 0.7f);
+	windowGlassMaterial.bUseTexture = false;
+	windowGlassMaterial.bTransparent = true;
 
 	m_objectMaterials.push_back(windowGlassMaterial);
 
@@ -374,6 +473,7 @@ void SceneManager::DefineObjectMaterials()
 	windowMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	windowMaterial.shininess = 0.0f;
 	windowMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	windowMaterial.bUseTexture = false;
 
 	m_objectMaterials.push_back(windowMaterial);
 
@@ -385,6 +485,7 @@ void SceneManager::DefineObjectMaterials()
 	beamMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	beamMaterial.shininess = 32.0f;
 	beamMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	beamMaterial.bUseTexture = false;
 
 	m_objectMaterials.push_back(beamMaterial);
 
@@ -396,6 +497,7 @@ void SceneManager::DefineObjectMaterials()
 	lampMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	lampMaterial.shininess = 100.0f;
 	lampMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	lampMaterial.bUseTexture = false;
 
 	m_objectMaterials.push_back(lampMaterial);
 
@@ -407,6 +509,7 @@ void SceneManager::DefineObjectMaterials()
 	lamplitMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	lamplitMaterial.shininess = 10.0f;
 	lamplitMaterial.emissiveColor = glm::vec3(1.0f, 0.6f, 0.4f); // Pinkish-orange emissive color
+	lamplitMaterial.bUseTexture = false;
 
 	m_objectMaterials.push_back(lamplitMaterial);
 
@@ -419,6 +522,7 @@ void SceneManager::DefineObjectMaterials()
 	frameMaterial.specularColor = glm::vec3(0.5f, 0.5f, 0.5f);
 	frameMaterial.shininess = 0.0f;
 	frameMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	frameMaterial.bUseTexture = false;
 	m_objectMaterials.push_back(frameMaterial);
 
 	// Define canvas material
@@ -430,6 +534,7 @@ void SceneManager::DefineObjectMaterials()
 	canvasMaterial.specularColor = glm::vec3(0.5f, 0.5f, 0.5f);
 	canvasMaterial.shininess = 0.0f;
 	canvasMaterial.emissiveColor = glm::vec3(0.01f, 0.01f, 0.01f);
+	canvasMaterial.bUseTexture = false;
 	m_objectMaterials.push_back(canvasMaterial);
 
 	OBJECT_MATERIAL potMaterial;
@@ -440,6 +545,7 @@ void SceneManager::DefineObjectMaterials()
 	potMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f); // White specular for high shine
 	potMaterial.shininess = 64.0f; // Higher shininess for more gloss
 	potMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	potMaterial.bUseTexture = false;
 
 
 	m_objectMaterials.push_back(potMaterial);
@@ -452,6 +558,7 @@ void SceneManager::DefineObjectMaterials()
 	stemMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
 	stemMaterial.shininess = 16.0f;
 	stemMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	stemMaterial.bUseTexture = false;
 
 	m_objectMaterials.push_back(stemMaterial);
 
@@ -463,6 +570,7 @@ void SceneManager::DefineObjectMaterials()
 	leafMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
 	leafMaterial.shininess = 16.0f;
 	leafMaterial.emissiveColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	leafMaterial.bUseTexture = false;
 
 	m_objectMaterials.push_back(leafMaterial);
 
@@ -475,32 +583,76 @@ void SceneManager::DefineObjectMaterials()
  ***********************************************************/
 bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
 {
-	if (m_objectMaterials.size() == 0)
+	int index = FindMaterialIndex(tag);
+	if (index < 0)
 	{
 		return(false);
 	}
 
-	size_t index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
+	material = m_objectMaterials[index];
+	return(true);
+}
+
+/***********************************************************
+ *  FindMaterialIndex()
+ *
+ *  Finds the index of a defined material by tag, or -1.
+ ***********************************************************/
+int SceneManager::FindMaterialIndex(std::string tag)
+{
+	std::map<std::string, int>::const_iterator found = m_materialIndices.find(tag);
+	if (found == m_materialIndices.end())
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
-		{
-			bFound = true;
-			material.ambientColor = m_objectMaterials[index].ambientColor;
-			material.ambientStrength = m_objectMaterials[index].ambientStrength;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
-			material.emissiveColor = m_objectMaterials[index].emissiveColor; // Add emissive color to the return value
-		}
-		else
-		{
-			index++;
-		}
+		return(-1);
 	}
 
-	return(true);
+	return(found->second);
+}
+
+/***********************************************************
+ *  UploadObjectMaterials()
+ *
+ *  Packs every defined material into the material table
+ *  uniform buffer. Objects then only need to pass the
+ *  index of their material to the shader.
+ ***********************************************************/
+void SceneManager::UploadObjectMaterials()
+{
+	if (m_objectMaterials.size() > MAX_MATERIALS)
+	{
+		std::cout << "Too many materials defined, only the first "
+			<< MAX_MATERIALS << " will be used" << std::endl;
+	}
+
+	std::vector<MATERIAL_DATA> materialTable(MAX_MATERIALS, MATERIAL_DATA());
+	m_materialIndices.clear();
+	for (size_t index = 0; (index < m_objectMaterials.size()) && (index < MAX_MATERIALS); index++)
+	{
+		const OBJECT_MATERIAL& material = m_objectMaterials[index];
+		materialTable[index].diffuseColor = material.diffuseColor;
+		materialTable[index].shininess = material.shininess;
+		materialTable[index].specularColor = material.specularColor;
+		materialTable[index].emissiveColor = material.emissiveColor;
+
+		// the first material defined with a tag wins
+		m_materialIndices.insert(std::make_pair(material.tag, (int)index));
+	}
+
+	if (m_materialBlockBuffer == 0)
+	{
+		glGenBuffers(1, &m_materialBlockBuffer);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, m_materialBlockBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(MATERIAL_DATA) * MAX_MATERIALS, &materialTable[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, g_MaterialBlockBinding, m_materialBlockBuffer);
+
+	GLint blockSize = m_pShaderManager->setUniformBlockBinding(g_MaterialBlockName, g_MaterialBlockBinding);
+	if (blockSize != (GLint)(sizeof(MATERIAL_DATA) * MAX_MATERIALS))
+	{
+		std::cout << "Material block size mismatch: shader " << blockSize
+			<< " bytes, application " << sizeof(MATERIAL_DATA) * MAX_MATERIALS << " bytes" << std::endl;
+	}
 }
 
 /***********************************************************
@@ -530,10 +682,7 @@ void SceneManager::SetTransformations(
 
 	modelView = translation * rotationZ * rotationY * rotationX * scale;
 
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
-	}
+	m_objectState.modelMatrix = modelView;
 }
 
 /***********************************************************
@@ -554,11 +703,8 @@ void SceneManager::SetShaderColor(
 	currentColor.b = blueColorValue;
 	currentColor.a = alphaValue;
 
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
-	}
+	m_objectState.bUseTexture = false;
+	m_objectState.color = currentColor;
 }
 
 /***********************************************************
@@ -569,14 +715,8 @@ void SceneManager::SetShaderColor(
 void SceneManager::SetShaderTexture(
 	std::string textureTag)
 {
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
-
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
-	}
+	m_objectState.textureLayer = m_textureArray.FindLayer(textureTag);
+	m_objectState.bUseTexture = (m_objectState.textureLayer >= 0);
 }
 
 /***********************************************************
@@ -586,42 +726,68 @@ void SceneManager::SetShaderTexture(
  ***********************************************************/
 void SceneManager::SetTextureUVScale(float u, float v)
 {
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
-	}
+	m_objectState.uvScale = glm::vec2(u, v);
+}
+
+/***********************************************************
+ *  SetTintIntensity()
+ *
+ *  Sets how strongly the texture is tinted on the next object.
+ ***********************************************************/
+void SceneManager::SetTintIntensity(float intensity)
+{
+	m_objectState.tintIntensity = intensity;
+}
+
+/***********************************************************
+ *  SetUseInstancing()
+ *
+ *  Marks the next objects for drawing with instancing.
+ ***********************************************************/
+void SceneManager::SetUseInstancing(bool useInstancing)
+{
+	m_objectState.bInstanced = useInstancing;
+}
+
+/***********************************************************
+ *  SetUseStaticBatch()
+ *
+ *  Marks the next objects as static, so they are baked into
+ *  the static batch instead of being drawn one by one.
+ ***********************************************************/
+void SceneManager::SetUseStaticBatch(bool useStaticBatch)
+{
+	m_objectState.bStatic = useStaticBatch;
+}
+
+/***********************************************************
+ *  SetUseAsOccluder()
+ *
+ *  Marks the next objects as occluders. They should be big
+ *  and solid, since everything found behind them is skipped.
+ ***********************************************************/
+void SceneManager::SetUseAsOccluder(bool useAsOccluder)
+{
+	m_objectState.bOccluder = useAsOccluder;
 }
 
 /***********************************************************
  *  SetShaderMaterial()
  *
- *  Passes material values into the shader. So shiny.
+ *  Selects the material of the next object. So shiny.
  ***********************************************************/
 void SceneManager::SetShaderMaterial(
 	std::string materialTag)
 {
 	if (m_objectMaterials.size() > 0)
 	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
+		int materialIndex = FindMaterialIndex(materialTag);
 
-		bReturn = FindMaterial(materialTag, material);
-
-		if (bReturn)
+		if (materialIndex >= 0)
 		{
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
-			m_pShaderManager->setVec3Value("material.emissiveColor", material.emissiveColor); // Set emissive color
-
-			if (materialTag == "floor" || materialTag == "wall" || materialTag == "ceiling" || materialTag == "sofa" || materialTag == "rug")
-			{
-				m_pShaderManager->setIntValue(g_UseTextureName, true);
-			}
-			else
-			{
-				m_pShaderManager->setIntValue(g_UseTextureName, false);
-			}
+			m_objectState.materialIndex = materialIndex;
+			m_objectState.bUseTexture = m_objectMaterials[materialIndex].bUseTexture;
+			m_objectState.bTransparent = m_objectMaterials[materialIndex].bTransparent;
 		}
 	}
 	else
@@ -633,276 +799,877 @@ void SceneManager::SetShaderMaterial(
 /***********************************************************
  *  SetShaderLights()
  *
- *  Lights up the scene. Because darkness is not fun.
+ *  Lights up the scene. Because darkness is not fun. The
+ *  lights are kept in a uniform buffer that the shader
+ *  reads from, so this only has to run once.
  ***********************************************************/
 void SceneManager::SetShaderLights()
 {
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
-	m_pShaderManager->setVec3Value("globalAmbientColor", glm::vec3(0.05f, 0.05f, 0.05f));
-
-	if (m_pShaderManager != NULL)
+	m_lightBlock = LIGHT_BLOCK();
+
+	// Disable the directional light, the sun comes in through the window
+	m_lightBlock.directionalLight.bActive = false;
+
+	// Set up a spotlight to simulate sunlight through the window
+	m_lightBlock.spotLight.position = m_shadowLightPosition;
+	m_lightBlock.spotLight.direction = glm::vec3(0.0f, -0.5f, 0.0f);
+	m_lightBlock.spotLight.cutOff = glm::cos(glm::radians(85.0f));
+	m_lightBlock.spotLight.outerCutOff = glm::cos(glm::radians(90.0f));
+	m_lightBlock.spotLight.ambient = glm::vec3(0.7f, 0.55f, 0.4f);
+	m_lightBlock.spotLight.diffuse = glm::vec3(1.0f, 0.9f, 0.7f);
+	m_lightBlock.spotLight.specular = glm::vec3(1.0f, 0.9f, 0.8f);
+	m_lightBlock.spotLight.constant = 1.0f;
+	m_lightBlock.spotLight.linear = 0.05f;
+	m_lightBlock.spotLight.quadratic = 0.0007f;
+	m_lightBlock.spotLight.bActive = true;
+
+	// Set other lights (point lights)
+	for (int i = 0; i < TOTAL_POINT_LIGHTS; ++i)
 	{
-		// Set up a spotlight to simulate sunlight through the window
-		m_pShaderManager->setVec3Value("spotLight.position", glm::vec3(0.0f, 14.0f, -9.85f));
-		m_pShaderManager->setVec3Value("spotLight.direction", glm::vec3(0.0f, -0.5f, 0.0f));
-		m_pShaderManager->setFloatValue("spotLight.cutOff", glm::cos(glm::radians(85.0f)));
-		m_pShaderManager->setFloatValue("spotLight.outerCutOff", glm::cos(glm::radians(90.0f)));
-		m_pShaderManager->setVec3Value("spotLight.ambient", glm::vec3(0.7f, 0.55f, 0.4f));
-		m_pShaderManager->setVec3Value("spotLight.diffuse", glm::vec3(1.0f, 0.9f, 0.7f));
-		m_pShaderManager->setVec3Value("spotLight.specular", glm::vec3(1.0f, 0.9f, 0.8f));
-		m_pShaderManager->setFloatValue("spotLight.constant", 1.0f);
-		m_pShaderManager->setFloatValue("spotLight.linear", 0.05f);
-		m_pShaderManager->setFloatValue("spotLight.quadratic", 0.0007f);
-		m_pShaderManager->setBoolValue("spotLight.bActive", true);
+		POINT_LIGHT& light = m_lightBlock.pointLights[i];
+		light.constant = 1.0f;
+		light.linear = 0.09f; // Lower attenuation
+		light.quadratic = 0.032f; // Lower attenuation
 
-		// Set other lights (point lights)
-		for (int i = 0; i < TOTAL_LIGHTS; ++i)
+		if ((i == 0) || (i == 2))
 		{
-			std::string lightBase = "pointLights[" + std::to_string(i) + "].";
-
-			if (i == TOTAL_LIGHTS - 1)
-			{
-				glm::vec3 pos = glm::vec3(0.0f, 8.5f, -3.0f);
-				glm::vec3 ambient = glm::vec3(0.1f, 0.05f, 0.0f);
-				glm::vec3 diffuse = glm::vec3(1.0f, 0.5f, 0.0f);
-				glm::vec3 specular = glm::vec3(1.0f, 0.5f, 0.0f);
-				float constant = 1.0f;
-				float linear = 0.07f;
-				float quadratic = 0.017f;
-
-				m_pShaderManager->setVec3Value((lightBase + "position").c_str(), pos);
-				m_pShaderManager->setVec3Value((lightBase + "ambient").c_str(), ambient);
-				m_pShaderManager->setVec3Value((lightBase + "diffuse").c_str(), diffuse);
-				m_pShaderManager->setVec3Value((lightBase + "specular").c_str(), specular);
-				m_pShaderManager->setFloatValue((lightBase + "constant").c_str(), constant);
-				m_pShaderManager->setFloatValue((lightBase + "linear").c_str(), linear);
-				m_pShaderManager->setFloatValue((lightBase + "quadratic").c_str(), quadratic);
-				m_pShaderManager->setBoolValue((lightBase + "bActive").c_str(), true);
-			}
-			else if (i == TOTAL_LIGHTS - 2) 
-			{
-				// Set up a super bright point light at the origin with an orange glow
-				m_pShaderManager->setVec3Value("pointLights[0].position", glm::vec3(0.0f, 0.0f, 0.0f));
-				m_pShaderManager->setVec3Value("pointLights[0].ambient", glm::vec3(1.0f, 0.5f, 0.0f)); // Bright orange ambient light
-				m_pShaderManager->setVec3Value("pointLights[0].diffuse", glm::vec3(1.0f, 0.5f, 0.0f)); // Bright orange diffuse light
-				m_pShaderManager->setVec3Value("pointLights[0].specular", glm::vec3(1.0f, 0.5f, 0.0f)); // Bright orange specular light
-				m_pShaderManager->setFloatValue("pointLights[0].constant", 1.0f);
-				m_pShaderManager->setFloatValue("pointLights[0].linear", 0.09f); // Lower attenuation
-				m_pShaderManager->setFloatValue("pointLights[0].quadratic", 0.032f); // Lower attenuation
-				m_pShaderManager->setBoolValue("pointLights[0].bActive", true);
-			}
-			else if (i == TOTAL_LIGHTS - 3)
-			{
-				// Set up a super bright point light at the origin with an orange glow
-				m_pShaderManager->setVec3Value("pointLights[2].position", glm::vec3(0.0f, 0.0f, 0.0f));
-				m_pShaderManager->setVec3Value("pointLights[2].ambient", glm::vec3(1.0f, 0.5f, 0.0f)); // Bright orange ambient light
-				m_pShaderManager->setVec3Value("pointLights[2].diffuse", glm::vec3(1.0f, 0.5f, 0.0f)); // Bright orange diffuse light
-				m_pShaderManager->setVec3Value("pointLights[2].specular", glm::vec3(1.0f, 0.5f, 0.0f)); // Bright orange specular light
-				m_pShaderManager->setFloatValue("pointLights[2].constant", 1.0f);
-				m_pShaderManager->setFloatValue("pointLights[2].linear", 0.09f); // Lower attenuation
-				m_pShaderManager->setFloatValue("pointLights[2].quadratic", 0.032f); // Lower attenuation
-				m_pShaderManager->setBoolValue("pointLights[2].bActive", true);
-			}
-			else
-			{
-				m_pShaderManager->setVec3Value((lightBase + "position").c_str(), glm::vec3(0.0f, 0.0f, 0.0f));
-				m_pShaderManager->setVec3Value((lightBase + "ambient").c_str(), glm::vec3(0.05f, 0.05f, 0.05f));
-				m_pShaderManager->setVec3Value((lightBase + "diffuse").c_str(), glm::vec3(0.0f, 0.0f, 0.0f));
-				m_pShaderManager->setVec3Value((lightBase + "specular").c_str(), glm::vec3(0.0f, 0.0f, 0.0f));
-				m_pShaderManager->setFloatValue((lightBase + "constant").c_str(), 1.0f);
-				m_pShaderManager->setFloatValue((lightBase + "linear").c_str(), 0.09f);
-				m_pShaderManager->setFloatValue((lightBase + "quadratic").c_str(), 0.032f);
-				m_pShaderManager->setBoolValue((lightBase + "bActive").c_str(), false);
-			}
+			// Set up a super bright point light with an orange glow
+			light.ambient = glm::vec3(1.0f, 0.5f, 0.0f); // Bright orange ambient light
+			light.diffuse = glm::vec3(1.0f, 0.5f, 0.0f); // Bright orange diffuse light
+			light.specular = glm::vec3(1.0f, 0.5f, 0.0f); // Bright orange specular light
+			light.bActive = true;
+			SetPointLightShadow(i, true);
 		}
+		else
+		{
+			light.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+			light.bActive = false;
+		}
+	}
 
-		// Disable the directional light if it's not needed anymore
-		m_pShaderManager->setBoolValue("directionalLight.bActive", false);
+	if (m_lightBlockBuffer == 0)
+	{
+		glGenBuffers(1, &m_lightBlockBuffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_lightBlockBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(LIGHT_BLOCK), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		// the buffer stays bound to its binding point for every pass
+		glBindBufferBase(GL_UNIFORM_BUFFER, g_LightBlockBinding, m_lightBlockBuffer);
+	}
+
+	// the block size in the shader has to match the C++ structure
+	GLint blockSize = m_pShaderManager->setUniformBlockBinding(g_LightBlockName, g_LightBlockBinding);
+	if (blockSize != (GLint)sizeof(LIGHT_BLOCK))
+	{
+		std::cout << "Light block size mismatch: shader " << blockSize
+			<< " bytes, application " << sizeof(LIGHT_BLOCK) << " bytes" << std::endl;
 	}
-}
 
+	m_bLightBlockDirty = true;
+}
 
 /***********************************************************
- *  RenderSceneFromLightPerspective()
+ *  AnimatePointLights()
  *
- *  Renders the scene from the light's perspective. Lights need their own POV.
+ *  Computes where the moving point lights are at a point in
+ *  time. It only does math, so the simulation thread can
+ *  run it ahead of the frame being drawn.
  ***********************************************************/
-void SceneManager::RenderSceneFromLightPerspective()
+void SceneManager::AnimatePointLights(double time, glm::vec3 positions[TOTAL_POINT_LIGHTS])
 {
-	glm::mat4 lightProjection, lightView;
-	glm::mat4 lightSpaceMatrix;
-	float near_plane = 1.0f, far_plane = 50.0f;
-	lightProjection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane);
-	lightView = glm::lookAt(glm::vec3(0.0f, 14.0f, -9.85f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	lightSpaceMatrix = lightProjection * lightView;
-
-	glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-	glClear(GL_DEPTH_BUFFER_BIT);
-
-	m_pShaderManager->use();
-	m_pShaderManager->setMat4Value("lightSpaceMatrix", lightSpaceMatrix);
+	float t = (sin((float)time) + 1.0f) / 2.0f; // Normalize sine wave to range [0, 1]
 
-	RenderScene();
+	glm::vec3 startPoint1 = glm::vec3(0.0f, 15.5f, -8.9f);
+	glm::vec3 endPoint1 = glm::vec3(14.4f, 13.0f, -8.9f);
+	glm::vec3 startPoint2 = glm::vec3(0.0f, 15.5f, -8.9f);
+	glm::vec3 endPoint2 = glm::vec3(-14.4f, 13.0f, -8.9f);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	positions[0] = glm::mix(startPoint1, endPoint1, t);
+	positions[1] = glm::mix(startPoint1, endPoint1, 1.0f - t);
+	positions[2] = glm::mix(startPoint2, endPoint2, t);
+	positions[3] = glm::mix(startPoint2, endPoint2, 1.0f - t);
 }
 
 /***********************************************************
- *  RenderSceneWithShadows()
+ *  SetPointLightPositions()
  *
- *  Renders the scene with shadows, because flat lighting is dull.
+ *  Moves the point lights, marking the light block out of
+ *  date if any of them actually moved.
  ***********************************************************/
-void SceneManager::RenderSceneWithShadows()
+void SceneManager::SetPointLightPositions(const glm::vec3 positions[TOTAL_POINT_LIGHTS])
 {
-	RenderSceneFromLightPerspective();
-
-	glViewport(0, 0, m_ScreenWidth, m_ScreenHeight);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	m_pShaderManager->use();
-
-	SetShaderLights();
-
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
-	m_pShaderManager->setSampler2DValue(g_ShadowMapName, 1);
-
-	BindGLTextures();
-
-	RenderScene();
+	for (int i = 0; i < TOTAL_POINT_LIGHTS; ++i)
+	{
+		if (m_lightBlock.pointLights[i].position != positions[i])
+		{
+			m_lightBlock.pointLights[i].position = positions[i];
+			m_bLightBlockDirty = true;
+		}
+	}
 }
 
 /***********************************************************
- *  SetShaderEmissive()
+ *  UpdateLights()
  *
- *  Sets the emissive color, because some things just need to glow.
+ *  Writes the light block to its buffer if anything changed.
  ***********************************************************/
-void SceneManager::SetShaderEmissive(
-	float redColorValue,
-	float greenColorValue,
-	float blueColorValue)
+void SceneManager::UpdateLights()
 {
-	glm::vec3 emissiveColor;
 
-	emissiveColor.r = redColorValue;
-	emissiveColor.g = greenColorValue;
-	emissiveColor.b = blueColorValue;
+	// with the frame ring, the block is written every frame,
+	// since the region it was last written to gets reused
+	if (m_frameRing.IsMapped())
+	{
+		GLintptr offset = 0;
+		void* block = m_frameRing.Allocate(sizeof(LIGHT_BLOCK), m_frameRing.GetUniformAlignment(), offset);
+		if (block != NULL)
+		{
+			memcpy(block, &m_lightBlock, sizeof(LIGHT_BLOCK));
+			glBindBufferRange(GL_UNIFORM_BUFFER, g_LightBlockBinding, m_frameRing.GetBuffer(), offset, sizeof(LIGHT_BLOCK));
+			m_bLightBlockInRing = true;
+			m_bLightBlockDirty = false;
+			return;
+		}
+	}
+
+	if (m_bLightBlockInRing)
+	{
+		glBindBufferBase(GL_UNIFORM_BUFFER, g_LightBlockBinding, m_lightBlockBuffer);
+		m_bLightBlockInRing = false;
+		m_bLightBlockDirty = true;
+	}
 
-	if (NULL != m_pShaderManager)
+	if (m_bLightBlockDirty)
 	{
-		m_pShaderManager->setVec3Value("material.emissiveColor", emissiveColor);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_lightBlockBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LIGHT_BLOCK), &m_lightBlock);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		m_bLightBlockDirty = false;
 	}
 }
 
 /***********************************************************
- *  SetUseLighting()
+ *  GetShaderDefines()
  *
- *  Turns lighting on or off. Because sometimes, even virtual worlds need a light switch.
+ *  Returns the defines the shaders need to match the
+ *  application, to be passed as the shader preamble.
  ***********************************************************/
-void SceneManager::SetUseLighting(bool useLighting) {
-	glUseProgram(m_ShaderProgramID);
-	glUniform1i(glGetUniformLocation(m_ShaderProgramID, "bUseLighting"), useLighting ? GL_TRUE : GL_FALSE);
+std::string SceneManager::GetShaderDefines()
+{
+	std::string defines;
+
+	// the multi-draw path needs gl_DrawID and storage buffers,
+	// so it replaces the shaders' #version line as well
+	if (IsMultiDrawSupported())
+	{
+		defines = "#version 460 core\n#define USE_MULTI_DRAW\n";
+	}
+
+	return defines + "#define TOTAL_POINT_LIGHTS " + std::to_string(TOTAL_POINT_LIGHTS) + "\n" +
+		"#define MAX_MATERIALS " + std::to_string(MAX_MATERIALS) + "\n" +
+		"#define SHADOW_CASCADES " + std::to_string(SHADOW_CASCADES) + "\n" +
+		"#define SHADOW_FILTER_SIZE " + std::to_string(g_ShadowFilterSize) + "\n" +
+		"#define POINT_SHADOW_FACE_BUDGET " + std::to_string(g_PointShadowFaceBudget) + "\n";
 }
 
 /***********************************************************
- *  SetTextureOffset()
+ *  IsMultiDrawSupported()
  *
- *  Applies texture offsets. Because textures need to move around too.
+ *  Checks whether the context can submit the scene with
+ *  glMultiDrawElementsIndirect. The 3.3 context requested
+ *  on macOS cannot, so it keeps one draw call per object.
  ***********************************************************/
-void SceneManager::SetTextureOffset(float offsetX, float offsetY) {
-	glUseProgram(m_ShaderProgramID);
-	glUniform2f(glGetUniformLocation(m_ShaderProgramID, "textureOffset"), offsetX, offsetY);
+bool SceneManager::IsMultiDrawSupported()
+{
+#ifdef __APPLE__
+	return false;
+#else
+	return GLEW_VERSION_4_6 ? true : false;
+#endif
 }
 
 
 /***********************************************************
- *  LoadSceneTextures()
+ *  RenderSceneFromLightPerspective()
  *
- *  Loads the textures for the 3D scene. Because 3D without textures is just sad.
+ *  Renders the scene from the light's perspective. Lights need their own POV.
+ *  Each cascade that moved is drawn into its own layer of
+ *  the shadow map, with the casters culled to that cascade.
  ***********************************************************/
-void SceneManager::LoadSceneTextures()
+void SceneManager::RenderSceneFromLightPerspective()
 {
-	// Load textures here
-	CreateGLTexture("textures/floor.jpg", "texture1");
-	CreateGLTexture("textures/couchfabric.jpg", "texture2");
-	CreateGLTexture("textures/sidewall.jpg", "texture3");
-	CreateGLTexture("textures/roof.jpg", "texture4");
-	CreateGLTexture("textures/painting1.png", "texture5");
-	CreateGLTexture("textures/roof.jpg", "texture4");
-	CreateGLTexture("textures/desktop.png", "texture6");
-	CreateGLTexture("textures/keyboard.png", "texture7");
-	CreateGLTexture("textures/monitor.png", "texture8");
-	CreateGLTexture("textures/drawer.png", "texture9");
+	GLStateCache& stateCache = GLStateCache::Get();
 
+	// the depth map can't be sampled while it is being written
+	stateCache.BindTexture(g_ShadowMapUnit, GL_TEXTURE_2D_ARRAY, 0);
 
-	BindGLTextures();
-}
+	stateCache.Viewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+	stateCache.BindFramebuffer(depthMapFBO);
 
-/***********************************************************
- *  PrepareScene()
- *
- *  Prepares the 3D scene by loading shapes and textures.
- ***********************************************************/
-void SceneManager::PrepareScene()
-{
-	LoadSceneTextures();
+	// only depth is written, so there is no need for color output
+	stateCache.ColorMask(false);
+	// casters in front of a cascade's near plane are flattened
+	// onto it rather than clipped, see UpdateShadowCascades()
+	stateCache.SetEnabled(GL_DEPTH_CLAMP, true);
 
-	DefineObjectMaterials();
+	m_pDepthShaderManager->use();
 
-	m_basicMeshes->LoadPlaneMesh();
-	m_basicMeshes->LoadBoxMesh();
-	m_basicMeshes->LoadCylinderMesh();
-	m_basicMeshes->LoadTaperedCylinderMesh();
-	m_basicMeshes->LoadTorusMesh();
-	m_basicMeshes->LoadSphereMesh();
-}
+	for (int cascade = 0; cascade < SHADOW_CASCADES; cascade++)
+	{
+		if (!m_bCascadeDirty[cascade])
+		{
+			continue;
+		}
+
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMap, 0, cascade);
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		m_pDepthShaderManager->setMat4Value("lightSpaceMatrix", m_cascadeMatrices[cascade]);
+		RenderShadowCasters((RenderQueue::RENDER_PASS)(RenderQueue::PASS_SHADOW + cascade),
+			m_shadowDrawRuns[cascade], m_pDepthShaderManager);
 
+		m_bCascadeDirty[cascade] = false;
+	}
+
+	stateCache.SetEnabled(GL_DEPTH_CLAMP, false);
+	stateCache.ColorMask(true);
+	stateCache.BindFramebuffer(0);
+}
 
 /***********************************************************
- *  RenderScene()
+ *  UpdateShadowCascades()
  *
- *  Renders the 3D scene. Because why else are we here?
+ *  Splits the camera's view into a slice per cascade, nearer
+ *  slices being shorter, and fits the light's projection of
+ *  each cascade around its slice. The near and far planes
+ *  are fitted to the visible objects the cascade covers, so
+ *  the objects have to be culled against the camera first.
+ *  A cascade whose view and projection changed is marked to
+ *  be rendered again.
  ***********************************************************/
-void SceneManager::RenderScene()
+void SceneManager::UpdateShadowCascades()
 {
+	// the corners of the camera's frustum, the near plane's
+	// first and then the far plane's in the same order
+	glm::mat4 inverseViewProjection = glm::inverse(m_projectionMatrix * m_viewMatrix);
+	glm::vec3 corners[8];
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec4 corner = inverseViewProjection * glm::vec4(
+			(i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f);
+		corners[i] = glm::vec3(corner) / corner.w;
+	}
 
-	GLuint ShaderProgramID = m_ShaderProgramID;
+	float nearDepth = -(m_viewMatrix * glm::vec4(corners[0], 1.0f)).z;
+	float farDepth = -(m_viewMatrix * glm::vec4(corners[4], 1.0f)).z;
+	if ((nearDepth <= 0.0f) || (farDepth <= nearDepth))
+	{
+		// no camera has been set yet
+		return;
+	}
+	float shadowDepth = std::min(farDepth, g_ShadowDistance);
 
-	// Bind the depth map texture for shadow mapping
-	//Ignore this, still working on bias
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
-	m_pShaderManager->setSampler2DValue("shadowMap", 1);
+	glm::mat4 lightView = glm::lookAt(m_shadowLightPosition, m_shadowLightTarget, glm::vec3(0.0f, 1.0f, 0.0f));
 
-	// Bind the other textures
-	BindGLTextures();
+	// the visible objects in light view space, which may receive
+	// shadows, and how close to the light any object comes; the
+	// light looks down -z, so larger z is closer to it
+	glm::vec3 sceneMin(FLT_MAX), sceneMax(-FLT_MAX);
+	m_receiverMin.clear();
+	m_receiverMax.clear();
+	for (int i = 0; i < m_objectBounds.GetCount(); i++)
+	{
+		glm::vec3 boundsMin, boundsMax;
+		m_objectBounds.GetBounds(i, boundsMin, boundsMax);
+		sceneMin = glm::min(sceneMin, boundsMin);
+		sceneMax = glm::max(sceneMax, boundsMax);
 
-	// Set up the lights
-	SetShaderLights();
+		if (m_objectVisible[i])
+		{
+			glm::vec3 lightMin, lightMax;
+			FrustumCuller::TransformBounds(boundsMin, boundsMax, lightView, lightMin, lightMax);
+			m_receiverMin.push_back(lightMin);
+			m_receiverMax.push_back(lightMax);
+		}
+	}
+	if (sceneMin.x > sceneMax.x)
+	{
+		// no objects have been added yet
+		return;
+	}
+	glm::vec3 sceneLightMin, sceneLightMax;
+	FrustumCuller::TransformBounds(sceneMin, sceneMax, lightView, sceneLightMin, sceneLightMax);
+	float sceneNear = std::floor(-sceneLightMax.z / g_CascadeDepthStep) * g_CascadeDepthStep;
+	float sceneFar = std::ceil(-sceneLightMin.z / g_CascadeDepthStep) * g_CascadeDepthStep;
 
-	// Update the positions of the moving lights
-	float timeValue = glfwGetTime();
-	float t = (sin(timeValue) + 1.0f) / 2.0f; // Normalize sine wave to range [0, 1]
+	float splitBegin = nearDepth;
 
-	glm::vec3 startPoint1 = glm::vec3(0.0f, 15.5f, -8.9f);
-	glm::vec3 endPoint1 = glm::vec3(14.4f, 13.0f, -8.9f);
+	for (int cascade = 0; cascade < SHADOW_CASCADES; cascade++)
+	{
+		float fraction = (float)(cascade + 1) / (float)SHADOW_CASCADES;
+		float logSplit = nearDepth * std::pow(shadowDepth / nearDepth, fraction);
+		float evenSplit = nearDepth + (shadowDepth - nearDepth) * fraction;
+		float splitEnd = g_CascadeSplitLambda * logSplit + (1.0f - g_CascadeSplitLambda) * evenSplit;
+
+		// view space depth changes evenly along the frustum's
+		// edges, for a perspective or orthographic camera alike
+		float beginFraction = (splitBegin - nearDepth) / (farDepth - nearDepth);
+		float endFraction = (splitEnd - nearDepth) / (farDepth - nearDepth);
+		glm::vec3 slice[8];
+		glm::vec3 center(0.0f);
+		for (int i = 0; i < 4; i++)
+		{
+			slice[i] = glm::mix(corners[i], corners[i + 4], beginFraction);
+			slice[i + 4] = glm::mix(corners[i], corners[i + 4], endFraction);
+			center += slice[i] + slice[i + 4];
+		}
+		center = center / 8.0f;
+
+		// a sphere around the slice keeps the same size however
+		// the camera turns, and so does the size of its texels
+		float radius = 0.0f;
+		for (int i = 0; i < 8; i++)
+		{
+			radius = std::max(radius, glm::length(slice[i] - center));
+		}
+		radius = std::ceil(radius / g_CascadeRadiusStep) * g_CascadeRadiusStep;
+
+		// moving the cascade in whole texels keeps the edges of
+		// the shadows from shimmering as the camera moves
+		glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+		float texelSize = (2.0f * radius) / (float)SHADOW_WIDTH;
+		float left = std::floor(lightCenter.x / texelSize) * texelSize - radius;
+		float bottom = std::floor(lightCenter.y / texelSize) * texelSize - radius;
+		float right = left + 2.0f * radius;
+		float top = bottom + 2.0f * radius;
+
+		// the depth range only has to hold the visible objects
+		// the cascade covers, which spends the depth precision
+		// where the shadows are compared
+		float receiverNear = FLT_MAX, receiverFar = -FLT_MAX;
+		for (size_t i = 0; i < m_receiverMin.size(); i++)
+		{
+			if ((m_receiverMax[i].x < left) || (m_receiverMin[i].x > right) ||
+				(m_receiverMax[i].y < bottom) || (m_receiverMin[i].y > top))
+			{
+				continue;
+			}
+			receiverNear = std::min(receiverNear, -m_receiverMax[i].z);
+			receiverFar = std::max(receiverFar, -m_receiverMin[i].z);
+		}
+		float near_plane = sceneNear, far_plane = sceneFar;
+		if (receiverNear <= receiverFar)
+		{
+			near_plane = std::floor(receiverNear / g_CascadeDepthStep) * g_CascadeDepthStep;
+			far_plane = std::ceil(receiverFar / g_CascadeDepthStep) * g_CascadeDepthStep;
+		}
+		far_plane = std::max(far_plane, near_plane + g_CascadeDepthStep);
 
-	glm::vec3 lightPos1 = glm::mix(startPoint1, endPoint1, t);
-	glm::vec3 lightPos2 = glm::mix(startPoint1, endPoint1, 1.0f - t);
+		glm::mat4 cascadeMatrix = glm::ortho(left, right, bottom, top, near_plane, far_plane) * lightView;
+		if (m_bShadowMapDirty || (cascadeMatrix != m_cascadeMatrices[cascade]))
+		{
+			m_cascadeMatrices[cascade] = cascadeMatrix;
+			m_bCascadeDirty[cascade] = true;
+		}
 
-	m_pShaderManager->setVec3Value("pointLights[0].position", lightPos1);
-	m_pShaderManager->setVec3Value("pointLights[1].position", lightPos2);
+		// casters between the light and the near plane still
+		// shadow the receivers, so the culling volume reaches
+		// back to the nearest object; the light pass clamps
+		// their depth onto the near plane. Casters past the far
+		// plane can't shadow anything visible, and are culled.
+		m_cascadeCullMatrices[cascade] = glm::ortho(left, right, bottom, top,
+			std::min(sceneNear, near_plane), far_plane) * lightView;
 
-	glm::vec3 startPoint2 = glm::vec3(0.0f, 15.5f, -8.9f);
-	glm::vec3 endPoint2 = glm::vec3(-14.4f, 13.0f, -8.9f);
+		m_cascadeSplits[cascade] = splitEnd;
+		splitBegin = splitEnd;
+	}
+
+	m_bShadowMapDirty = false;
+}
+
+/***********************************************************
+ *  IsAnyCascadeDirty()
+ *
+ *  Returns whether any cascade of the shadow map has to be
+ *  rendered this frame.
+ ***********************************************************/
+bool SceneManager::IsAnyCascadeDirty() const
+{
+	for (int cascade = 0; cascade < SHADOW_CASCADES; cascade++)
+	{
+		if (m_bCascadeDirty[cascade])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/***********************************************************
+ *  SetShadowLight()
+ *
+ *  Moves the shadow-casting light. The shadow map is only
+ *  rendered again if the light actually changed.
+ ***********************************************************/
+void SceneManager::SetShadowLight(glm::vec3 position, glm::vec3 target)
+{
+	if ((position != m_shadowLightPosition) || (target != m_shadowLightTarget))
+	{
+		m_shadowLightPosition = position;
+		m_shadowLightTarget = target;
+		m_bShadowMapDirty = true;
+
+		// the spot light is the light that casts the shadow
+		m_lightBlock.spotLight.position = position;
+		m_bLightBlockDirty = true;
+	}
+}
+
+/***********************************************************
+ *  SetObjectTransform()
+ *
+ *  Moves a scene object after the scene has been prepared,
+ *  marking the shadow map (and the instance buffers, for
+ *  instanced objects) out of date.
+ ***********************************************************/
+void SceneManager::SetObjectTransform(int objectIndex, glm::mat4 modelMatrix)
+{
+	if ((objectIndex < 0) || (objectIndex >= (int)m_objects.size()))
+	{
+		std::cout << "SetObjectTransform: invalid object index " << objectIndex << std::endl;
+		return;
+	}
+
+	SceneObject& object = m_objects[objectIndex];
+	if (object.modelMatrix == modelMatrix)
+	{
+		return;
+	}
+
+	object.modelMatrix = modelMatrix;
+	UpdateObjectBounds(objectIndex);
+	RecordObjectDraw(objectIndex);
+	m_bRecordingDirty = true;
+	if (object.bInstanced)
+	{
+		m_bInstanceBatchesDirty = true;
+	}
+	if (object.bStatic)
+	{
+		m_bStaticBatchesDirty = true;
+	}
+	InvalidateShadowMap();
+}
+
+/***********************************************************
+ *  InvalidateShadowMap()
+ *
+ *  Forces the shadow map to be rendered on the next frame,
+ *  and every face of the point lights' shadows as soon as
+ *  the budget allows.
+ ***********************************************************/
+void SceneManager::InvalidateShadowMap()
+{
+	m_bShadowMapDirty = true;
+	m_pointShadowScheduler.InvalidateAll();
+}
+
+/***********************************************************
+ *  SetPointLightShadow()
+ *
+ *  Chooses whether a point light casts cube shadows. Every
+ *  shadowed light adds to the faces waiting to be drawn,
+ *  while the faces drawn each frame stay the same.
+ ***********************************************************/
+void SceneManager::SetPointLightShadow(int lightIndex, bool bCastsShadow)
+{
+	if ((lightIndex < 0) || (lightIndex >= TOTAL_POINT_LIGHTS))
+	{
+		std::cout << "SetPointLightShadow: invalid light index " << lightIndex << std::endl;
+		return;
+	}
+
+	if (m_bPointLightShadow[lightIndex] != bCastsShadow)
+	{
+		m_bPointLightShadow[lightIndex] = bCastsShadow;
+		// the casters are only recorded while a light needs them
+		m_bRecordingDirty = true;
+	}
+}
+
+/***********************************************************
+ *  HasPointLightShadows()
+ *
+ *  Returns whether any point light casts shadows.
+ ***********************************************************/
+bool SceneManager::HasPointLightShadows() const
+{
+	for (int i = 0; i < TOTAL_POINT_LIGHTS; i++)
+	{
+		if (m_bPointLightShadow[i])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/***********************************************************
+ *  RenderPointLightShadows()
+ *
+ *  Renders the cube faces of the point light shadows that
+ *  the scheduler picked for the frame, all in one pass.
+ *  A face keeps the light position it was drawn with, and
+ *  is sampled with the matrix of that position until it is
+ *  drawn again, so a lagging face is only a little stale.
+ ***********************************************************/
+void SceneManager::RenderPointLightShadows()
+{
+	glm::vec3 positions[TOTAL_POINT_LIGHTS];
+	for (int i = 0; i < TOTAL_POINT_LIGHTS; i++)
+	{
+		positions[i] = m_lightBlock.pointLights[i].position;
+	}
+
+	m_pointShadowScheduler.Schedule(positions, m_bPointLightShadow, m_projectionMatrix * m_viewMatrix,
+		m_viewPosition, g_PointShadowFar, g_PointShadowFaceBudget, m_pointShadowUpdates);
+	if (m_pointShadowUpdates.empty())
+	{
+		return;
+	}
+
+	GLStateCache& stateCache = GLStateCache::Get();
+
+	// the faces can't be sampled while they are being written
+	stateCache.BindTexture(g_PointShadowUnit, GL_TEXTURE_2D_ARRAY, 0);
+	stateCache.Viewport(0, 0, g_PointShadowSize, g_PointShadowSize);
+
+	stateCache.BindFramebuffer(m_pointShadowClearFBO);
+	for (size_t i = 0; i < m_pointShadowUpdates.size(); i++)
+	{
+		const PointShadowScheduler::FACE_UPDATE& update = m_pointShadowUpdates[i];
+		int layer = update.light * PointShadowScheduler::FACE_COUNT + update.face;
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_pointShadowMap, 0, layer);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	stateCache.BindFramebuffer(m_pointShadowFBO);
+	stateCache.ColorMask(false);
+
+	// the vertex shader passes world positions through, and the
+	// geometry shader projects them into each face
+	m_pPointShadowShaderManager->use();
+	m_pPointShadowShaderManager->setMat4Value("lightSpaceMatrix", glm::mat4(1.0f));
+	int faceLayers[g_PointShadowFaceBudget];
+	glm::mat4 faceMatrices[g_PointShadowFaceBudget];
+	int faceCount = (int)m_pointShadowUpdates.size();
+	for (int i = 0; i < faceCount; i++)
+	{
+		const PointShadowScheduler::FACE_UPDATE& update = m_pointShadowUpdates[i];
+		int layer = update.light * PointShadowScheduler::FACE_COUNT + update.face;
+		m_pointShadowMatrices[layer] = PointShadowScheduler::GetFaceMatrix(update.position, update.face,
+			g_PointShadowNear, g_PointShadowFar);
+		faceLayers[i] = layer;
+		faceMatrices[i] = m_pointShadowMatrices[layer];
+	}
+	m_pPointShadowShaderManager->setIntValue(g_FaceCountName, faceCount);
+	m_pPointShadowShaderManager->setIntArrayValue(g_FaceLayersName, faceLayers, faceCount);
+	m_pPointShadowShaderManager->setMat4ArrayValue(g_FaceMatricesName, faceMatrices, faceCount);
+	m_bPointShadowMatricesDirty = true;
+
+	RenderShadowCasters(g_PointShadowPass, m_pointShadowDrawRuns, m_pPointShadowShaderManager);
+
+	for (size_t i = 0; i < m_pointShadowUpdates.size(); i++)
+	{
+		m_pointShadowScheduler.MarkRendered(m_pointShadowUpdates[i]);
+	}
+
+	stateCache.ColorMask(true);
+	stateCache.BindFramebuffer(0);
+}
+
+/***********************************************************
+ *  RenderShadowCasters()
+ *
+ *  Draws the packets of one of the shadow passes of the
+ *  render queue with a depth program. Only the model matrix
+ *  matters here, so the material, texture and lighting
+ *  state is skipped.
+ ***********************************************************/
+void SceneManager::RenderShadowCasters(RenderQueue::RENDER_PASS pass, const std::vector<MULTI_DRAW_RUN>& runs,
+	ShaderManager* pDepthShaderManager)
+{
+	const std::vector<RenderQueue::DRAW_PACKET>& packets = m_renderQueue.GetPackets();
+	size_t passEnd = m_renderQueue.GetPassEnd(pass);
+	bool bInstancing = false;
+	size_t nextRun = 0;
+
+	for (size_t i = m_renderQueue.GetPassBegin(pass); i < passEnd; i++)
+	{
+		const RenderQueue::DRAW_PACKET& packet = packets[i];
+
+		// the static batch is drawn through the instanced path too
+		bool bInstancedPacket = (packet.state.program != g_BasicProgram);
+		if (bInstancedPacket != bInstancing)
+		{
+			pDepthShaderManager->setBoolValue(g_UseInstancingName, bInstancedPacket);
+			bInstancing = bInstancedPacket;
+		}
+
+		if ((nextRun < runs.size()) && (runs[nextRun].firstPacket == i))
+		{
+			// the same recorded draws as the main pass, of which
+			// the depth program only reads the model matrix
+			const MULTI_DRAW_RUN& run = runs[nextRun];
+			pDepthShaderManager->setBoolValue(g_UseMultiDrawName, true);
+			pDepthShaderManager->setIntValue(g_DrawBaseName, run.firstDraw);
+			m_multiDrawList.Draw(m_instancedMeshes->GetVertexArray(), run.firstDraw, run.drawCount);
+			pDepthShaderManager->setBoolValue(g_UseMultiDrawName, false);
+
+			i += run.packetCount - 1;
+			nextRun++;
+		}
+		else if (packet.state.program == g_StaticProgram)
+		{
+			const STATIC_BATCH& batch = m_staticBatches[packet.objectIndex];
+			m_instancedMeshes->DrawStaticGroup(batch.group, batch.instanceBuffer);
+		}
+		else if (bInstancedPacket)
+		{
+			DrawInstanceBatch(m_instanceBatches[packet.objectIndex]);
+		}
+		else
+		{
+			const SceneObject& object = m_objects[packet.objectIndex];
+			pDepthShaderManager->setMat4Value(g_ModelName, object.modelMatrix);
+			DrawMesh(object.mesh, m_objectLods[packet.objectIndex]);
+		}
+	}
+
+	if (bInstancing)
+	{
+		pDepthShaderManager->setBoolValue(g_UseInstancingName, false);
+	}
+}
+
+/***********************************************************
+ *  RenderSceneWithShadows()
+ *
+ *  Renders the scene with shadows, because flat lighting is dull.
+ ***********************************************************/
+void SceneManager::RenderSceneWithShadows()
+{
+	// waits for the GPU only if it is three frames behind
+	m_frameRing.BeginFrame();
+
+	if (m_bInstanceBatchesDirty)
+	{
+		BuildInstanceBatches();
+		m_bInstanceBatchesDirty = false;
+		m_bRecordingDirty = true;
+	}
+	if (m_bStaticBatchesDirty)
+	{
+		BuildStaticBatches();
+		m_bStaticBatchesDirty = false;
+		m_bRecordingDirty = true;
+	}
+
+	// the draws of both passes are recorded once, and kept for
+	// as long as the camera, the light and the objects stay put;
+	// the cascades are fitted again while they are recorded
+	if (m_bRecordingDirty || m_bShadowMapDirty ||
+		(m_viewMatrix != m_recordedViewMatrix) || (m_projectionMatrix != m_recordedProjectionMatrix))
+	{
+		BuildRenderQueue();
+		if (m_bUseMultiDraw)
+		{
+			BuildMultiDrawList();
+		}
+		m_recordedViewMatrix = m_viewMatrix;
+		m_recordedProjectionMatrix = m_projectionMatrix;
+		m_bRecordingDirty = false;
+	}
+	else if (m_bUseMultiDraw)
+	{
+		// the ring buffer region of the last frame is not the
+		// current one, so the unchanged draws are copied again
+		m_multiDrawList.Upload();
+	}
+
+	// the cascades are kept from earlier frames until the
+	// light, a shadow caster or the camera moves them
+	if (IsAnyCascadeDirty())
+	{
+		RenderSceneFromLightPerspective();
+	}
+	// only a few cube faces are drawn each frame, however many
+	// point lights are moving
+	if (HasPointLightShadows())
+	{
+		RenderPointLightShadows();
+	}
+
+	GLStateCache::Get().Viewport(0, 0, m_ScreenWidth, m_ScreenHeight);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	m_pShaderManager->use();
+	m_pShaderManager->setMat4ArrayValue(g_CascadeMatricesName, m_cascadeMatrices, SHADOW_CASCADES);
+	m_pShaderManager->setFloatArrayValue(g_CascadeSplitsName, m_cascadeSplits, SHADOW_CASCADES);
+
+	// a light's cube shadows are only sampled once all of its
+	// faces have been drawn
+	int pointShadowMask = 0;
+	for (int i = 0; i < TOTAL_POINT_LIGHTS; i++)
+	{
+		if (m_bPointLightShadow[i] && m_pointShadowScheduler.IsLightReady(i))
+		{
+			pointShadowMask |= (1 << i);
+		}
+	}
+	m_pShaderManager->setIntValue(g_PointShadowMaskName, pointShadowMask);
+	// the face matrices only change when faces are drawn
+	if (m_bPointShadowMatricesDirty)
+	{
+		m_pShaderManager->setMat4ArrayValue(g_PointShadowMatricesName, m_pointShadowMatrices,
+			TOTAL_POINT_LIGHTS * PointShadowScheduler::FACE_COUNT);
+		m_bPointShadowMatricesDirty = false;
+	}
+
+	RenderScene();
+
+	m_frameRing.EndFrame();
+}
+
+/***********************************************************
+ *  SetUseLighting()
+ *
+ *  Turns lighting on or off. Because sometimes, even virtual worlds need a light switch.
+ ***********************************************************/
+void SceneManager::SetUseLighting(bool useLighting) {
+	m_objectState.bUseLighting = useLighting;
+}
+
+/***********************************************************
+ *  SetTextureOffset()
+ *
+ *  Applies texture offsets. Because textures need to move around too.
+ ***********************************************************/
+void SceneManager::SetTextureOffset(float offsetX, float offsetY) {
+	m_pShaderManager->setVec2Value("textureOffset", glm::vec2(offsetX, offsetY));
+}
+
+
+/***********************************************************
+ *  LoadSceneTextures()
+ *
+ *  Loads the textures for the 3D scene. Because 3D without textures is just sad.
+ ***********************************************************/
+void SceneManager::LoadSceneTextures()
+{
+	// Load textures here, each one becomes a layer of the texture array
+	m_textureArray.AddImage("textures/floor.jpg", "texture1");
+	m_textureArray.AddImage("textures/couchfabric.jpg", "texture2");
+	m_textureArray.AddImage("textures/sidewall.jpg", "texture3");
+	m_textureArray.AddImage("textures/roof.jpg", "texture4");
+	m_textureArray.AddImage("textures/painting1.png", "texture5");
+	m_textureArray.AddImage("textures/desktop.png", "texture6");
+	m_textureArray.AddImage("textures/keyboard.png", "texture7");
+	m_textureArray.AddImage("textures/monitor.png", "texture8");
+	m_textureArray.AddImage("textures/drawer.png", "texture9");
+
+	m_textureArray.Upload();
+
+	// the sampler always reads from the array's unit
+	m_pShaderManager->setSampler2DValue(g_TextureValueName, g_TextureArrayUnit);
+}
+
+/***********************************************************
+ *  PrepareScene()
+ *
+ *  Prepares the 3D scene by loading shapes and textures.
+ ***********************************************************/
+void SceneManager::PrepareScene()
+{
+	LoadSceneTextures();
+
+	DefineObjectMaterials();
+	UploadObjectMaterials();
 
-	glm::vec3 lightPos2_1 = glm::mix(startPoint2, endPoint2, t);
-	glm::vec3 lightPos2_2 = glm::mix(startPoint2, endPoint2, 1.0f - t);
+	// the lights don't change, apart from their positions
+	SetShaderLights();
+
+	m_basicMeshes->LoadPlaneMesh();
+	m_basicMeshes->LoadBoxMesh();
+	m_basicMeshes->LoadCylinderMesh();
+	m_basicMeshes->LoadTaperedCylinderMesh();
+	m_basicMeshes->LoadTorusMesh();
+	m_basicMeshes->LoadSphereMesh();
+	GLStateCache::Get().InvalidateVertexArray();
+
+	m_instancedMeshes->LoadPlaneMesh();
+	m_instancedMeshes->LoadBoxMesh();
+	m_instancedMeshes->LoadCylinderMesh();
+	m_instancedMeshes->LoadTaperedCylinderMesh();
+	m_instancedMeshes->LoadSphereMesh();
+	m_instancedMeshes->UploadMeshes();
+
+	// the shaders were built with the multi-draw path when the
+	// context supports it, see GetShaderDefines()
+	m_bUseMultiDraw = IsMultiDrawSupported();
+	std::cout << "Draw submission: " << (m_bUseMultiDraw ? "multi-draw indirect" : "one call per object") << std::endl;
+
+	// the multi-draw list and the light block write into mapped
+	// memory rather than calling glBufferSubData every frame
+	if (FrameRingBuffer::IsSupported() && m_frameRing.Create(g_FrameRingSize))
+	{
+		m_multiDrawList.SetRingBuffer(&m_frameRing);
+	}
+	std::cout << "Per-frame uploads: " << (m_frameRing.IsMapped() ? "persistently mapped ring buffer" : "glBufferSubData") << std::endl;
+
+	// the light pass only needs depth, so it gets its own program
+	// it reads the recorded draws on the multi-draw path as well
+	m_pDepthShaderManager->LoadShaders("shaders/depthVertexShader.glsl", NULL, GetShaderDefines().c_str());
+	// the point lights' pass adds a geometry shader that sends
+	// each triangle to every cube face drawn that frame
+	m_pPointShadowShaderManager->LoadShaders("shaders/depthVertexShader.glsl", NULL, GetShaderDefines().c_str(),
+		"shaders/pointShadowGeometryShader.glsl");
+
+	// resolve every object's drawing state once, up front
+	DefineSceneObjects();
+	BuildObjectTree();
+	BuildStaticBatches();
+	BuildInstanceBatches();
+}
 
-	m_pShaderManager->setVec3Value("pointLights[2].position", lightPos2_1);
-	m_pShaderManager->setVec3Value("pointLights[3].position", lightPos2_2);
 
+/***********************************************************
+ *  DefineSceneObjects()
+ *
+ *  Builds the list of scene objects. Each object's model
+ *  matrix, material and texture are resolved here once, so
+ *  the render passes only have to walk the list.
+ ***********************************************************/
+void SceneManager::DefineSceneObjects()
+{
+	// every object starts from the shader's default state
+	m_objectState.mesh = MESH_BOX;
+	m_objectState.modelMatrix = glm::mat4(1.0f);
+	m_objectState.materialIndex = -1;
+	m_objectState.textureLayer = 0;
+	m_objectState.bUseTexture = false;
+	m_objectState.bUseLighting = true;
+	m_objectState.color = glm::vec4(1.0f);
+	m_objectState.uvScale = glm::vec2(1.0f, 1.0f);
+	m_objectState.tintIntensity = 0.0f;
+	m_objectState.bInstanced = false;
+	m_objectState.bStatic = false;
+	m_objectState.bOccluder = false;
+	m_objectState.bTransparent = false;
+
+	m_objects.clear();
+	m_objectLods.clear();
 
 	// Declare the variables for the transformations
 	glm::vec3 scaleXYZ;
@@ -911,6 +1678,10 @@ void SceneManager::RenderScene()
 	float ZrotationDegrees = 0.0f;
 	glm::vec3 positionXYZ;
 
+	// the attic shell and the furniture standing in it never move,
+	// so they are baked into the static batch
+	SetUseStaticBatch(true);
+
 	/*** Draw the Attic Planes ***/
 	// Draw the floor plane
 	SetShaderMaterial("floor");
@@ -924,7 +1695,11 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(4.0f, 4.0f);
-	m_basicMeshes->DrawPlaneMesh();
+	AddSceneObject(MESH_PLANE);
+
+	// the walls, sofa body and drawer body hide much of the room,
+	// so they are rasterized into the occlusion buffer
+	SetUseAsOccluder(true);
 
 	// Draw the back wall
 	SetShaderMaterial("wall");
@@ -937,7 +1712,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture3");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(0.75f, 0.75f);
-	m_basicMeshes->DrawPlaneMesh();
+	AddSceneObject(MESH_PLANE);
 
 	// Draw the left wall
 	SetShaderMaterial("wall");
@@ -951,7 +1726,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture3");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawPlaneMesh();
+	AddSceneObject(MESH_PLANE);
 
 	// Draw the right wall
 	positionXYZ = glm::vec3(15.0f, 3.5f, 2.0f);
@@ -960,7 +1735,8 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture3");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawPlaneMesh();
+	AddSceneObject(MESH_PLANE);
+	SetUseAsOccluder(false);
 
 	// Draw the slanted ceiling planes
 	SetShaderMaterial("ceiling");
@@ -972,7 +1748,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture4");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawPlaneMesh();
+	AddSceneObject(MESH_PLANE);
 
 	XrotationDegrees = 45.0f;
 	positionXYZ = glm::vec3(-7.4f, 14.5f, 2.0f);
@@ -981,7 +1757,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture4");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawPlaneMesh();
+	AddSceneObject(MESH_PLANE);
 
 	// Furthest beam - Glowing yellow-orange light
 	SetShaderMaterial("glowing_beam");
@@ -995,7 +1771,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = -90.0f;
 	YrotationDegrees = 0.0f;
@@ -1006,7 +1782,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw the structure beams
 	SetShaderMaterial("beam");
@@ -1020,7 +1796,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = 90.0f;
 	YrotationDegrees = 0.0f;
@@ -1031,7 +1807,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = 90.0f;
 	YrotationDegrees = 0.0f;
@@ -1042,7 +1818,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = 90.0f;
 	YrotationDegrees = 0.0f;
@@ -1053,7 +1829,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = 90.0f;
 	YrotationDegrees = 0.0f;
@@ -1064,7 +1840,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = 90.0f;
 	YrotationDegrees = 0.0f;
@@ -1075,7 +1851,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = 90.0f;
 	YrotationDegrees = 0.0f;
@@ -1086,7 +1862,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = -90.0f;
 	YrotationDegrees = 0.0f;
@@ -1097,7 +1873,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = -90.0f;
 	YrotationDegrees = 0.0f;
@@ -1108,7 +1884,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = -90.0f;
 	YrotationDegrees = 0.0f;
@@ -1119,7 +1895,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = -90.0f;
 	YrotationDegrees = 0.0f;
@@ -1130,7 +1906,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = -90.0f;
 	YrotationDegrees = 0.0f;
@@ -1141,7 +1917,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	XrotationDegrees = -90.0f;
 	YrotationDegrees = 0.0f;
@@ -1152,10 +1928,11 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture1");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	/*** Draw the Sofa ***/
 	SetShaderMaterial("sofa");
+	SetUseAsOccluder(true);
 	// Draw the main body of the sofa
 	scaleXYZ = glm::vec3(5.0f, 2.0f, 0.9f);
 	XrotationDegrees = 0.0f;
@@ -1167,7 +1944,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture2");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(0.75f, 0.75f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw the main body of the sofa
 	scaleXYZ = glm::vec3(5.0f, 2.0f, 0.9f);
@@ -1180,7 +1957,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture2");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(0.75f, 0.75f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw the main body of the sofa
 	scaleXYZ = glm::vec3(4.95f, 0.5f, 8.0f);
@@ -1193,7 +1970,9 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture2");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(0.75f, 0.75f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
+
+	SetUseAsOccluder(false);
 
 	// Draw the sofa cushions
 	SetShaderMaterial("sofa");
@@ -1207,7 +1986,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture2");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(0.75f, 0.75f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(3.0f, 0.5f, 3.5f);
 	XrotationDegrees = 0.0f;
@@ -1219,7 +1998,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture2");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(0.75f, 0.75f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(5.0f, 0.75f, 6.5f);
 	XrotationDegrees = 0.0f;
@@ -1231,7 +2010,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture2");
 	// Set the UV scale to repeat the texture
 	SetTextureUVScale(0.75f, 0.75f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw the sofa feet
 	SetShaderMaterial("sofa_feet");
@@ -1242,7 +2021,7 @@ void SceneManager::RenderScene()
 	positionXYZ = glm::vec3(-14.25f, 0.0f, 5.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	// No texture
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	scaleXYZ = glm::vec3(0.1f, 0.75f, 0.1f);
 	XrotationDegrees = 0.0f;
@@ -1251,7 +2030,7 @@ void SceneManager::RenderScene()
 	positionXYZ = glm::vec3(-10.25f, 0.0f, 5.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	// No texture
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	scaleXYZ = glm::vec3(0.1f, 0.5f, 0.1f);
 	XrotationDegrees = 0.0f;
@@ -1260,7 +2039,7 @@ void SceneManager::RenderScene()
 	positionXYZ = glm::vec3(-14.25f, 0.0f, -3.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	// No texture
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	scaleXYZ = glm::vec3(0.1f, 0.75f, 0.1f);
 	XrotationDegrees = 0.0f;
@@ -1269,7 +2048,7 @@ void SceneManager::RenderScene()
 	positionXYZ = glm::vec3(-10.25f, 0.0f, -3.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	// No texture
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	/*** Draw the Rug ***/
 	SetShaderMaterial("rug");
@@ -1283,11 +2062,11 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture2");
 	SetTextureUVScale(0.75f, 0.75f);
 	// Set the tint intensity for the rug
-	glUniform1f(glGetUniformLocation(ShaderProgramID, "tintIntensity"), 0.8f); // Set intensity to 70%
-	m_basicMeshes->DrawBoxMesh();
+	SetTintIntensity(0.8f); // Set intensity to 70%
+	AddSceneObject(MESH_BOX);
 
 	// Reset the tint intensity to default (no tint) after drawing the rug
-	glUniform1f(glGetUniformLocation(ShaderProgramID, "tintIntensity"), 0.0f);
+	SetTintIntensity(0.0f);
 
 	SetShaderColor(242 / 255.0, 243 / 255.0, 244 / 255.0, 1.0);
 	/*** Draw the Drawer Set ***/
@@ -1299,7 +2078,9 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(13.0f, 2.525f, -0.5f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	SetUseAsOccluder(true);
+	AddSceneObject(MESH_BOX);
+	SetUseAsOccluder(false);
 
 	// Draw the main body of drawers
 	SetShaderColor(231 / 255.0, 232 / 255.0, 233 / 255.0, 1.0);
@@ -1311,7 +2092,7 @@ void SceneManager::RenderScene()
 	SetTextureUVScale(1.0f, 1.0f);
 	SetShaderTexture("texture9");
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw the main body of drawers
 	SetShaderColor(231 / 255.0, 232 / 255.0, 233 / 255.0, 1.0);
@@ -1323,7 +2104,7 @@ void SceneManager::RenderScene()
 	SetTextureUVScale(1.0f, 1.0f);
 	SetShaderTexture("texture9");
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw the main body of drawers
 	SetShaderColor(231 / 255.0, 232 / 255.0, 233 / 255.0, 1.0);
@@ -1335,7 +2116,7 @@ void SceneManager::RenderScene()
 	SetTextureUVScale(1.0f, 1.0f);
 	SetShaderTexture("texture9");
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw the main body of drawers
 
@@ -1348,7 +2129,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(13.0f, 2.525f, -9.5f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(3.45f, 0.5f, 6.5f);
 	XrotationDegrees = 0.0f;
@@ -1356,7 +2137,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(13.0f, 4.75f, -6.25f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(3.45f, 0.05f, 6.5f);
 	XrotationDegrees = 0.0f;
@@ -1364,7 +2145,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(13.0f, 0.05f, -6.25f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(3.45f, 0.05f, 6.5f);
 	XrotationDegrees = 0.0f;
@@ -1372,7 +2153,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(13.0f, 3.0f, -6.25f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(3.45f, 0.05f, 6.5f);
 	XrotationDegrees = 0.0f;
@@ -1380,7 +2161,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(13.0f, 1.5f, -6.25f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw computer shelf
 	scaleXYZ = glm::vec3(2.75f, 0.75f, 2.5f);
@@ -1389,7 +2170,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(7.5f, 0.40f, -8.25f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw computer shelf
 	scaleXYZ = glm::vec3(2.75f, 0.5f, 2.5f);
@@ -1398,7 +2179,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(7.5f, 7.27f, -8.25f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw computer shelf
 	scaleXYZ = glm::vec3(2.75f, 0.15f, 2.5f);
@@ -1407,7 +2188,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(7.5f, 5.27f, -8.25f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw computer shelf
 	scaleXYZ = glm::vec3(2.75f, 0.15f, 2.5f);
@@ -1416,7 +2197,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(7.5f, 3.0f, -8.25f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw computer shelf
 	scaleXYZ = glm::vec3(0.25f, 7.5f, 2.5f);
@@ -1425,7 +2206,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(6.25f, 3.77f, -8.25f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw computer shelf
 	scaleXYZ = glm::vec3(0.25f, 7.5f, 2.5f);
@@ -1434,7 +2215,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(9.0f, 3.77f, -8.25f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw computer shelf
 	scaleXYZ = glm::vec3(0.25f, 7.5f, 2.5f);
@@ -1443,7 +2224,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(7.6f, 3.77f, -8.25f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	/*** Draw Wall boards ***/
 	scaleXYZ = glm::vec3(1.0f, 1.0f, 24.0f);
@@ -1452,7 +2233,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(15.0f, 6.5f, 2.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	/*** Draw Wall boards ***/
 	scaleXYZ = glm::vec3(1.0f, 1.0f, 24.0f);
@@ -1461,14 +2242,15 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-15.0f, 6.5f, 2.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
+	SetUseStaticBatch(false);
 
 	// Set the tint intensity for the rug
-	glUniform1f(glGetUniformLocation(ShaderProgramID, "tintIntensity"), 0.8f); // Set intensity to 70%
-	m_basicMeshes->DrawBoxMesh();
+	SetTintIntensity(0.8f); // Set intensity to 70%
+	AddSceneObject(MESH_BOX);
 
 	// Reset the tint intensity to default (no tint) after drawing the rug
-	glUniform1f(glGetUniformLocation(ShaderProgramID, "tintIntensity"), 0.0f);
+	SetTintIntensity(0.0f);
 	// Render the canvas with unlit shader
 	SetUseLighting(false);
 	SetShaderColor(180 / 255.0, 180 / 255.0, 180 / 255.0, 1.0);
@@ -1479,7 +2261,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(0.0f, 5.0f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(8.0f, 0.75f, 1.0f);
 	XrotationDegrees = 0.0f;
@@ -1487,7 +2269,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(0.0f, 15.0f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(0.75f, 10.75f, 1.0f);
 	XrotationDegrees = 0.0f;
@@ -1495,7 +2277,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-4.0f, 10.0f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(0.75f, 10.75f, 1.0f);
 	XrotationDegrees = 0.0f;
@@ -1503,7 +2285,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(4.0f, 10.0f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(0.35f, 8.75f, 0.75f);
 	XrotationDegrees = 0.0f;
@@ -1511,7 +2293,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(0.25f, 10.0f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(0.35f, 8.75f, 0.75f);
 	XrotationDegrees = 0.0f;
@@ -1519,7 +2301,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-0.25f, 10.0f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(0.35f, 8.75f, 0.75f);
 	XrotationDegrees = 0.0f;
@@ -1527,7 +2309,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-3.25f, 10.0f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(0.35f, 8.75f, 0.75f);
 	XrotationDegrees = 0.0f;
@@ -1535,7 +2317,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(3.25f, 10.0f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(3.25f, 0.35f, 0.75f);
 	XrotationDegrees = 0.0f;
@@ -1543,7 +2325,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(1.75f, 10.0f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(3.25f, 0.35f, 0.75f);
 	XrotationDegrees = 0.0f;
@@ -1551,7 +2333,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-1.75f, 14.25f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(3.25f, 0.35f, 0.75f);
 	XrotationDegrees = 0.0f;
@@ -1559,7 +2341,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(1.75f, 5.75f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(3.25f, 0.35f, 0.75f);
 	XrotationDegrees = 0.0f;
@@ -1567,7 +2349,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-1.75f, 5.75f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(3.25f, 0.35f, 0.75f);
 	XrotationDegrees = 0.0f;
@@ -1575,7 +2357,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(1.75f, 14.25f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(3.25f, 0.35f, 0.75f);
 	XrotationDegrees = 0.0f;
@@ -1583,7 +2365,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-1.75f, 10.0f, -10.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw the window glass and set it to emit light
 	SetShaderMaterial("window_glass");
@@ -1594,7 +2376,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(0.0f, 10.0f, -9.9f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawPlaneMesh();
+	AddSceneObject(MESH_PLANE);
 	// Render the canvas with unlit shader
 	SetUseLighting(true);
 
@@ -1607,7 +2389,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(13.75f, 2.01f, 6.1f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	SetShaderMaterial("glowing_orange");
 	scaleXYZ = glm::vec3(0.25f, 2.0f, 0.25f);
@@ -1616,7 +2398,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(13.75f, 1.5f, 6.8f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Lamp Feet
 	SetShaderMaterial("lamp");
@@ -1627,7 +2409,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(10.0f, 0.0f, -7.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	SetShaderColor(160 / 255.0, 161 / 255.0, 161 / 255.0, 1.0);
 	scaleXYZ = glm::vec3(0.9f, 0.1f, 0.9f);
@@ -1636,7 +2418,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(10.0f, 0.0f, -7.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	SetShaderColor(160 / 255.0, 161 / 255.0, 161 / 255.0, 1.0);
 	scaleXYZ = glm::vec3(0.1f, 1.0f, 0.1f);
@@ -1645,7 +2427,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(10.0f, 8.0f, -7.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	SetShaderColor(160 / 255.0, 161 / 255.0, 161 / 255.0, 1.0);
 	scaleXYZ = glm::vec3(0.1f, 1.0f, 0.1f);
@@ -1654,7 +2436,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(10.0f, 8.0f, -7.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	SetShaderMaterial("lamp_light");
 	SetShaderColor(255 / 255.0, 200 / 255.0, 124 / 255.0, 0.6);
@@ -1664,7 +2446,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(10.0f, 8.5f, -7.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	AddSceneObject(MESH_TAPERED_CYLINDER);
 
 	SetShaderMaterial("lamp");
 	SetShaderColor(160 / 255.0, 161 / 255.0, 161 / 255.0, 1.0);
@@ -1674,7 +2456,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-12.0f, 0.0f, -7.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	SetShaderColor(160 / 255.0, 161 / 255.0, 161 / 255.0, 1.0);
 	scaleXYZ = glm::vec3(0.9f, 0.1f, 0.9f);
@@ -1683,7 +2465,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-12.0f, 0.0f, -7.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 
 	SetShaderMaterial("lamp_light");
@@ -1694,7 +2476,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-12.0f, 6.0f, -7.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	AddSceneObject(MESH_TAPERED_CYLINDER);
 
 	// DESK OBJECT //
 	SetShaderColor(242 / 255.0, 243 / 255.0, 244 / 255.0, 1.0);
@@ -1705,7 +2487,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = -10.0f;
 	positionXYZ = glm::vec3(-8.0f, 0.0f, -6.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	scaleXYZ = glm::vec3(0.1f, 4.0f, 0.1f);
 	XrotationDegrees = 10.0f;
@@ -1713,7 +2495,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = -10.0f;
 	positionXYZ = glm::vec3(-8.0f, 0.0f, -8.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	scaleXYZ = glm::vec3(0.1f, 4.0f, 0.1f);
 	XrotationDegrees = -10.0f;
@@ -1721,7 +2503,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 10.0f;
 	positionXYZ = glm::vec3(2.0f, 0.0f, -6.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	scaleXYZ = glm::vec3(0.1f, 4.0f, 0.1f);
 	XrotationDegrees = 10.0f;
@@ -1729,7 +2511,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 10.0f;
 	positionXYZ = glm::vec3(2.0f, 0.0f, -8.0f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	scaleXYZ = glm::vec3(14.0f, 0.4f, 4.0f);
 	XrotationDegrees = 0.0f;
@@ -1737,7 +2519,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-2.0f, 4.0f, -7.9f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Render the canvas with unlit shader
 	SetUseLighting(false);
@@ -1749,7 +2531,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(4.0f, 1.8f, -7.9f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(1.9f, 3.4f, 3.5f);
 	XrotationDegrees = 0.0f;
@@ -1761,7 +2543,7 @@ void SceneManager::RenderScene()
 	SetTextureUVScale(1.0f, 1.0f);
 	SetTextureOffset(0.5f, 0.5f); // Move texture to see the effect
 	SetShaderTexture("texture6");
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Frame - Bottom
 	SetShaderColor(60 / 255.0, 60 / 255.0, 60 / 255.0, 1.0); // Dark color for the frame
@@ -1772,7 +2554,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-8.0f, 5.5f, -9.8f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Frame - Top
 	SetShaderColor(60 / 255.0, 60 / 255.0, 60 / 255.0, 1.0); // Dark color for the frame
@@ -1782,7 +2564,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-8.0f, 11.1f, -9.8f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Frame - Left
 	SetShaderColor(60 / 255.0, 60 / 255.0, 60 / 255.0, 1.0); // Dark color for the frame
@@ -1792,7 +2574,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-9.75f, 8.3f, -9.80f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Frame - Right
 	SetShaderColor(60 / 255.0, 60 / 255.0, 60 / 255.0, 1.0); // Dark color for the frame
@@ -1802,7 +2584,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-6.25f, 8.3f, -9.80f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Canvas
 	SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f); // White color for the canvas
@@ -1816,7 +2598,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("texture5");
 	SetTextureUVScale(1.0f, 1.0f);
 	SetTextureOffset(0.5f, 0.5f); // Move texture to see the effect
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	SetShaderColor(0 / 255.0, 0 / 255.0, 0 / 255.0, 1.0); // Dark color for the frame
 	SetShaderMaterial("default");
@@ -1827,7 +2609,7 @@ void SceneManager::RenderScene()
 	positionXYZ = glm::vec3(-0.5f, 7.3f, -8.85);
 	// Use the texture tag for this object
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(9.45f, 3.72f, 0.1f);
 	XrotationDegrees = 0.0f;
@@ -1839,7 +2621,7 @@ void SceneManager::RenderScene()
 	SetTextureOffset(0.5f, 0.5f); // Move texture to see the effect
 	SetShaderTexture("texture8");
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	SetShaderMaterial("default");
 	SetShaderColor(30 / 255.0, 30 / 255.0, 30 / 255.0, 1.0);
@@ -1849,7 +2631,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-0.5f, 5.3f, -9.45);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(6.0f, 0.25f, 2.0f);
 	XrotationDegrees = 10.0f;
@@ -1857,7 +2639,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-0.5f, 4.3f, -7.45);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(6.0f, 0.25f, 2.0f);
 	XrotationDegrees = 10.0f;
@@ -1865,7 +2647,7 @@ void SceneManager::RenderScene()
 	ZrotationDegrees = 0.0f;
 	positionXYZ = glm::vec3(-0.5f, 4.3f, -7.45);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	SetShaderMaterial("default");
 	SetShaderColor(50 / 255.0, 50 / 255.0, 50 / 255.0, 1.0);
@@ -1876,7 +2658,7 @@ void SceneManager::RenderScene()
 	positionXYZ = glm::vec3(-0.5f, 4.5f, -7.45);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	SetTextureUVScale(1.0, 1.0);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Reset the lighting flag to true for other objects
 	SetUseLighting(false);
@@ -1888,7 +2670,7 @@ void SceneManager::RenderScene()
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	SetShaderTexture("texture7");
 	SetTextureUVScale(1.0, 1.0);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 	// Reset the lighting flag to true for other objects
 	SetUseLighting(true);
 
@@ -1901,7 +2683,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	SetShaderColor(0 / 255.0, 140 / 255.0, 30 / 255.0, 1.0);
 	// Drawing the plant stem
@@ -1912,7 +2694,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	// Drawing the leaves
 	SetShaderMaterial("leaf_material");
@@ -1924,7 +2706,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE);
 
 	// Right leaf
 	positionXYZ = glm::vec3(12.3f, 6.25f, -7.0f);
@@ -1932,7 +2714,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE);
 
 	// Top leaf
 	positionXYZ = glm::vec3(12.0f, 6.75f, -7.0f);
@@ -1940,7 +2722,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE);
 
 	// Drawing the pot
 	SetShaderColor(200 / 255.0, 200 / 255.0, 200 / 255.0, 1.0);
@@ -1951,7 +2733,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	// Drawing the plant stem
 	SetShaderColor(0 / 255.0, 140 / 255.0, 30 / 255.0, 1.0);
@@ -1962,12 +2744,14 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	// Drawing the grassy leaves
 	SetShaderMaterial("leaf_material");
 
 	glm::vec3 stemPosition = glm::vec3(13.0f, 5.0f, -5.0f); // Position of the stem
+	// the leaves only differ by transform, so draw them instanced
+	SetUseInstancing(true);
 	// Draw multiple grassy leaves
 	for (int i = 0; i < 10; ++i) {
 		float angle = glm::radians(i * 36.0f); // Spread leaves evenly around the stem
@@ -1981,8 +2765,9 @@ void SceneManager::RenderScene()
 		ZrotationDegrees = 0.0f;
 		positionXYZ = glm::vec3(offsetX, offsetY, offsetZ);
 		SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-		m_basicMeshes->DrawCylinderMesh();
+		AddSceneObject(MESH_CYLINDER);
 	}
+	SetUseInstancing(false);
 
 
 	// Drawing the pot
@@ -1994,7 +2779,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	// Drawing the plant stem
 	SetShaderColor(0 / 255.0, 140 / 255.0, 30 / 255.0, 1.0);
@@ -2005,12 +2790,14 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	// Drawing the grassy leaves
 	SetShaderMaterial("leaf_material");
 
 	stemPosition = glm::vec3(12.4f, 5.0f, -3.0f); // Position of the stem
+	// the leaves only differ by transform, so draw them instanced
+	SetUseInstancing(true);
 	// Draw multiple grassy leaves
 	for (int i = 0; i < 10; ++i) {
 		float angle = glm::radians(i * 36.0f); // Spread leaves evenly around the stem
@@ -2024,8 +2811,9 @@ void SceneManager::RenderScene()
 		ZrotationDegrees = 0.0f;
 		positionXYZ = glm::vec3(offsetX, offsetY, offsetZ);
 		SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-		m_basicMeshes->DrawCylinderMesh();
+		AddSceneObject(MESH_CYLINDER);
 	}
+	SetUseInstancing(false);
 
 	// Position the pot
 	SetShaderColor(200 / 255.0, 200 / 255.0, 200 / 255.0, 1.0);
@@ -2036,7 +2824,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(potScale, XrotationDegrees, YrotationDegrees, ZrotationDegrees, potPosition);
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	AddSceneObject(MESH_TAPERED_CYLINDER);
 
 	// Position the stems
 	SetShaderColor(0 / 255.0, 140 / 255.0, 30 / 255.0, 1.0);
@@ -2044,6 +2832,8 @@ void SceneManager::RenderScene()
 	int numStems = 3;
 	float stemOffsets[3][2] = { {0.0f, 0.0f}, {0.15f, 0.15f}, {-0.15f, -0.15f} };
 
+	// the stems and leaves only differ by transform, so draw them instanced
+	SetUseInstancing(true);
 	for (int s = 0; s < numStems; ++s) {
 		float baseX = stemOffsets[s][0];
 		float baseZ = stemOffsets[s][1];
@@ -2051,7 +2841,7 @@ void SceneManager::RenderScene()
 		glm::vec3 stemScale = glm::vec3(0.1f, 2.0f, 0.1f); // Thin and tall
 		glm::vec3 stemPosition = glm::vec3(13.0f + baseX, 6.0f, -5.0f + baseZ); // Adjusted position based on pot's position
 		SetTransformations(stemScale, 0.0f, 0.0f, 0.0f, stemPosition);
-		m_basicMeshes->DrawCylinderMesh();
+		AddSceneObject(MESH_CYLINDER);
 
 		// Position the leaves around each stem
 		SetShaderMaterial("leaf_material");
@@ -2071,21 +2861,24 @@ void SceneManager::RenderScene()
 			float ZrotationDegrees = 45.0f; // Slight tilt for a more natural look
 
 			SetTransformations(leafScale, XrotationDegrees, YrotationDegrees, ZrotationDegrees, leafPosition);
-			m_basicMeshes->DrawBoxMesh();
+			AddSceneObject(MESH_BOX);
 		}
 	}
+	SetUseInstancing(false);
 
 	stemPosition = glm::vec3(-13.0f, 3.55f, -5.0f);
 	numStems = 6;
+	SetUseInstancing(true);
 	for (int s = 0; s < numStems; ++s) {
-		float baseX = stemOffsets[s][0];
-		float baseZ = stemOffsets[s][1];
+		// only three offsets are defined, so the extra stems reuse them
+		float baseX = stemOffsets[s % 3][0];
+		float baseZ = stemOffsets[s % 3][1];
 
 		glm::vec3 stemScale = glm::vec3(0.15f, 3.0f, 0.15f); // Scale up the stems
 		float rotationAngle = s * -10.0f; // Different angles for each stem
 		glm::vec3 stemPosition = glm::vec3(-13.0f + baseX, 3.25f, -5.0f + baseZ); // Adjusted position based on pot's position
 		SetTransformations(stemScale, rotationAngle, rotationAngle, 0.0f, stemPosition);
-		m_basicMeshes->DrawCylinderMesh();
+		AddSceneObject(MESH_CYLINDER);
 
 		// Position the leaves around each stem with spiral effect
 		SetShaderMaterial("leaf_material");
@@ -2105,9 +2898,10 @@ void SceneManager::RenderScene()
 			float ZrotationDegrees = 45.0f; // Slight tilt for a more natural look
 
 			SetTransformations(leafScale, XrotationDegrees, YrotationDegrees, ZrotationDegrees, leafPosition);
-			m_basicMeshes->DrawBoxMesh();
+			AddSceneObject(MESH_BOX);
 		}
 	}
+	SetUseInstancing(false);
 
 	/*** Draw the Chair ***/
 	SetShaderMaterial("default");
@@ -2118,7 +2912,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawTorusMesh();
+	AddSceneObject(MESH_TORUS);
 
 	scaleXYZ = glm::vec3(01.25f, 0.65f, 0.75f);
 	positionXYZ = glm::vec3(-2.0f, 7.0f, -3.0f);
@@ -2126,7 +2920,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawTorusMesh();
+	AddSceneObject(MESH_TORUS);
 
 	// Draw the cylinder inside the torus
 	scaleXYZ = glm::vec3(1.25f, 0.15f, 0.55f);
@@ -2135,7 +2929,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	scaleXYZ = glm::vec3(01.25f, 0.65f, 0.15f);
 	positionXYZ = glm::vec3(-2.0f, 6.0f, -3.0f);
@@ -2143,7 +2937,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(2.75f, 0.5f, 0.05f);
 	positionXYZ = glm::vec3(-2.0f, 5.5f, -3.0f);
@@ -2151,7 +2945,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(1.50f, 0.55f, 0.05f);
 	positionXYZ = glm::vec3(-3.1f, 6.1f, -3.8f);
@@ -2159,7 +2953,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 45.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(1.50f, 0.55f, 0.05f);
 	positionXYZ = glm::vec3(-1.0f, 6.1f, -2.4f);
@@ -2167,7 +2961,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -15.0f;
 	ZrotationDegrees = -45.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(1.95f, 0.95f, 0.75f);
 	positionXYZ = glm::vec3(-2.0f, 4.2f, -3.2f);
@@ -2175,7 +2969,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawTorusMesh();
+	AddSceneObject(MESH_TORUS);
 
 	// Draw the cylinder inside the torus
 	scaleXYZ = glm::vec3(1.75f, 0.15f, 0.75f);
@@ -2184,7 +2978,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	// Draw the cylinder inside the torus
 	scaleXYZ = glm::vec3(2.55f, 0.15f, 0.75f);
@@ -2193,7 +2987,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw the cylinder inside the torus
 	scaleXYZ = glm::vec3(2.55f, 2.3f, 0.75f);
@@ -2202,7 +2996,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 	
 	// Draw the cylinder inside the torus
 	scaleXYZ = glm::vec3(0.25f, 0.15f, 1.0f);
@@ -2211,7 +3005,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	// Draw the cylinder inside the torus
 	scaleXYZ = glm::vec3(0.1f, 0.65f, 0.1f);
@@ -2220,7 +3014,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	// Draw the cylinder inside the torus
 	scaleXYZ = glm::vec3(0.25f, 0.15f, 1.0f);
@@ -2229,7 +3023,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = -35.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX);
 
 	scaleXYZ = glm::vec3(0.2f, 2.0f, 0.2f);
 	positionXYZ = glm::vec3(-1.5f, 1.0f, -3.75f);
@@ -2237,7 +3031,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	scaleXYZ = glm::vec3(0.1f, 3.65f, 0.1f);
 	positionXYZ = glm::vec3(0.5f, 1.0f, -3.75f);
@@ -2245,7 +3039,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 90.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	scaleXYZ = glm::vec3(0.1f, 3.65f, 0.1f);
 	positionXYZ = glm::vec3(-1.5f, 1.0f, -5.65f);
@@ -2253,7 +3047,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER);
 
 	scaleXYZ = glm::vec3(0.4f, 0.4f, 0.4f);
 	positionXYZ = glm::vec3(-1.45f, 0.4f, -5.65f);
@@ -2261,7 +3055,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE);
 
 	scaleXYZ = glm::vec3(0.4f, 0.4f, 0.4f);
 	positionXYZ = glm::vec3(-3.15f, 0.7f, -3.65f);
@@ -2269,7 +3063,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE);
 
 	scaleXYZ = glm::vec3(0.4f, 0.4f, 0.4f);
 	positionXYZ = glm::vec3(-1.45f, 0.7f, -1.85f);
@@ -2277,7 +3071,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE);
 
 	scaleXYZ = glm::vec3(0.4f, 0.4f, 0.4f);
 	positionXYZ = glm::vec3(0.60f, 0.7f, -3.65f);
@@ -2285,7 +3079,7 @@ void SceneManager::RenderScene()
 	YrotationDegrees = 0.0f;
 	ZrotationDegrees = 0.0f;
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE);
 
 
 	SetShaderMaterial("default");
@@ -2294,3 +3088,1223 @@ void SceneManager::RenderScene()
 }
 
 
+/***********************************************************
+ *  AddSceneObject()
+ *
+ *  Adds an object to the scene using the current drawing state.
+ *  The returned index can be passed to SetObjectTransform().
+ ***********************************************************/
+int SceneManager::AddSceneObject(MESH_TYPE mesh)
+{
+	m_objectState.mesh = mesh;
+	m_objects.push_back(m_objectState);
+	m_objectLods.push_back(0);
+
+	// transparent objects are sorted back to front one by
+	// one, so they can't be part of a batch
+	SceneObject& object = m_objects.back();
+	object.bTransparent = object.bTransparent || (object.color.a < 1.0f);
+	if (object.bTransparent)
+	{
+		object.bInstanced = false;
+		object.bStatic = false;
+	}
+
+	int objectIndex = (int)m_objects.size() - 1;
+	m_objectBounds.Resize(objectIndex + 1);
+	m_bObjectTreeDirty = true;
+	UpdateObjectBounds(objectIndex);
+	m_objectDraws.resize(m_objects.size());
+	RecordObjectDraw(objectIndex);
+	m_bRecordingDirty = true;
+
+	// a new caster means the shadow maps are out of date
+	InvalidateShadowMap();
+
+	return objectIndex;
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  Draws one of the basic shape meshes. The coarser levels
+ *  of detail only exist in the mesh library.
+ ***********************************************************/
+void SceneManager::DrawMesh(MESH_TYPE mesh, int lod)
+{
+	MeshLibrary::MESH_INFO info;
+	if ((lod > 0) && FindLibraryMesh(mesh, lod, info))
+	{
+		m_instancedMeshes->DrawMesh(info);
+		return;
+	}
+
+	switch (mesh)
+	{
+	case MESH_PLANE:
+		m_basicMeshes->DrawPlaneMesh();
+		break;
+	case MESH_BOX:
+		m_basicMeshes->DrawBoxMesh();
+		break;
+	case MESH_CYLINDER:
+		m_basicMeshes->DrawCylinderMesh();
+		break;
+	case MESH_TAPERED_CYLINDER:
+		m_basicMeshes->DrawTaperedCylinderMesh();
+		break;
+	case MESH_TORUS:
+		m_basicMeshes->DrawTorusMesh();
+		break;
+	case MESH_SPHERE:
+		m_basicMeshes->DrawSphereMesh();
+		break;
+	}
+
+	// the basic shapes bind their vertex arrays themselves
+	GLStateCache::Get().InvalidateVertexArray();
+}
+
+/***********************************************************
+ *  ApplyObjectState()
+ *
+ *  Sends an object's drawing state to the shader, skipping
+ *  the values that match the previously drawn object.
+ ***********************************************************/
+void SceneManager::ApplyObjectState(const SceneObject& object, const SceneObject* previous)
+{
+	// the material values are already in the material table
+	if ((object.materialIndex >= 0) &&
+		((previous == NULL) || (previous->materialIndex != object.materialIndex)))
+	{
+		m_pShaderManager->setIntValue(g_MaterialIndexName, object.materialIndex);
+	}
+	if ((previous == NULL) || (previous->bUseTexture != object.bUseTexture))
+	{
+		m_pShaderManager->setIntValue(g_UseTextureName, object.bUseTexture);
+	}
+	if ((previous == NULL) || (previous->textureLayer != object.textureLayer))
+	{
+		m_pShaderManager->setIntValue(g_TextureLayerName, object.textureLayer);
+	}
+	if ((previous == NULL) || (previous->color != object.color))
+	{
+		m_pShaderManager->setVec4Value(g_ColorValueName, object.color);
+	}
+	if ((previous == NULL) || (previous->uvScale != object.uvScale))
+	{
+		m_pShaderManager->setVec2Value("UVscale", object.uvScale);
+	}
+	if ((previous == NULL) || (previous->bUseLighting != object.bUseLighting))
+	{
+		m_pShaderManager->setBoolValue(g_UseLightingName, object.bUseLighting);
+	}
+	if ((previous == NULL) || (previous->tintIntensity != object.tintIntensity))
+	{
+		m_pShaderManager->setFloatValue("tintIntensity", object.tintIntensity);
+	}
+}
+
+/***********************************************************
+ *  RenderSceneObjects()
+ *
+ *  Draws the main pass packets of the render queue, which
+ *  are sorted so objects sharing state are drawn together.
+ *  With multi-draw, each run of single objects goes out
+ *  with one call instead of one call per object.
+ ***********************************************************/
+void SceneManager::RenderSceneObjects()
+{
+	const std::vector<RenderQueue::DRAW_PACKET>& packets = m_renderQueue.GetPackets();
+	size_t passEnd = m_renderQueue.GetPassEnd(RenderQueue::PASS_MAIN);
+	const SceneObject* previous = NULL;
+	bool bInstancing = false;
+	bool bBlending = false;
+	size_t nextRun = 0;
+	int drawCalls = 0;
+
+	for (int lod = 0; lod < MeshLibrary::LOD_COUNT; lod++)
+	{
+		m_lodTriangles[lod] = 0;
+	}
+
+	for (size_t i = m_renderQueue.GetPassBegin(RenderQueue::PASS_MAIN); i < passEnd; i++)
+	{
+		const RenderQueue::DRAW_PACKET& packet = packets[i];
+
+		// the static batch is drawn through the instanced path too
+		bool bInstancedPacket = (packet.state.program != g_BasicProgram);
+		if (bInstancedPacket != bInstancing)
+		{
+			m_pShaderManager->setBoolValue(g_UseInstancingName, bInstancedPacket);
+			bInstancing = bInstancedPacket;
+		}
+
+		// the transparent packets come after every opaque one;
+		// they are blended, and tested against the depth of the
+		// opaque objects without hiding each other
+		if (packet.bTransparent && !bBlending)
+		{
+			GLStateCache::Get().SetEnabled(GL_BLEND, true);
+			GLStateCache::Get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			GLStateCache::Get().DepthMask(false);
+			bBlending = true;
+		}
+
+		if ((nextRun < m_multiDrawRuns.size()) && (m_multiDrawRuns[nextRun].firstPacket == i))
+		{
+			// every per-object value comes from the draw list
+			const MULTI_DRAW_RUN& run = m_multiDrawRuns[nextRun];
+			m_pShaderManager->setBoolValue(g_UseMultiDrawName, true);
+			m_pShaderManager->setIntValue(g_DrawBaseName, run.firstDraw);
+			m_multiDrawList.Draw(m_instancedMeshes->GetVertexArray(), run.firstDraw, run.drawCount);
+			m_pShaderManager->setBoolValue(g_UseMultiDrawName, false);
+			for (size_t j = i; j < i + run.packetCount; j++)
+			{
+				unsigned int objectIndex = packets[j].objectIndex;
+				CountLodTriangles(m_objects[objectIndex].mesh, m_objectLods[objectIndex], 1);
+			}
+
+			// the uniforms no longer match any drawn object
+			previous = NULL;
+			i += run.packetCount - 1;
+			nextRun++;
+		}
+		else if (packet.state.program == g_StaticProgram)
+		{
+			const STATIC_BATCH& batch = m_staticBatches[packet.objectIndex];
+			ApplyObjectState(batch.state, previous);
+			m_instancedMeshes->DrawStaticGroup(batch.group, batch.instanceBuffer);
+			previous = &batch.state;
+		}
+		else if (bInstancedPacket)
+		{
+			const INSTANCE_BATCH& batch = m_instanceBatches[packet.objectIndex];
+			ApplyObjectState(batch.state, previous);
+			DrawInstanceBatch(batch);
+			CountLodTriangles(batch.state.mesh, batch.lod, batch.instanceCount);
+			previous = &batch.state;
+		}
+		else
+		{
+			const SceneObject& object = m_objects[packet.objectIndex];
+			ApplyObjectState(object, previous);
+			m_pShaderManager->setMat4Value(g_ModelName, object.modelMatrix);
+			DrawMesh(object.mesh, m_objectLods[packet.objectIndex]);
+			CountLodTriangles(object.mesh, m_objectLods[packet.objectIndex], 1);
+			previous = &object;
+		}
+		drawCalls++;
+	}
+
+	if (bInstancing)
+	{
+		m_pShaderManager->setBoolValue(g_UseInstancingName, false);
+	}
+	if (bBlending)
+	{
+		GLStateCache::Get().SetEnabled(GL_BLEND, false);
+		GLStateCache::Get().DepthMask(true);
+	}
+
+	if (!m_bReportedQueueStats)
+	{
+		std::cout << "Render queue: " << packets.size() << " draws, "
+			<< m_renderQueue.GetSortedStateChanges() << " state changes ("
+			<< m_renderQueue.GetStateChangesSaved() << " saved by sorting), "
+			<< drawCalls << " main pass draw calls, "
+			<< m_culledMainDraws << " draws culled by the camera, "
+			<< m_culledShadowDraws << " by the shadow cascades, "
+			<< m_occludedDraws << " hidden by occluders" << std::endl;
+		std::cout << "Round mesh triangles by level of detail:";
+		for (int lod = 0; lod < MeshLibrary::LOD_COUNT; lod++)
+		{
+			std::cout << " " << m_lodTriangles[lod];
+		}
+		std::cout << std::endl;
+		m_bReportedQueueStats = true;
+	}
+}
+
+/***********************************************************
+ *  BuildMultiDrawList()
+ *
+ *  Writes the indirect draw commands of the frame, for the
+ *  shadow pass of each cascade and of the point lights,
+ *  followed by the main pass, so every pass replays the
+ *  one list with its own program.
+ ***********************************************************/
+void SceneManager::BuildMultiDrawList()
+{
+	m_multiDrawList.Clear();
+	for (int cascade = 0; cascade < SHADOW_CASCADES; cascade++)
+	{
+		AddMultiDrawRuns((RenderQueue::RENDER_PASS)(RenderQueue::PASS_SHADOW + cascade), m_shadowDrawRuns[cascade]);
+	}
+	AddMultiDrawRuns(g_PointShadowPass, m_pointShadowDrawRuns);
+	AddMultiDrawRuns(RenderQueue::PASS_MAIN, m_multiDrawRuns);
+	m_multiDrawList.Upload();
+}
+
+/***********************************************************
+ *  AddMultiDrawRuns()
+ *
+ *  Adds a draw for every single object in one pass of the
+ *  sorted packets, and splits them into runs that can each
+ *  be submitted with one call. A run ends at a batch, at a
+ *  mesh the library does not hold, or where the transparent
+ *  draws start.
+ ***********************************************************/
+void SceneManager::AddMultiDrawRuns(RenderQueue::RENDER_PASS pass, std::vector<MULTI_DRAW_RUN>& runs)
+{
+	const std::vector<RenderQueue::DRAW_PACKET>& packets = m_renderQueue.GetPackets();
+	size_t passEnd = m_renderQueue.GetPassEnd(pass);
+
+	runs.clear();
+
+	MULTI_DRAW_RUN run;
+	run.firstPacket = 0;
+	run.packetCount = 0;
+	run.firstDraw = 0;
+	run.drawCount = 0;
+	run.bTransparent = false;
+
+	for (size_t i = m_renderQueue.GetPassBegin(pass); i <= passEnd; i++)
+	{
+		int objectIndex = -1;
+		MeshLibrary::MESH_INFO mesh;
+
+		if ((i < passEnd) && (packets[i].state.program == g_BasicProgram))
+		{
+			objectIndex = (int)packets[i].objectIndex;
+			if (!FindLibraryMesh(m_objects[objectIndex].mesh, m_objectLods[objectIndex], mesh))
+			{
+				objectIndex = -1;
+			}
+		}
+
+		// close the current run when this packet can't join it;
+		// blending is switched on between opaque and transparent
+		bool bJoins = (objectIndex >= 0) && (run.drawCount > 0) &&
+			(packets[i].bTransparent == run.bTransparent);
+		if ((run.drawCount > 0) && !bJoins)
+		{
+			runs.push_back(run);
+			run.drawCount = 0;
+		}
+
+		if (objectIndex < 0)
+		{
+			continue;
+		}
+
+		// the object's values were recorded when it last changed
+		int draw = m_multiDrawList.AddDraw(mesh, m_objectDraws[objectIndex]);
+
+		if (run.drawCount == 0)
+		{
+			run.firstPacket = i;
+			run.packetCount = 0;
+			run.firstDraw = draw;
+			run.bTransparent = packets[i].bTransparent;
+		}
+		run.packetCount++;
+		run.drawCount++;
+	}
+}
+
+/***********************************************************
+ *  RecordObjectDraw()
+ *
+ *  Writes an object's values in the layout of the multi-draw
+ *  list. They are kept across frames, and only written again
+ *  when the object changes.
+ ***********************************************************/
+void SceneManager::RecordObjectDraw(int objectIndex)
+{
+	const SceneObject& object = m_objects[objectIndex];
+	MultiDrawList::DRAW_DATA& data = m_objectDraws[objectIndex];
+
+	data.modelMatrix = object.modelMatrix;
+	data.color = object.color;
+	data.uvScale = object.uvScale;
+	data.materialIndex = (object.materialIndex >= 0) ? object.materialIndex : 0;
+	data.textureLayer = object.bUseTexture ? object.textureLayer : 0;
+	data.flags = (object.bUseTexture ? MultiDrawList::DRAW_USE_TEXTURE : 0) |
+		(object.bUseLighting ? MultiDrawList::DRAW_USE_LIGHTING : 0);
+	data.tintIntensity = object.tintIntensity;
+	data.padding[0] = 0;
+	data.padding[1] = 0;
+}
+
+/***********************************************************
+ *  FindLibraryMesh()
+ *
+ *  Finds where one of the basic shape meshes lives in the
+ *  mesh library, at a level of detail. The torus is only in
+ *  the basic shapes.
+ ***********************************************************/
+bool SceneManager::FindLibraryMesh(MESH_TYPE mesh, int lod, MeshLibrary::MESH_INFO& info)
+{
+	switch (mesh)
+	{
+	case MESH_PLANE:
+		info = m_instancedMeshes->GetPlaneMesh();
+		return true;
+	case MESH_BOX:
+		info = m_instancedMeshes->GetBoxMesh();
+		return true;
+	case MESH_CYLINDER:
+		info = m_instancedMeshes->GetCylinderMesh(lod);
+		return true;
+	case MESH_TAPERED_CYLINDER:
+		info = m_instancedMeshes->GetTaperedCylinderMesh(lod);
+		return true;
+	case MESH_SPHERE:
+		info = m_instancedMeshes->GetSphereMesh(lod);
+		return true;
+	default:
+		return false;
+	}
+}
+
+/***********************************************************
+ *  HasMeshLods()
+ *
+ *  Whether the mesh library holds coarser levels of detail
+ *  of a mesh.
+ ***********************************************************/
+bool SceneManager::HasMeshLods(MESH_TYPE mesh)
+{
+	return (mesh == MESH_CYLINDER) || (mesh == MESH_TAPERED_CYLINDER) || (mesh == MESH_SPHERE);
+}
+
+/***********************************************************
+ *  SelectMeshLod()
+ *
+ *  Picks the level of detail from the radius, in pixels, of
+ *  a bounding sphere projected onto the screen. The level
+ *  only changes once the radius is well past a threshold,
+ *  so an object sitting on the edge doesn't pop back and
+ *  forth.
+ ***********************************************************/
+int SceneManager::SelectMeshLod(int currentLod, float distance, float radius)
+{
+	float pixelRadius;
+	// an orthographic projection keeps the same size at any
+	// distance, and its [1][1] is already one over the half height
+	if (m_projectionMatrix[3][3] == 1.0f)
+	{
+		pixelRadius = radius * m_projectionMatrix[1][1] * 0.5f * m_ScreenHeight;
+	}
+	else
+	{
+		// anything the camera is inside of is as big as it gets
+		if (distance <= radius)
+		{
+			return 0;
+		}
+		pixelRadius = radius / distance * m_projectionMatrix[1][1] * 0.5f * m_ScreenHeight;
+	}
+
+	int lod = currentLod;
+	while ((lod > 0) && (pixelRadius > g_LodPixelRadius[lod - 1] * (1.0f + g_LodHysteresis)))
+	{
+		lod--;
+	}
+	while ((lod < MeshLibrary::LOD_COUNT - 1) && (pixelRadius < g_LodPixelRadius[lod] * (1.0f - g_LodHysteresis)))
+	{
+		lod++;
+	}
+	return lod;
+}
+
+/***********************************************************
+ *  CountLodTriangles()
+ *
+ *  Adds the triangles of a draw to the counter of its level
+ *  of detail. Only the meshes with levels are counted.
+ ***********************************************************/
+void SceneManager::CountLodTriangles(MESH_TYPE mesh, int lod, int instanceCount)
+{
+	MeshLibrary::MESH_INFO info;
+	if (HasMeshLods(mesh) && FindLibraryMesh(mesh, lod, info))
+	{
+		m_lodTriangles[lod] += (info.indexCount / 3) * instanceCount;
+	}
+}
+
+/***********************************************************
+ *  BuildRenderQueue()
+ *
+ *  Fills the render queue with a packet for every draw of
+ *  the frame and sorts it. Shadow packets are only added
+ *  for the cascades that are going to be rendered.
+ ***********************************************************/
+void SceneManager::BuildRenderQueue()
+{
+	m_renderQueue.Clear();
+	m_culledMainDraws = 0;
+	m_culledShadowDraws = 0;
+	m_occludedDraws = 0;
+
+	// the cascades are fitted around the objects the camera
+	// sees, so those are culled first
+	if (m_bObjectTreeDirty)
+	{
+		BuildObjectTree();
+	}
+	glm::mat4 viewProjection = m_projectionMatrix * m_viewMatrix;
+	m_objectTree.Cull(viewProjection, m_objectVisible);
+	UpdateShadowCascades();
+
+	// cull the batches against the camera, and the objects and
+	// batches against each cascade that is going to be
+	// rendered; the culls and the occlusion buffer don't
+	// depend on each other, so they run as separate jobs
+	JobSystem::Get().ParallelFor(CULL_JOB_COUNT, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t job = begin; job < end; job++)
+		{
+			switch (job)
+			{
+			case CULL_CAMERA_BATCHES:
+				m_batchBounds.Cull(viewProjection, m_batchVisible);
+				break;
+			case RENDER_OCCLUDERS:
+				RenderOcclusionBuffer(viewProjection);
+				break;
+			default:
+			{
+				int cascade = (int)job - CULL_FIRST_CASCADE;
+				if (m_bCascadeDirty[cascade])
+				{
+					m_objectTree.Cull(m_cascadeCullMatrices[cascade], m_objectCasting[cascade]);
+					m_batchBounds.Cull(m_cascadeCullMatrices[cascade], m_batchCasting[cascade]);
+				}
+				break;
+			}
+			}
+		}
+	});
+	bool bTestOcclusion = (m_occlusionBuffer.GetOccluderCount() > 0);
+	// the point light casters aren't culled here, since the
+	// lights move every frame; the geometry shader drops the
+	// triangles outside each face instead
+	bool bPointShadows = HasPointLightShadows();
+
+	// the single objects are split between jobs, each writing
+	// packets of its own that are merged in order afterwards,
+	// so the queue comes out the same on any number of cores
+	size_t chunkCount = (m_objects.size() + g_ObjectsPerJob - 1) / g_ObjectsPerJob;
+	if (m_packetChunks.size() < chunkCount)
+	{
+		m_packetChunks.resize(chunkCount);
+	}
+	JobSystem::Get().ParallelFor(m_objects.size(), g_ObjectsPerJob, [&](size_t begin, size_t end)
+	{
+		BuildObjectPackets(begin, end, bTestOcclusion, bPointShadows, m_packetChunks[begin / g_ObjectsPerJob]);
+	});
+	for (size_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		m_renderQueue.AddPackets(m_packetChunks[chunk].packets);
+		m_culledMainDraws += m_packetChunks[chunk].culledMainDraws;
+		m_culledShadowDraws += m_packetChunks[chunk].culledShadowDraws;
+		m_occludedDraws += m_packetChunks[chunk].occludedDraws;
+	}
+
+	// the batches are few, so they stay on the calling thread
+	for (size_t i = 0; i < m_instanceBatches.size(); i++)
+	{
+		const SceneObject& batchState = m_instanceBatches[i].state;
+		RenderQueue::DRAW_STATE state;
+
+		state.program = g_InstancedProgram;
+		state.texture = 0;
+		state.material = 0;
+		state.mesh = batchState.mesh;
+		for (int cascade = 0; cascade < SHADOW_CASCADES; cascade++)
+		{
+			if (!m_bCascadeDirty[cascade])
+			{
+				continue;
+			}
+			if (!m_batchCasting[cascade][i])
+			{
+				m_culledShadowDraws++;
+				continue;
+			}
+			m_renderQueue.AddPacket((RenderQueue::RENDER_PASS)(RenderQueue::PASS_SHADOW + cascade), false, state, 0.0f, (unsigned int)i);
+		}
+		if (bPointShadows)
+		{
+			m_renderQueue.AddPacket(g_PointShadowPass, false, state, 0.0f, (unsigned int)i);
+		}
+
+		if (!m_batchVisible[i])
+		{
+			m_culledMainDraws++;
+			continue;
+		}
+
+		INSTANCE_BATCH& batch = m_instanceBatches[i];
+		if (bTestOcclusion && m_occlusionBuffer.IsOccluded(batch.boundsMin, batch.boundsMax))
+		{
+			m_occludedDraws++;
+			continue;
+		}
+
+		// the batch is drawn at the level its largest instance
+		// would need at the nearest point of the batch
+		if (HasMeshLods(batchState.mesh))
+		{
+			glm::vec3 nearest = glm::clamp(m_viewPosition, batch.boundsMin, batch.boundsMax);
+			batch.lod = SelectMeshLod(batch.lod, glm::length(nearest - m_viewPosition), batch.maxRadius);
+		}
+
+		state.program = g_InstancedProgram;
+		state.texture = batchState.bUseTexture ? (batchState.textureLayer + 1) : 0;
+		state.material = batchState.materialIndex + 1;
+		state.mesh = batchState.mesh;
+		m_renderQueue.AddPacket(RenderQueue::PASS_MAIN, false, state, 0.0f, (unsigned int)i);
+	}
+
+	for (size_t i = 0; i < m_staticBatches.size(); i++)
+	{
+		const SceneObject& batchState = m_staticBatches[i].state;
+		RenderQueue::DRAW_STATE state;
+		size_t batchIndex = m_instanceBatches.size() + i;
+
+		state.program = g_StaticProgram;
+		state.texture = 0;
+		state.material = 0;
+		state.mesh = 0;
+		for (int cascade = 0; cascade < SHADOW_CASCADES; cascade++)
+		{
+			if (!m_bCascadeDirty[cascade])
+			{
+				continue;
+			}
+			if (!m_batchCasting[cascade][batchIndex])
+			{
+				m_culledShadowDraws++;
+				continue;
+			}
+			m_renderQueue.AddPacket((RenderQueue::RENDER_PASS)(RenderQueue::PASS_SHADOW + cascade), false, state, 0.0f, (unsigned int)i);
+		}
+		if (bPointShadows)
+		{
+			m_renderQueue.AddPacket(g_PointShadowPass, false, state, 0.0f, (unsigned int)i);
+		}
+
+		if (!m_batchVisible[batchIndex])
+		{
+			m_culledMainDraws++;
+			continue;
+		}
+
+		state.program = g_StaticProgram;
+		state.texture = batchState.bUseTexture ? (batchState.textureLayer + 1) : 0;
+		state.material = 0;
+		state.mesh = 0;
+		m_renderQueue.AddPacket(RenderQueue::PASS_MAIN, false, state, 0.0f, (unsigned int)i);
+	}
+
+	m_renderQueue.Sort();
+}
+
+/***********************************************************
+ *  BuildObjectPackets()
+ *
+ *  Culls a range of the single objects, picks their levels
+ *  of detail and builds their packets. Jobs run this on
+ *  separate threads, so it only writes to its own chunk and
+ *  to the levels of detail of its own objects.
+ ***********************************************************/
+void SceneManager::BuildObjectPackets(size_t begin, size_t end, bool bTestOcclusion, bool bPointShadows, PACKET_CHUNK& chunk)
+{
+	chunk.packets.clear();
+	chunk.culledMainDraws = 0;
+	chunk.culledShadowDraws = 0;
+	chunk.occludedDraws = 0;
+
+	for (size_t i = begin; i < end; i++)
+	{
+		const SceneObject& object = m_objects[i];
+		if (object.bInstanced || object.bStatic)
+		{
+			continue;
+		}
+
+		glm::vec3 position = glm::vec3(object.modelMatrix[3]);
+		RenderQueue::DRAW_STATE state;
+
+		// the depth program only cares about the mesh
+		state.program = g_BasicProgram;
+		state.texture = 0;
+		state.material = 0;
+		state.mesh = object.mesh;
+		float lightDepth = glm::length(position - m_shadowLightPosition) / g_QueueDepthRange;
+		for (int cascade = 0; cascade < SHADOW_CASCADES; cascade++)
+		{
+			if (!m_bCascadeDirty[cascade])
+			{
+				continue;
+			}
+			if (!m_objectCasting[cascade][i])
+			{
+				chunk.culledShadowDraws++;
+				continue;
+			}
+			chunk.packets.push_back(RenderQueue::MakePacket((RenderQueue::RENDER_PASS)(RenderQueue::PASS_SHADOW + cascade),
+				false, state, lightDepth, (unsigned int)i));
+		}
+		if (bPointShadows)
+		{
+			chunk.packets.push_back(RenderQueue::MakePacket(g_PointShadowPass, false, state, 0.0f, (unsigned int)i));
+		}
+
+		if (!m_objectVisible[i])
+		{
+			chunk.culledMainDraws++;
+			continue;
+		}
+
+		if (bTestOcclusion && !object.bOccluder)
+		{
+			glm::vec3 boundsMin, boundsMax;
+			m_objectBounds.GetBounds((int)i, boundsMin, boundsMax);
+			if (m_occlusionBuffer.IsOccluded(boundsMin, boundsMax))
+			{
+				chunk.occludedDraws++;
+				continue;
+			}
+		}
+
+		if (HasMeshLods(object.mesh))
+		{
+			glm::vec3 boundsMin, boundsMax;
+			m_objectBounds.GetBounds((int)i, boundsMin, boundsMax);
+			glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+			m_objectLods[i] = SelectMeshLod(m_objectLods[i],
+				glm::length(center - m_viewPosition), glm::length(boundsMax - center));
+		}
+
+		state.program = g_BasicProgram;
+		state.texture = object.bUseTexture ? (object.textureLayer + 1) : 0;
+		state.material = object.materialIndex + 1;
+		state.mesh = object.mesh;
+		chunk.packets.push_back(RenderQueue::MakePacket(RenderQueue::PASS_MAIN, object.bTransparent, state,
+			glm::length(position - m_viewPosition) / g_QueueDepthRange, (unsigned int)i));
+	}
+}
+
+/***********************************************************
+ *  SetViewParameters()
+ *
+ *  Receives the camera for the frame, used to sort the
+ *  draws by their distance to the viewer.
+ ***********************************************************/
+void SceneManager::SetViewParameters(glm::mat4 view, glm::mat4 projection, glm::vec3 viewPosition)
+{
+	m_viewMatrix = view;
+	m_projectionMatrix = projection;
+	m_viewPosition = viewPosition;
+}
+
+/***********************************************************
+ *  BuildInstanceBatches()
+ *
+ *  Gathers the objects marked for instancing into batches
+ *  that share a mesh and drawing state, and uploads the
+ *  per-instance transform and color of each batch.
+ ***********************************************************/
+void SceneManager::BuildInstanceBatches()
+{
+	for (size_t i = 0; i < m_instanceBatches.size(); i++)
+	{
+		m_instancedMeshes->DestroyInstanceBuffer(m_instanceBatches[i].instanceBuffer);
+	}
+	m_instanceBatches.clear();
+
+	std::vector< std::vector<MeshLibrary::INSTANCE_DATA> > batchInstances;
+
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		SceneObject& object = m_objects[i];
+		if (!object.bInstanced)
+		{
+			continue;
+		}
+		// only the box and cylinder are available for instancing
+		if ((object.mesh != MESH_BOX) && (object.mesh != MESH_CYLINDER))
+		{
+			object.bInstanced = false;
+			continue;
+		}
+
+		size_t batch = 0;
+		while ((batch < m_instanceBatches.size()) &&
+			!HasSameInstanceState(m_instanceBatches[batch].state, object))
+		{
+			batch++;
+		}
+		if (batch == m_instanceBatches.size())
+		{
+			INSTANCE_BATCH newBatch;
+			newBatch.state = object;
+			newBatch.instanceBuffer = 0;
+			newBatch.instanceCount = 0;
+			newBatch.boundsMin = glm::vec3(FLT_MAX);
+			newBatch.boundsMax = glm::vec3(-FLT_MAX);
+			newBatch.maxRadius = 0.0f;
+			newBatch.lod = 0;
+			m_instanceBatches.push_back(newBatch);
+			batchInstances.push_back(std::vector<MeshLibrary::INSTANCE_DATA>());
+		}
+
+		AddToBatchBounds((int)i, m_instanceBatches[batch].boundsMin, m_instanceBatches[batch].boundsMax);
+		glm::vec3 objectMin, objectMax;
+		m_objectBounds.GetBounds((int)i, objectMin, objectMax);
+		m_instanceBatches[batch].maxRadius =
+			std::max(m_instanceBatches[batch].maxRadius, 0.5f * glm::length(objectMax - objectMin));
+
+		MeshLibrary::INSTANCE_DATA instance;
+		instance.modelMatrix = object.modelMatrix;
+		instance.color = object.color;
+		instance.materialIndex = (object.materialIndex >= 0) ? object.materialIndex : 0;
+		batchInstances[batch].push_back(instance);
+	}
+
+	for (size_t batch = 0; batch < m_instanceBatches.size(); batch++)
+	{
+		m_instanceBatches[batch].instanceBuffer = m_instancedMeshes->CreateInstanceBuffer(batchInstances[batch]);
+		m_instanceBatches[batch].instanceCount = (GLsizei)batchInstances[batch].size();
+	}
+
+	UpdateBatchBounds();
+}
+
+/***********************************************************
+ *  HasSameInstanceState()
+ *
+ *  Checks whether two objects can share an instanced draw,
+ *  which leaves the transform, color and material free to
+ *  differ.
+ ***********************************************************/
+bool SceneManager::HasSameInstanceState(const SceneObject& a, const SceneObject& b)
+{
+	return (a.mesh == b.mesh) &&
+		(a.bUseTexture == b.bUseTexture) &&
+		(a.textureLayer == b.textureLayer) &&
+		(a.bUseLighting == b.bUseLighting) &&
+		(a.uvScale == b.uvScale) &&
+		(a.tintIntensity == b.tintIntensity);
+}
+
+/***********************************************************
+ *  BuildStaticBatches()
+ *
+ *  Bakes the objects marked as static into world space
+ *  groups of the static batch. Objects only need the same
+ *  texture, color and lighting to share a group, since the
+ *  UV scale is baked into the vertices and the material is
+ *  stored with every vertex.
+ ***********************************************************/
+void SceneManager::BuildStaticBatches()
+{
+	for (size_t i = 0; i < m_staticBatches.size(); i++)
+	{
+		m_instancedMeshes->DestroyInstanceBuffer(m_staticBatches[i].instanceBuffer);
+	}
+	m_staticBatches.clear();
+	m_instancedMeshes->ClearStaticBatch();
+
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		SceneObject& object = m_objects[i];
+		if (!object.bStatic)
+		{
+			continue;
+		}
+		// only the plane, box and cylinder can be baked, and see-through
+		// objects have to stay separate to be sorted back to front
+		if (object.bInstanced || (object.color.a < 1.0f) ||
+			((object.mesh != MESH_PLANE) && (object.mesh != MESH_BOX) && (object.mesh != MESH_CYLINDER)))
+		{
+			object.bStatic = false;
+			continue;
+		}
+
+		size_t batch = 0;
+		while ((batch < m_staticBatches.size()) &&
+			!HasSameStaticState(m_staticBatches[batch].state, object))
+		{
+			batch++;
+		}
+		if (batch == m_staticBatches.size())
+		{
+			STATIC_BATCH newBatch;
+			newBatch.state = object;
+			newBatch.state.modelMatrix = glm::mat4(1.0f);
+			newBatch.state.uvScale = glm::vec2(1.0f, 1.0f);
+			newBatch.group = m_instancedMeshes->AddStaticGroup();
+			newBatch.instanceBuffer = 0;
+			newBatch.boundsMin = glm::vec3(FLT_MAX);
+			newBatch.boundsMax = glm::vec3(-FLT_MAX);
+			m_staticBatches.push_back(newBatch);
+		}
+
+		STATIC_BATCH& staticBatch = m_staticBatches[batch];
+		AddToBatchBounds((int)i, staticBatch.boundsMin, staticBatch.boundsMax);
+		GLint materialIndex = (object.materialIndex >= 0) ? object.materialIndex : 0;
+		if (object.mesh == MESH_PLANE)
+		{
+			m_instancedMeshes->AddStaticPlaneMesh(staticBatch.group, object.modelMatrix, object.uvScale, materialIndex);
+		}
+		else if (object.mesh == MESH_BOX)
+		{
+			m_instancedMeshes->AddStaticBoxMesh(staticBatch.group, object.modelMatrix, object.uvScale, materialIndex);
+		}
+		else
+		{
+			m_instancedMeshes->AddStaticCylinderMesh(staticBatch.group, object.modelMatrix, object.uvScale, materialIndex);
+		}
+	}
+
+	m_instancedMeshes->UploadStaticBatch();
+
+	// the baked vertices are already in world space, so each group
+	// is drawn as a single instance with an identity transform
+	for (size_t batch = 0; batch < m_staticBatches.size(); batch++)
+	{
+		std::vector<MeshLibrary::INSTANCE_DATA> instance(1);
+		instance[0].modelMatrix = glm::mat4(1.0f);
+		instance[0].color = m_staticBatches[batch].state.color;
+		instance[0].materialIndex = 0;
+		m_staticBatches[batch].instanceBuffer = m_instancedMeshes->CreateInstanceBuffer(instance);
+	}
+
+	UpdateBatchBounds();
+}
+
+/***********************************************************
+ *  GetMeshBounds()
+ *
+ *  Gets the local bounds of one of the basic shape meshes.
+ *  The torus bounds are kept loose, so they hold it in any
+ *  orientation.
+ ***********************************************************/
+void SceneManager::GetMeshBounds(MESH_TYPE mesh, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	switch (mesh)
+	{
+	case MESH_PLANE:
+		boundsMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+		boundsMax = glm::vec3(1.0f, 0.0f, 1.0f);
+		break;
+	case MESH_BOX:
+		boundsMin = glm::vec3(-0.5f);
+		boundsMax = glm::vec3(0.5f);
+		break;
+	case MESH_CYLINDER:
+	case MESH_TAPERED_CYLINDER:
+		boundsMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+		boundsMax = glm::vec3(1.0f, 1.0f, 1.0f);
+		break;
+	case MESH_SPHERE:
+		boundsMin = glm::vec3(-1.0f);
+		boundsMax = glm::vec3(1.0f);
+		break;
+	default:
+		boundsMin = glm::vec3(-1.5f);
+		boundsMax = glm::vec3(1.5f);
+		break;
+	}
+}
+
+/***********************************************************
+ *  UpdateObjectBounds()
+ *
+ *  Recomputes the world space bounds of an object from its
+ *  mesh bounds and model matrix.
+ ***********************************************************/
+void SceneManager::UpdateObjectBounds(int objectIndex)
+{
+	const SceneObject& object = m_objects[objectIndex];
+	glm::vec3 localMin, localMax, worldMin, worldMax;
+
+	GetMeshBounds(object.mesh, localMin, localMax);
+	FrustumCuller::TransformBounds(localMin, localMax, object.modelMatrix, worldMin, worldMax);
+	m_objectBounds.SetBounds(objectIndex, worldMin, worldMax);
+
+	// a moved object only refits the tree; new objects
+	// are picked up when it is next built
+	if (!m_bObjectTreeDirty)
+	{
+		m_objectTree.Refit(objectIndex, worldMin, worldMax);
+	}
+}
+
+/***********************************************************
+ *  BuildObjectTree()
+ *
+ *  Builds the bounding volume hierarchy over the world space
+ *  bounds of every scene object.
+ ***********************************************************/
+void SceneManager::BuildObjectTree()
+{
+	int objectCount = m_objectBounds.GetCount();
+	std::vector<glm::vec3> boundsMin(objectCount);
+	std::vector<glm::vec3> boundsMax(objectCount);
+
+	for (int i = 0; i < objectCount; i++)
+	{
+		m_objectBounds.GetBounds(i, boundsMin[i], boundsMax[i]);
+	}
+
+	m_objectTree.Build(boundsMin, boundsMax);
+	m_bObjectTreeDirty = false;
+}
+
+/***********************************************************
+ *  BenchmarkObjectTree()
+ *
+ *  Times the tree's frustum cull and box query against
+ *  testing every box, over random scenes of growing size,
+ *  and prints the results. The scene only has a few hundred
+ *  objects, so this shows where the tree starts to pay for
+ *  itself. It needs no window, and is only run when the
+ *  application is launched with --benchmark-object-tree.
+ ***********************************************************/
+void SceneManager::BenchmarkObjectTree()
+{
+	const int objectCounts[] = { 100, 1000, 10000 };
+	const int repeats = 100;
+
+	// a fixed seed, so every run times the same scenes
+	std::mt19937 random(330);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	for (int countIndex = 0; countIndex < 3; countIndex++)
+	{
+		int objectCount = objectCounts[countIndex];
+
+		// the volume grows with the count, so the density of
+		// the objects stays the same
+		float extent = 2.0f * std::cbrt((float)objectCount);
+		std::vector<glm::vec3> boundsMin(objectCount);
+		std::vector<glm::vec3> boundsMax(objectCount);
+		FrustumCuller flatBounds;
+		flatBounds.Resize(objectCount);
+		for (int i = 0; i < objectCount; i++)
+		{
+			glm::vec3 center = (glm::vec3(unit(random), unit(random), unit(random)) * 2.0f - 1.0f) * extent;
+			glm::vec3 halfSize = glm::vec3(0.25f + 0.25f * unit(random));
+			boundsMin[i] = center - halfSize;
+			boundsMax[i] = center + halfSize;
+			flatBounds.SetBounds(i, boundsMin[i], boundsMax[i]);
+		}
+
+		BoundingVolumeHierarchy tree;
+		tree.Build(boundsMin, boundsMax);
+
+		// a camera at the edge looking across the scene, and a
+		// region a tenth of its width around the middle
+		glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 2.0f * extent) *
+			glm::lookAt(glm::vec3(0.0f, 0.0f, extent), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::vec3 queryMin = glm::vec3(-0.1f * extent);
+		glm::vec3 queryMax = glm::vec3(0.1f * extent);
+
+		std::vector<unsigned char> visible;
+		std::vector<int> items;
+		int treeVisible = 0;
+		int flatVisible = 0;
+		size_t treeFound = 0;
+		size_t flatFound = 0;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			treeVisible = tree.Cull(viewProjection, visible);
+		}
+		std::chrono::steady_clock::time_point treeCullEnd = std::chrono::steady_clock::now();
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			flatVisible = flatBounds.Cull(viewProjection, visible);
+		}
+		std::chrono::steady_clock::time_point flatCullEnd = std::chrono::steady_clock::now();
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			items.clear();
+			tree.QueryBox(queryMin, queryMax, items);
+			treeFound = items.size();
+		}
+		std::chrono::steady_clock::time_point treeQueryEnd = std::chrono::steady_clock::now();
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			items.clear();
+			for (int i = 0; i < objectCount; i++)
+			{
+				if ((boundsMin[i].x <= queryMax.x) && (boundsMax[i].x >= queryMin.x) &&
+					(boundsMin[i].y <= queryMax.y) && (boundsMax[i].y >= queryMin.y) &&
+					(boundsMin[i].z <= queryMax.z) && (boundsMax[i].z >= queryMin.z))
+				{
+					items.push_back(i);
+				}
+			}
+			flatFound = items.size();
+		}
+		std::chrono::steady_clock::time_point flatQueryEnd = std::chrono::steady_clock::now();
+
+		// average microseconds per call
+		typedef std::chrono::duration<double, std::micro> MICROSECONDS;
+		double treeCull = MICROSECONDS(treeCullEnd - start).count() / repeats;
+		double flatCull = MICROSECONDS(flatCullEnd - treeCullEnd).count() / repeats;
+		double treeQuery = MICROSECONDS(treeQueryEnd - flatCullEnd).count() / repeats;
+		double flatQuery = MICROSECONDS(flatQueryEnd - treeQueryEnd).count() / repeats;
+
+		std::cout << "Object tree benchmark, " << objectCount << " objects: cull "
+			<< treeCull << " us (" << treeVisible << " visible), every box " << flatCull << " us ("
+			<< flatVisible << " visible); box query " << treeQuery << " us (" << treeFound
+			<< " found), every box " << flatQuery << " us (" << flatFound << " found)" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  RenderOcclusionBuffer()
+ *
+ *  Rasterizes the occluder objects into the occlusion buffer
+ *  from the camera. The static batches hold the occluders
+ *  themselves, so only single objects and instance batches
+ *  are tested against it.
+ ***********************************************************/
+void SceneManager::RenderOcclusionBuffer(const glm::mat4& viewProjection)
+{
+	m_occlusionBuffer.ClearOccluders();
+
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		const SceneObject& object = m_objects[i];
+		if (!object.bOccluder)
+		{
+			continue;
+		}
+
+		glm::vec3 localMin, localMax;
+		GetMeshBounds(object.mesh, localMin, localMax);
+		m_occlusionBuffer.AddOccluder(localMin, localMax, object.modelMatrix);
+	}
+
+	if (m_occlusionBuffer.GetOccluderCount() > 0)
+	{
+		m_occlusionBuffer.Render(viewProjection);
+	}
+}
+
+/***********************************************************
+ *  QueryObjectsInBox()
+ *
+ *  Finds the scene objects whose world space bounds overlap
+ *  a world space box.
+ ***********************************************************/
+void SceneManager::QueryObjectsInBox(glm::vec3 boundsMin, glm::vec3 boundsMax, std::vector<int>& objectIndices)
+{
+	if (m_bObjectTreeDirty)
+	{
+		BuildObjectTree();
+	}
+	m_objectTree.QueryBox(boundsMin, boundsMax, objectIndices);
+}
+
+/***********************************************************
+ *  AddToBatchBounds()
+ *
+ *  Grows a batch's bounds to hold one of its objects.
+ ***********************************************************/
+void SceneManager::AddToBatchBounds(int objectIndex, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	glm::vec3 objectMin, objectMax;
+	m_objectBounds.GetBounds(objectIndex, objectMin, objectMax);
+
+	boundsMin = glm::min(boundsMin, objectMin);
+	boundsMax = glm::max(boundsMax, objectMax);
+}
+
+/***********************************************************
+ *  UpdateBatchBounds()
+ *
+ *  Copies the bounds of the instance batches, followed by
+ *  the static batches, into the batch culler.
+ ***********************************************************/
+void SceneManager::UpdateBatchBounds()
+{
+	m_batchBounds.Resize((int)(m_instanceBatches.size() + m_staticBatches.size()));
+
+	for (size_t i = 0; i < m_instanceBatches.size(); i++)
+	{
+		m_batchBounds.SetBounds((int)i, m_instanceBatches[i].boundsMin, m_instanceBatches[i].boundsMax);
+	}
+	for (size_t i = 0; i < m_staticBatches.size(); i++)
+	{
+		m_batchBounds.SetBounds((int)(m_instanceBatches.size() + i),
+			m_staticBatches[i].boundsMin, m_staticBatches[i].boundsMax);
+	}
+}
+
+/***********************************************************
+ *  HasSameStaticState()
+ *
+ *  Checks whether two static objects can share a group of
+ *  the static batch.
+ ***********************************************************/
+bool SceneManager::HasSameStaticState(const SceneObject& a, const SceneObject& b)
+{
+	return (a.bUseTexture == b.bUseTexture) &&
+		(a.textureLayer == b.textureLayer) &&
+		(a.bUseLighting == b.bUseLighting) &&
+		(a.color == b.color) &&
+		(a.tintIntensity == b.tintIntensity);
+}
+
+/***********************************************************
+ *  DrawInstanceBatch()
+ *
+ *  Draws every instance of a batch with a single draw call.
+ ***********************************************************/
+void SceneManager::DrawInstanceBatch(const INSTANCE_BATCH& batch)
+{
+	if (batch.state.mesh == MESH_BOX)
+	{
+		m_instancedMeshes->DrawBoxMeshInstanced(batch.instanceCount, batch.instanceBuffer);
+	}
+	else
+	{
+		m_instancedMeshes->DrawCylinderMeshInstanced(batch.instanceCount, batch.instanceBuffer, batch.lod);
+	}
+}
+
+/***********************************************************
+ *  RenderScene()
+ *
+ *  Renders the 3D scene. Because why else are we here?
+ ***********************************************************/
+void SceneManager::RenderScene()
+{
+	// Bind the depth map texture for shadow mapping
+	//Ignore this, still working on bias
+	GLStateCache::Get().BindTexture(g_ShadowMapUnit, GL_TEXTURE_2D_ARRAY, depthMap);
+	m_pShaderManager->setSampler2DValue(g_ShadowMapName, g_ShadowMapUnit);
+	GLStateCache::Get().BindTexture(g_PointShadowUnit, GL_TEXTURE_2D_ARRAY, m_pointShadowMap);
+	m_pShaderManager->setSampler2DValue(g_PointShadowMapName, g_PointShadowUnit);
+
+	// Bind the other textures
+	BindGLTextures();
+
+	// Send the light block, with the lights where the frame
+	// snapshot put them
+	UpdateLights();
+
+	// Draw the scene objects prepared in PrepareScene()
+	RenderSceneObjects();
+}
@@ -13,7 +13,17 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "MeshLibrary.h"
+#include "RenderQueue.h"
+#include "MultiDrawList.h"
+#include "FrameRingBuffer.h"
+#include "TextureArray.h"
+#include "FrustumCuller.h"
+#include "BoundingVolumeHierarchy.h"
+#include "OcclusionBuffer.h"
+#include "PointShadowScheduler.h"
 
+#include <map>
 #include <string>
 #include <vector>
 #include <glm/glm.hpp>
@@ -26,12 +36,6 @@ public:
     // destructor
     ~SceneManager();
 
-    struct TEXTURE_INFO
-    {
-        std::string tag;
-        uint32_t ID;
-    };
-
     struct OBJECT_MATERIAL
     {
         std::string tag;
@@ -42,18 +46,164 @@ public:
         float shininess;
         glm::vec3 emissiveColor;
         glm::vec3 tint; // Add this line
+        // whether objects with this material are textured
+        bool bUseTexture;
+        // whether objects with this material are blended over
+        // the opaque ones; most materials are opaque
+        bool bTransparent = false;
     };
 
-    struct SceneObject
+    // largest number of materials in the material table
+    static const int MAX_MATERIALS = 256;
+
+    // one entry of the material table, following the std140 layout
+    // rules to mirror the MaterialBlock uniform block in the shader
+    struct MATERIAL_DATA
+    {
+        glm::vec3 diffuseColor;
+        float shininess;
+        glm::vec3 specularColor;
+        float padding0;
+        glm::vec3 emissiveColor;
+        float padding1;
+    };
+
+    // number of point lights in the light block
+    static const int TOTAL_POINT_LIGHTS = 4;
+
+    // cascades the spot light's shadow map is split into along
+    // the camera's view, each a layer of the shadow map
+    static const int SHADOW_CASCADES = 3;
+
+    // the light structures follow the std140 layout rules, and
+    // mirror the LightBlock uniform block in fragmentShader.glsl
+    struct DIRECTIONAL_LIGHT
+    {
+        glm::vec3 direction;
+        GLint bActive;
+        glm::vec3 ambient;
+        float padding0;
+        glm::vec3 diffuse;
+        float padding1;
+        glm::vec3 specular;
+        float padding2;
+    };
+
+    struct POINT_LIGHT
+    {
+        glm::vec3 position;
+        float constant;
+        glm::vec3 ambient;
+        float linear;
+        glm::vec3 diffuse;
+        float quadratic;
+        glm::vec3 specular;
+        GLint bActive;
+    };
+
+    struct SPOT_LIGHT
     {
-        ShapeMeshes* mesh;
-        std::string textureTag;
-        std::string materialTag;
-        glm::vec3 scale;
-        float rotationX;
-        float rotationY;
-        float rotationZ;
         glm::vec3 position;
+        float cutOff;
+        glm::vec3 direction;
+        float outerCutOff;
+        glm::vec3 ambient;
+        float constant;
+        glm::vec3 diffuse;
+        float linear;
+        glm::vec3 specular;
+        float quadratic;
+        GLint bActive;
+        float padding[3];
+    };
+
+    struct LIGHT_BLOCK
+    {
+        DIRECTIONAL_LIGHT directionalLight;
+        SPOT_LIGHT spotLight;
+        POINT_LIGHT pointLights[TOTAL_POINT_LIGHTS];
+    };
+
+    // defines passed to the shaders so they match the application
+    static std::string GetShaderDefines();
+    // whether the context can submit with multi-draw indirect
+    static bool IsMultiDrawSupported();
+
+    // primitive meshes provided by the basic shapes object
+    enum MESH_TYPE
+    {
+        MESH_PLANE = 0,
+        MESH_BOX,
+        MESH_CYLINDER,
+        MESH_TAPERED_CYLINDER,
+        MESH_TORUS,
+        MESH_SPHERE
+    };
+
+    // fully resolved drawing state for one object in the scene
+    struct SceneObject
+    {
+        MESH_TYPE mesh;
+        glm::mat4 modelMatrix;
+        int materialIndex;
+        int textureLayer;
+        bool bUseTexture;
+        bool bUseLighting;
+        glm::vec4 color;
+        glm::vec2 uvScale;
+        float tintIntensity;
+        bool bInstanced;
+        bool bStatic;
+        // rasterized into the occlusion buffer
+        bool bOccluder;
+        // drawn blended, after the opaque objects
+        bool bTransparent;
+    };
+
+    // objects sharing one drawing state, drawn with instancing
+    struct INSTANCE_BATCH
+    {
+        SceneObject state;
+        GLuint instanceBuffer;
+        GLsizei instanceCount;
+        // world space box around every instance
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        // radius of the largest instance, and the level of
+        // detail every instance is drawn at
+        float maxRadius;
+        int lod;
+    };
+
+    // static objects baked into one group of the static batch
+    struct STATIC_BATCH
+    {
+        SceneObject state;
+        int group;
+        GLuint instanceBuffer;
+        // world space box around every baked object
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+    };
+
+    // consecutive packets submitted with one multi-draw call
+    struct MULTI_DRAW_RUN
+    {
+        size_t firstPacket;
+        int packetCount;
+        int firstDraw;
+        int drawCount;
+        bool bTransparent;
+    };
+
+    // packets of the objects one job went through, merged into
+    // the render queue once every job is done
+    struct PACKET_CHUNK
+    {
+        std::vector<RenderQueue::DRAW_PACKET> packets;
+        int culledMainDraws;
+        int culledShadowDraws;
+        int occludedDraws;
     };
 
 private:
@@ -61,20 +211,126 @@ private:
     ShaderManager* m_pShaderManager;
     // pointer to basic shapes object
     ShapeMeshes* m_basicMeshes;
-    // total number of loaded textures
-    int m_loadedTextures;
-    // loaded textures info
-    TEXTURE_INFO m_textureIDs[16];
+    // pointer to the meshes used for instanced, batched and
+    // multi-draw drawing
+    MeshLibrary* m_instancedMeshes;
+    // every scene texture, one per layer
+    TextureArray m_textureArray;
     // defined object materials
     std::vector<OBJECT_MATERIAL> m_objectMaterials;
+    // material table indices by tag
+    std::map<std::string, int> m_materialIndices;
+    // uniform buffer holding the material table
+    GLuint m_materialBlockBuffer;
 
     GLuint m_ShaderProgramID;
 
     // Shadow mapping variables
     unsigned int depthMapFBO;
+    // texture array with one layer per cascade
     unsigned int depthMap;
+    // size of each cascade; the three layers take less memory
+    // than the single 2048 x 2048 map they replaced
     const unsigned int SHADOW_WIDTH = 1024;
     const unsigned int SHADOW_HEIGHT = 1024;
+    // depth-only program used for the light pass
+    ShaderManager* m_pDepthShaderManager;
+    // light view and projection of each cascade, used by both passes
+    glm::mat4 m_cascadeMatrices[SHADOW_CASCADES];
+    // the same, reaching back to the light, used to cull the casters
+    glm::mat4 m_cascadeCullMatrices[SHADOW_CASCADES];
+    // light view space bounds of the visible objects, which the
+    // cascades' depth ranges are fitted to
+    std::vector<glm::vec3> m_receiverMin;
+    std::vector<glm::vec3> m_receiverMax;
+    // view space distance where each cascade ends
+    float m_cascadeSplits[SHADOW_CASCADES];
+    // set when a cascade no longer matches the scene or the camera
+    bool m_bCascadeDirty[SHADOW_CASCADES];
+    // cube shadows of the point lights, six layers per light,
+    // drawn into through a layered framebuffer; the other one
+    // holds a single layer, to clear just the faces redrawn
+    unsigned int m_pointShadowMap;
+    unsigned int m_pointShadowFBO;
+    unsigned int m_pointShadowClearFBO;
+    // depth program whose geometry shader draws several faces at once
+    ShaderManager* m_pPointShadowShaderManager;
+    // view and projection each face was last rendered with
+    glm::mat4 m_pointShadowMatrices[TOTAL_POINT_LIGHTS * PointShadowScheduler::FACE_COUNT];
+    // set when faces were rendered since the main program got the matrices
+    bool m_bPointShadowMatricesDirty;
+    // the point lights that cast shadows
+    bool m_bPointLightShadow[TOTAL_POINT_LIGHTS];
+    // picks the faces rendered each frame
+    PointShadowScheduler m_pointShadowScheduler;
+    std::vector<PointShadowScheduler::FACE_UPDATE> m_pointShadowUpdates;
+    // shadow-casting spot light placement
+    glm::vec3 m_shadowLightPosition;
+    glm::vec3 m_shadowLightTarget;
+    // set when the whole shadow map no longer matches the scene
+    bool m_bShadowMapDirty;
+    // set when instanced objects have moved
+    bool m_bInstanceBatchesDirty;
+    // set when static objects have moved
+    bool m_bStaticBatchesDirty;
+
+    // camera for the current frame
+    glm::mat4 m_viewMatrix;
+    glm::mat4 m_projectionMatrix;
+    glm::vec3 m_viewPosition;
+
+    // lights, as they are stored in the uniform buffer
+    LIGHT_BLOCK m_lightBlock;
+    GLuint m_lightBlockBuffer;
+    bool m_bLightBlockDirty;
+    // set while the light block is bound from the frame ring
+    bool m_bLightBlockInRing;
+
+    // persistently mapped memory the per-frame data is written
+    // into, when the context supports buffer storage
+    FrameRingBuffer m_frameRing;
+
+    // draws of the current frame, sorted by state
+    RenderQueue m_renderQueue;
+    bool m_bReportedQueueStats;
+
+    // world space bounds of the scene objects, and of the
+    // instance batches followed by the static batches
+    FrustumCuller m_objectBounds;
+    FrustumCuller m_batchBounds;
+    // tree over the object bounds, used to cull and query them
+    BoundingVolumeHierarchy m_objectTree;
+    // set when objects were added since the tree was built
+    bool m_bObjectTreeDirty;
+    // the large occluders, rasterized on the CPU from the camera
+    OcclusionBuffer m_occlusionBuffer;
+    // culling results against the camera and each cascade
+    std::vector<unsigned char> m_objectVisible;
+    std::vector<unsigned char> m_batchVisible;
+    std::vector<unsigned char> m_objectCasting[SHADOW_CASCADES];
+    std::vector<unsigned char> m_batchCasting[SHADOW_CASCADES];
+    // packet buffers of the jobs building the render queue
+    std::vector<PACKET_CHUNK> m_packetChunks;
+    // draws culled from the last built render queue
+    int m_culledMainDraws;
+    int m_culledShadowDraws;
+    int m_occludedDraws;
+
+    // single objects of the frame, submitted with multi-draw
+    // indirect when the context supports it
+    bool m_bUseMultiDraw;
+    MultiDrawList m_multiDrawList;
+    std::vector<MULTI_DRAW_RUN> m_multiDrawRuns;
+    // runs of each cascade's shadow pass, replaying the same list
+    std::vector<MULTI_DRAW_RUN> m_shadowDrawRuns[SHADOW_CASCADES];
+    // runs of the point lights' shadow pass
+    std::vector<MULTI_DRAW_RUN> m_pointShadowDrawRuns;
+
+    // the frame's draws are recorded into the render queue and
+    // multi-draw list, and replayed until one of these changes
+    bool m_bRecordingDirty;
+    glm::mat4 m_recordedViewMatrix;
+    glm::mat4 m_recordedProjectionMatrix;
 
     // Screen dimensions
     unsigned int m_ScreenWidth;
@@ -82,23 +338,33 @@ private:
 
     // Scene objects
     std::vector<SceneObject> m_objects;
+    // drawing state applied to the next added scene object
+    SceneObject m_objectState;
+    // level of detail each object was last drawn at
+    std::vector<int> m_objectLods;
+    // every object's values in the layout of the multi-draw
+    // list, kept from frame to frame
+    std::vector<MultiDrawList::DRAW_DATA> m_objectDraws;
+    // triangles of round meshes drawn in the last main pass,
+    // at each level of detail
+    int m_lodTriangles[MeshLibrary::LOD_COUNT];
+    // instanced draws built from the scene objects
+    std::vector<INSTANCE_BATCH> m_instanceBatches;
+    // static objects baked into world space groups
+    std::vector<STATIC_BATCH> m_staticBatches;
 
-    // load texture images and convert to OpenGL texture data
-    bool CreateGLTexture(const char* filename, std::string tag);
-    // bind loaded OpenGL textures to slots in memory
+    // bind the texture array holding the scene textures
     void BindGLTextures();
-    // free the loaded OpenGL textures
-    void DestroyGLTextures();
-    // find a loaded texture by tag
-    int FindTextureID(std::string tag);
-    int FindTextureSlot(std::string tag);
     // find a defined material by tag
     bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+    int FindMaterialIndex(std::string tag);
+    // copy the defined materials into the material table
+    void UploadObjectMaterials();
 
     void LoadSceneTextures();
 
     // set the transformation values 
-    // into the transform buffer
+    // for the next scene object
     void SetTransformations(
         glm::vec3 scaleXYZ,
         float XrotationDegrees,
@@ -106,14 +372,14 @@ private:
         float ZrotationDegrees,
         glm::vec3 positionXYZ);
 
-    // set the color values into the shader
+    // set the color values for the next scene object
     void SetShaderColor(
         float redColorValue,
         float greenColorValue,
         float blueColorValue,
         float alphaValue);
 
-    // set the texture data into the shader
+    // set the texture for the next scene object
     void SetShaderTexture(
         std::string textureTag);
 
@@ -121,13 +387,86 @@ private:
     void SetTextureUVScale(
         float u, float v);
 
-    // set the object material into the shader
+    // set the material for the next scene object
     void SetShaderMaterial(
         std::string materialTag);
 
-    void SetShaderEmissive(float redColorValue, float greenColorValue, float blueColorValue); // Add this line
+    // set the texture tint intensity for the next scene object
+    void SetTintIntensity(float intensity);
+    // draw the next scene objects with instancing
+    void SetUseInstancing(bool useInstancing);
+    // bake the next scene objects into the static batch
+    void SetUseStaticBatch(bool useStaticBatch);
+    // hide the objects behind the next scene objects
+    void SetUseAsOccluder(bool useAsOccluder);
+
     void SetShaderLights(); // New function to set up the lights
+    // send any changes of the lights to the shader
+    void UpdateLights();
     void RenderSceneFromLightPerspective(); // New function to render the scene from the light's perspective
+    // draw the packets of a shadow pass with a depth program
+    void RenderShadowCasters(RenderQueue::RENDER_PASS pass, const std::vector<MULTI_DRAW_RUN>& runs,
+        ShaderManager* pDepthShaderManager);
+    // render the point light cube faces picked for the frame
+    void RenderPointLightShadows();
+    // whether any point light casts shadows
+    bool HasPointLightShadows() const;
+
+    // build the retained list of scene objects
+    void DefineSceneObjects();
+    // add an object using the current drawing state,
+    // returning its index in the scene object list
+    int AddSceneObject(MESH_TYPE mesh);
+    // draw the retained scene objects
+    void RenderSceneObjects();
+    // send an object's drawing state to the shader
+    void ApplyObjectState(const SceneObject& object, const SceneObject* previous);
+    // group the objects marked for instancing into batches
+    void BuildInstanceBatches();
+    bool HasSameInstanceState(const SceneObject& a, const SceneObject& b);
+    // bake the static objects into the static batch
+    void BuildStaticBatches();
+    bool HasSameStaticState(const SceneObject& a, const SceneObject& b);
+    // draw every instance of a batch
+    void DrawInstanceBatch(const INSTANCE_BATCH& batch);
+    // fill and sort the render queue for the frame
+    void BuildRenderQueue();
+    // cull and build the packets of a range of the objects
+    void BuildObjectPackets(size_t begin, size_t end, bool bTestOcclusion, bool bPointShadows, PACKET_CHUNK& chunk);
+    // draw one of the basic shape meshes, using the mesh
+    // library for the coarser levels of detail
+    void DrawMesh(MESH_TYPE mesh, int lod);
+    // write the frame's multi-draw commands and runs
+    void BuildMultiDrawList();
+    // add the multi-draw commands and runs of one pass
+    void AddMultiDrawRuns(RenderQueue::RENDER_PASS pass, std::vector<MULTI_DRAW_RUN>& runs);
+    // write an object's values for the multi-draw list
+    void RecordObjectDraw(int objectIndex);
+    // find a basic shape mesh in the mesh library
+    bool FindLibraryMesh(MESH_TYPE mesh, int lod, MeshLibrary::MESH_INFO& info);
+    // whether a mesh has coarser levels of detail
+    static bool HasMeshLods(MESH_TYPE mesh);
+    // pick the level of detail of something seen from a
+    // distance, staying at the current level near the edges
+    int SelectMeshLod(int currentLod, float distance, float radius);
+    // add a draw's triangles to the level of detail counters
+    void CountLodTriangles(MESH_TYPE mesh, int lod, int instanceCount);
+    // local bounds of one of the basic shape meshes
+    static void GetMeshBounds(MESH_TYPE mesh, glm::vec3& boundsMin, glm::vec3& boundsMax);
+    // recompute the world space bounds of one object
+    void UpdateObjectBounds(int objectIndex);
+    // copy the batch bounds into the batch culler
+    void UpdateBatchBounds();
+    // grow a batch's bounds to hold one of its objects
+    void AddToBatchBounds(int objectIndex, glm::vec3& boundsMin, glm::vec3& boundsMax);
+    // fit the cascades to the camera, marking the ones that moved
+    void UpdateShadowCascades();
+    // whether any cascade has to be rendered this frame
+    bool IsAnyCascadeDirty() const;
+    // build the tree over the object bounds
+    void BuildObjectTree();
+    // rasterize the occluders as seen from the camera
+    void RenderOcclusionBuffer(const glm::mat4& viewProjection);
 
 public:
     // The following methods are for the students to 
@@ -138,6 +477,33 @@ public:
     void SetUseLighting(bool useLighting);
     void SetTextureOffset(float offsetX, float offsetY);
 
+    // set the camera used to sort the frame's draws
+    void SetViewParameters(glm::mat4 view, glm::mat4 projection, glm::vec3 viewPosition);
+
+    // move the shadow-casting light
+    void SetShadowLight(glm::vec3 position, glm::vec3 target);
+    // where the moving point lights are at a time, in seconds
+    static void AnimatePointLights(double time, glm::vec3 positions[TOTAL_POINT_LIGHTS]);
+    // move the point lights
+    void SetPointLightPositions(const glm::vec3 positions[TOTAL_POINT_LIGHTS]);
+    // choose whether a point light casts cube shadows
+    void SetPointLightShadow(int lightIndex, bool bCastsShadow);
+    // move a scene object after the scene is prepared
+    void SetObjectTransform(int objectIndex, glm::mat4 modelMatrix);
+    // force the shadow map to be rendered on the next frame
+    void InvalidateShadowMap();
+    // find the scene objects whose bounds overlap a world space box
+    void QueryObjectsInBox(glm::vec3 boundsMin, glm::vec3 boundsMax, std::vector<int>& objectIndices);
+    // time the object tree against testing every box, over random
+    // scenes; only run when asked for on the command line
+    static void BenchmarkObjectTree();
+    // triangles of round meshes drawn at a level of detail in the
+    // last main pass, counted again every frame
+    int GetLodTriangles(int lod) const
+    {
+        return ((lod >= 0) && (lod < MeshLibrary::LOD_COUNT)) ? m_lodTriangles[lod] : 0;
+    }
+
     // pre-define the object materials for lighting
     void DefineObjectMaterials();
 };
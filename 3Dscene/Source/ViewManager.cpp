@@ -10,6 +10,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "ViewManager.h"
+#include "GLStateCache.h"
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
@@ -37,6 +38,11 @@ namespace
     float gLastY = WINDOW_HEIGHT / 2.0f;
     bool gFirstMouse = true;
 
+    // Mouse and scroll wheel movement not yet handed to the camera
+    float gMouseXOffset = 0.0f;
+    float gMouseYOffset = 0.0f;
+    float gScrollOffset = 0.0f;
+
     // Time-travel variables to keep track of frame times
     float gDeltaTime = 0.0f;
     float gLastFrame = 0.0f;
@@ -61,6 +67,9 @@ ViewManager::ViewManager(
     // Initialize the vital components of your view
     m_pShaderManager = pShaderManager;
     m_pWindow = NULL;
+    m_view = glm::mat4(1.0f);
+    m_projection = glm::mat4(1.0f);
+    m_viewPosition = glm::vec3(0.0f);
     g_pCamera = new Camera();
     // Default camera settings because we all love defaults
     g_pCamera->Position = glm::vec3(0.0f, 5.0f, 12.0f);
@@ -121,9 +130,9 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
     // Callback for mouse scrolling - in case you're into that
     glfwSetScrollCallback(window, &ViewManager::Mouse_Scroll_Callback);
 
-    // Enable blending because transparency is trendy
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // blending is only turned on for the transparent draws,
+    // see SceneManager::RenderSceneObjects()
+    GLStateCache::Get().SetEnabled(GL_BLEND, false);
 
     m_pWindow = window;
 
@@ -154,8 +163,9 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
     gLastX = static_cast<float>(xMousePos);
     gLastY = static_cast<float>(yMousePos);
 
-    // Move the camera based on your shaky hand movements
-    g_pCamera->ProcessMouseMovement(xOffset, yOffset);
+    // Save up your shaky hand movements until the camera is next moved
+    gMouseXOffset += xOffset;
+    gMouseYOffset += yOffset;
 }
 
 /***********************************************************
@@ -166,14 +176,44 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
  ***********************************************************/
 void ViewManager::Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, double yOffset)
 {
-    // Adjust the camera speed with the scroll wheel
-    g_pCamera->MovementSpeed += yOffset * SPEED_INCREMENT;
+    // The camera speed is adjusted the next time the camera is moved
+    gScrollOffset += static_cast<float>(yOffset);
+}
 
-    // Prevent the camera from moving backwards through time
-    if (g_pCamera->MovementSpeed < SPEED_INCREMENT)
+/***********************************************************
+ *  SampleInput()
+ *
+ *  Reads the keys and hands over the mouse movement saved
+ *  up by the callbacks. The escape key is handled here,
+ *  since only the main thread can close the window.
+ ***********************************************************/
+ViewManager::VIEW_INPUT ViewManager::SampleInput()
+{
+    VIEW_INPUT input;
+    input.bPerspectiveKey = (glfwGetKey(m_pWindow, GLFW_KEY_P) == GLFW_PRESS);
+    input.bOrthographicKey = (glfwGetKey(m_pWindow, GLFW_KEY_O) == GLFW_PRESS);
+    input.bCycleViewKey = (glfwGetKey(m_pWindow, GLFW_KEY_L) == GLFW_PRESS);
+    input.bForwardKey = (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS);
+    input.bBackwardKey = (glfwGetKey(m_pWindow, GLFW_KEY_S) == GLFW_PRESS);
+    input.bLeftKey = (glfwGetKey(m_pWindow, GLFW_KEY_A) == GLFW_PRESS);
+    input.bRightKey = (glfwGetKey(m_pWindow, GLFW_KEY_D) == GLFW_PRESS);
+    input.bUpKey = (glfwGetKey(m_pWindow, GLFW_KEY_Q) == GLFW_PRESS);
+    input.bDownKey = (glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS);
+
+    input.mouseXOffset = gMouseXOffset;
+    input.mouseYOffset = gMouseYOffset;
+    input.scrollOffset = gScrollOffset;
+    gMouseXOffset = 0.0f;
+    gMouseYOffset = 0.0f;
+    gScrollOffset = 0.0f;
+
+    // Close the window if you're tired of this view
+    if (glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
     {
-        g_pCamera->MovementSpeed = SPEED_INCREMENT;
+        glfwSetWindowShouldClose(m_pWindow, true);
     }
+
+    return input;
 }
 
 /***********************************************************
@@ -181,17 +221,17 @@ void ViewManager::Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, doub
  *
  *  Handling keyboard events like a pro. Or at least trying to.
  ***********************************************************/
-void ViewManager::ProcessKeyboardEvents()
+void ViewManager::ProcessKeyboardEvents(const VIEW_INPUT& input, float deltaTime)
 {
     // Toggle between perspective and orthographic projection
-    if (glfwGetKey(m_pWindow, GLFW_KEY_P) == GLFW_PRESS)
+    if (input.bPerspectiveKey)
     {
         bOrthographicProjection = false;
         g_pCamera->Position = glm::vec3(0.5f, 5.5f, 10.0f); // Reset to perspective view position
         g_pCamera->Front = glm::vec3(0.0f, 0.0f, -1.0f);    // Ensure the front direction is correct
     }
 
-    if (glfwGetKey(m_pWindow, GLFW_KEY_O) == GLFW_PRESS)
+    if (input.bOrthographicKey)
     {
         bOrthographicProjection = true;
         // Set to default orthogonal view
@@ -200,7 +240,7 @@ void ViewManager::ProcessKeyboardEvents()
         g_pCamera->Front = glm::vec3(0.0f, -1.0f, 0.0f);    // Look direction straight down
     }
 
-    if (glfwGetKey(m_pWindow, GLFW_KEY_L) == GLFW_PRESS && bOrthographicProjection)
+    if (input.bCycleViewKey && bOrthographicProjection)
     {
         // Cycle through orthogonal views
         switch (currentOrthogonalView)
@@ -223,40 +263,34 @@ void ViewManager::ProcessKeyboardEvents()
         }
     }
 
-    // Close the window if you're tired of this view
-    if (glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-    {
-        glfwSetWindowShouldClose(m_pWindow, true);
-    }
-
     // Move the camera forward, because why not
-    if (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS)
+    if (input.bForwardKey)
     {
-        g_pCamera->ProcessKeyboard(FORWARD, gDeltaTime);
+        g_pCamera->ProcessKeyboard(FORWARD, deltaTime);
     }
-    if (glfwGetKey(m_pWindow, GLFW_KEY_S) == GLFW_PRESS)
+    if (input.bBackwardKey)
     {
-        g_pCamera->ProcessKeyboard(BACKWARD, gDeltaTime);
+        g_pCamera->ProcessKeyboard(BACKWARD, deltaTime);
     }
 
     // Move the camera left and right
-    if (glfwGetKey(m_pWindow, GLFW_KEY_A) == GLFW_PRESS)
+    if (input.bLeftKey)
     {
-        g_pCamera->ProcessKeyboard(LEFT, gDeltaTime);
+        g_pCamera->ProcessKeyboard(LEFT, deltaTime);
     }
-    if (glfwGetKey(m_pWindow, GLFW_KEY_D) == GLFW_PRESS)
+    if (input.bRightKey)
     {
-        g_pCamera->ProcessKeyboard(RIGHT, gDeltaTime);
+        g_pCamera->ProcessKeyboard(RIGHT, deltaTime);
     }
 
     // Move the camera up and down
-    if (glfwGetKey(m_pWindow, GLFW_KEY_Q) == GLFW_PRESS)
+    if (input.bUpKey)
     {
-        g_pCamera->ProcessKeyboard(UP, gDeltaTime);
+        g_pCamera->ProcessKeyboard(UP, deltaTime);
     }
-    if (glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS)
+    if (input.bDownKey)
     {
-        g_pCamera->ProcessKeyboard(DOWN, gDeltaTime);
+        g_pCamera->ProcessKeyboard(DOWN, deltaTime);
     }
 }
 
@@ -264,19 +298,52 @@ void ViewManager::ProcessKeyboardEvents()
  *  PrepareSceneView()
  *
  *  Preparing the scene view. Because you need to see things.
+ *  Everything happens on the calling thread; the frame
+ *  pipeline splits the same steps between its threads.
  ***********************************************************/
 void ViewManager::PrepareSceneView()
 {
-    glm::mat4 view;
-    glm::mat4 projection;
-
     // Keep track of time, because why not
     float currentFrame = static_cast<float>(glfwGetTime());
     gDeltaTime = currentFrame - gLastFrame;
     gLastFrame = currentFrame;
 
     // Process those oh-so-important keyboard events
-    ProcessKeyboardEvents();
+    UpdateCamera(SampleInput(), gDeltaTime);
+
+    SetShaderView(m_view, m_projection, m_viewPosition);
+}
+
+/***********************************************************
+ *  UpdateCamera()
+ *
+ *  Moves the camera by sampled input, then computes the
+ *  view and projection for the frame.
+ ***********************************************************/
+void ViewManager::UpdateCamera(const VIEW_INPUT& input, float deltaTime)
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+
+    ProcessKeyboardEvents(input, deltaTime);
+
+    // Move the camera based on your shaky hand movements
+    if ((input.mouseXOffset != 0.0f) || (input.mouseYOffset != 0.0f))
+    {
+        g_pCamera->ProcessMouseMovement(input.mouseXOffset, input.mouseYOffset);
+    }
+
+    // Adjust the camera speed with the scroll wheel
+    if (input.scrollOffset != 0.0f)
+    {
+        g_pCamera->MovementSpeed += input.scrollOffset * SPEED_INCREMENT;
+
+        // Prevent the camera from moving backwards through time
+        if (g_pCamera->MovementSpeed < SPEED_INCREMENT)
+        {
+            g_pCamera->MovementSpeed = SPEED_INCREMENT;
+        }
+    }
 
     // Get the camera's view matrix
     view = g_pCamera->GetViewMatrix();
@@ -292,6 +359,20 @@ void ViewManager::PrepareSceneView()
         projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
     }
 
+    // Hold on to the camera for anyone else who needs it this frame
+    m_view = view;
+    m_projection = projection;
+    m_viewPosition = g_pCamera->Position;
+}
+
+/***********************************************************
+ *  SetShaderView()
+ *
+ *  Sends the view, projection and camera position to the
+ *  shaders.
+ ***********************************************************/
+void ViewManager::SetShaderView(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition)
+{
     // If the shader manager is still around, set the view and projection
     if (NULL != m_pShaderManager)
     {
@@ -300,6 +381,6 @@ void ViewManager::PrepareSceneView()
         // Set the projection matrix in the shader
         m_pShaderManager->setMat4Value(g_ProjectionName, projection);
         // Set the camera's position in the shader
-        m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+        m_pShaderManager->setVec3Value("viewPosition", viewPosition);
     }
 }
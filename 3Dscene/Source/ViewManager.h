@@ -32,14 +32,37 @@ public:
 	// mouse scroll callback for movement speed in environment
 	static void Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, double yOffset);
 
+	// keys held and mouse movement, gathered on the main thread
+	// so the camera can be moved on another thread
+	struct VIEW_INPUT
+	{
+		bool bPerspectiveKey;
+		bool bOrthographicKey;
+		bool bCycleViewKey;
+		bool bForwardKey;
+		bool bBackwardKey;
+		bool bLeftKey;
+		bool bRightKey;
+		bool bUpKey;
+		bool bDownKey;
+		// mouse and scroll wheel movement since the last sample
+		float mouseXOffset;
+		float mouseYOffset;
+		float scrollOffset;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
+	// camera values for the current frame
+	glm::mat4 m_view;
+	glm::mat4 m_projection;
+	glm::vec3 m_viewPosition;
 
 	// process keyboard events for interaction with the 3D scene
-	void ProcessKeyboardEvents();
+	void ProcessKeyboardEvents(const VIEW_INPUT& input, float deltaTime);
 
 public:
 	// create the initial OpenGL display window
@@ -47,4 +70,19 @@ public:
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+
+	// read the keys and the mouse movement since the last call;
+	// GLFW only allows this on the main thread
+	VIEW_INPUT SampleInput();
+	// move the camera by sampled input over deltaTime seconds,
+	// and compute the view and projection; this touches no
+	// OpenGL or GLFW state, so any one thread can call it
+	void UpdateCamera(const VIEW_INPUT& input, float deltaTime);
+	// send camera values to the shaders
+	void SetShaderView(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition);
+
+	// the camera values set by the last UpdateCamera() call
+	glm::mat4 GetViewMatrix() const { return m_view; }
+	glm::mat4 GetProjectionMatrix() const { return m_projection; }
+	glm::vec3 GetViewPosition() const { return m_viewPosition; }
 };
\ No newline at end of file
@@ -0,0 +1,491 @@
+///////////////////////////////////////////////////////////////////////////////
+// boundingvolumehierarchy.cpp
+// ============
+// a tree of bounding boxes over the scene objects, built with the surface
+// area heuristic and flattened into one array of nodes, used to find the
+// objects inside a view frustum or a region of the scene
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BoundingVolumeHierarchy.h"
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+    // number of buckets the centroids are sorted into when
+    // looking for the cheapest split
+    const int g_SplitBins = 12;
+    // largest leaf, even when splitting costs more than testing
+    const int g_MaxLeafItems = 4;
+    // cost of visiting a node, relative to testing one item
+    const float g_TraversalCost = 1.0f;
+
+    // half the surface area of a box, which is all the surface
+    // area heuristic needs to compare splits
+    float HalfArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        glm::vec3 extent = boundsMax - boundsMin;
+        if ((extent.x < 0.0f) || (extent.y < 0.0f) || (extent.z < 0.0f))
+        {
+            return 0.0f;
+        }
+        return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+    }
+
+    struct SPLIT_BIN
+    {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        int count;
+    };
+
+    // node waiting to be visited, with the frustum planes its
+    // parent was not already fully inside of
+    struct CULL_ENTRY
+    {
+        int node;
+        int planeMask;
+    };
+
+    // whether a box is outside any of the planes in the mask;
+    // the planes it is fully inside of are removed from the mask
+    bool IsOutsidePlanes(const glm::vec4 planes[6], const glm::vec3& boundsMin, const glm::vec3& boundsMax, int& planeMask)
+    {
+        for (int p = 0; p < 6; p++)
+        {
+            if ((planeMask & (1 << p)) == 0)
+            {
+                continue;
+            }
+
+            const glm::vec4& plane = planes[p];
+            // the corners furthest along and against the normal
+            glm::vec3 positive(
+                (plane.x >= 0.0f) ? boundsMax.x : boundsMin.x,
+                (plane.y >= 0.0f) ? boundsMax.y : boundsMin.y,
+                (plane.z >= 0.0f) ? boundsMax.z : boundsMin.z);
+            glm::vec3 negative(
+                (plane.x >= 0.0f) ? boundsMin.x : boundsMax.x,
+                (plane.y >= 0.0f) ? boundsMin.y : boundsMax.y,
+                (plane.z >= 0.0f) ? boundsMin.z : boundsMax.z);
+
+            if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+            {
+                return true;
+            }
+            if (glm::dot(glm::vec3(plane), negative) + plane.w >= 0.0f)
+            {
+                planeMask &= ~(1 << p);
+            }
+        }
+        return false;
+    }
+
+    bool Overlaps(const glm::vec3& aMin, const glm::vec3& aMax, const glm::vec3& bMin, const glm::vec3& bMax)
+    {
+        return (aMin.x <= bMax.x) && (aMax.x >= bMin.x) &&
+            (aMin.y <= bMax.y) && (aMax.y >= bMin.y) &&
+            (aMin.z <= bMax.z) && (aMax.z >= bMin.z);
+    }
+}
+
+/***********************************************************
+ *  BoundingVolumeHierarchy()
+ *
+ *  The constructor for the class.
+ ***********************************************************/
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+    m_depth = 0;
+}
+
+/***********************************************************
+ *  ~BoundingVolumeHierarchy()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy()
+{
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is called to build the tree over one box per
+ *  item. The items are split top down, and afterwards their
+ *  boxes are stored in the order the leaves reference them.
+ ***********************************************************/
+void BoundingVolumeHierarchy::Build(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax)
+{
+    int itemCount = (int)std::min(boundsMin.size(), boundsMax.size());
+
+    m_nodes.clear();
+    m_parents.clear();
+    m_depth = 0;
+
+    // while building, the boxes are indexed by item
+    m_itemMin.assign(boundsMin.begin(), boundsMin.begin() + itemCount);
+    m_itemMax.assign(boundsMax.begin(), boundsMax.begin() + itemCount);
+    m_itemIndices.resize(itemCount);
+    for (int i = 0; i < itemCount; i++)
+    {
+        m_itemIndices[i] = i;
+    }
+    m_itemSlots.assign(itemCount, 0);
+    m_itemLeaves.assign(itemCount, -1);
+
+    if (itemCount == 0)
+    {
+        return;
+    }
+
+    // a binary tree with leaves of one or more items has
+    // fewer than twice as many nodes as items
+    m_nodes.reserve(2 * itemCount);
+    m_parents.reserve(2 * itemCount);
+    BuildNode(0, itemCount, -1, 1);
+
+    // store the boxes in leaf order, so a leaf's items are
+    // next to each other in memory
+    std::vector<glm::vec3> itemMin(itemCount);
+    std::vector<glm::vec3> itemMax(itemCount);
+    for (int slot = 0; slot < itemCount; slot++)
+    {
+        int item = m_itemIndices[slot];
+        itemMin[slot] = m_itemMin[item];
+        itemMax[slot] = m_itemMax[item];
+        m_itemSlots[item] = slot;
+    }
+    m_itemMin.swap(itemMin);
+    m_itemMax.swap(itemMax);
+
+    for (int node = 0; node < (int)m_nodes.size(); node++)
+    {
+        const BVH_NODE& leaf = m_nodes[node];
+        for (int slot = 0; slot < leaf.itemCount; slot++)
+        {
+            m_itemLeaves[m_itemIndices[leaf.leftOrFirst + slot]] = node;
+        }
+    }
+}
+
+/***********************************************************
+ *  BuildNode()
+ *
+ *  This method is called to turn a range of items into a
+ *  subtree. The centroids are sorted into bins along each
+ *  axis, and the split between bins with the lowest surface
+ *  area cost is used, unless testing every item in a leaf
+ *  is cheaper.
+ ***********************************************************/
+int BoundingVolumeHierarchy::BuildNode(int first, int count, int parent, int depth)
+{
+    int node = (int)m_nodes.size();
+    m_nodes.push_back(BVH_NODE());
+    m_parents.push_back(parent);
+    m_depth = std::max(m_depth, depth);
+
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+    for (int i = first; i < first + count; i++)
+    {
+        int item = m_itemIndices[i];
+        glm::vec3 centroid = (m_itemMin[item] + m_itemMax[item]) * 0.5f;
+        boundsMin = glm::min(boundsMin, m_itemMin[item]);
+        boundsMax = glm::max(boundsMax, m_itemMax[item]);
+        centroidMin = glm::min(centroidMin, centroid);
+        centroidMax = glm::max(centroidMax, centroid);
+    }
+    m_nodes[node].boundsMin = boundsMin;
+    m_nodes[node].boundsMax = boundsMax;
+
+    // find the cheapest split of the centroid bins
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float parentArea = HalfArea(boundsMin, boundsMax);
+
+    for (int axis = 0; (axis < 3) && (count > 1); axis++)
+    {
+        float axisMin = centroidMin[axis];
+        float axisExtent = centroidMax[axis] - axisMin;
+        if (axisExtent <= 0.0f)
+        {
+            continue;
+        }
+
+        SPLIT_BIN bins[g_SplitBins];
+        for (int b = 0; b < g_SplitBins; b++)
+        {
+            bins[b].boundsMin = glm::vec3(FLT_MAX);
+            bins[b].boundsMax = glm::vec3(-FLT_MAX);
+            bins[b].count = 0;
+        }
+
+        float binScale = g_SplitBins / axisExtent;
+        for (int i = first; i < first + count; i++)
+        {
+            int item = m_itemIndices[i];
+            float centroid = (m_itemMin[item][axis] + m_itemMax[item][axis]) * 0.5f;
+            int b = std::min(g_SplitBins - 1, (int)((centroid - axisMin) * binScale));
+            bins[b].boundsMin = glm::min(bins[b].boundsMin, m_itemMin[item]);
+            bins[b].boundsMax = glm::max(bins[b].boundsMax, m_itemMax[item]);
+            bins[b].count++;
+        }
+
+        // sweep from the left and from the right, so every split
+        // is costed with one pass over the bins each way
+        float leftArea[g_SplitBins - 1];
+        int leftCount[g_SplitBins - 1];
+        glm::vec3 sweepMin(FLT_MAX), sweepMax(-FLT_MAX);
+        int sweepCount = 0;
+        for (int b = 0; b < g_SplitBins - 1; b++)
+        {
+            sweepMin = glm::min(sweepMin, bins[b].boundsMin);
+            sweepMax = glm::max(sweepMax, bins[b].boundsMax);
+            sweepCount += bins[b].count;
+            leftArea[b] = HalfArea(sweepMin, sweepMax);
+            leftCount[b] = sweepCount;
+        }
+
+        sweepMin = glm::vec3(FLT_MAX);
+        sweepMax = glm::vec3(-FLT_MAX);
+        sweepCount = 0;
+        for (int b = g_SplitBins - 1; b > 0; b--)
+        {
+            sweepMin = glm::min(sweepMin, bins[b].boundsMin);
+            sweepMax = glm::max(sweepMax, bins[b].boundsMax);
+            sweepCount += bins[b].count;
+
+            if ((leftCount[b - 1] == 0) || (sweepCount == 0))
+            {
+                continue;
+            }
+
+            float cost = g_TraversalCost;
+            if (parentArea > 0.0f)
+            {
+                cost += (leftArea[b - 1] * leftCount[b - 1] + HalfArea(sweepMin, sweepMax) * sweepCount) / parentArea;
+            }
+            else
+            {
+                cost += (float)count;
+            }
+
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    int leftItems = 0;
+    if ((bestAxis >= 0) && ((bestCost < (float)count) || (count > g_MaxLeafItems)))
+    {
+        float axisMin = centroidMin[bestAxis];
+        float binScale = g_SplitBins / (centroidMax[bestAxis] - axisMin);
+        int* middle = std::partition(m_itemIndices.data() + first, m_itemIndices.data() + first + count,
+            [&](int item)
+            {
+                float centroid = (m_itemMin[item][bestAxis] + m_itemMax[item][bestAxis]) * 0.5f;
+                int b = std::min(g_SplitBins - 1, (int)((centroid - axisMin) * binScale));
+                return b < bestSplit;
+            });
+        leftItems = (int)(middle - (m_itemIndices.data() + first));
+    }
+    else if (count > g_MaxLeafItems)
+    {
+        // every centroid is in the same place, so any split
+        // is as good as another
+        leftItems = count / 2;
+    }
+
+    if ((leftItems == 0) || (leftItems == count))
+    {
+        m_nodes[node].leftOrFirst = first;
+        m_nodes[node].itemCount = count;
+        return node;
+    }
+
+    // the first child follows its parent, so only the second
+    // child's index needs storing
+    BuildNode(first, leftItems, node, depth + 1);
+    int right = BuildNode(first + leftItems, count - leftItems, node, depth + 1);
+    m_nodes[node].leftOrFirst = right;
+    m_nodes[node].itemCount = 0;
+
+    return node;
+}
+
+/***********************************************************
+ *  UpdateNodeBounds()
+ *
+ *  This method is called to set a node's box from the boxes
+ *  of its items, for a leaf, or of its two children.
+ ***********************************************************/
+void BoundingVolumeHierarchy::UpdateNodeBounds(int node)
+{
+    BVH_NODE& current = m_nodes[node];
+
+    if (current.itemCount > 0)
+    {
+        current.boundsMin = glm::vec3(FLT_MAX);
+        current.boundsMax = glm::vec3(-FLT_MAX);
+        for (int slot = current.leftOrFirst; slot < current.leftOrFirst + current.itemCount; slot++)
+        {
+            current.boundsMin = glm::min(current.boundsMin, m_itemMin[slot]);
+            current.boundsMax = glm::max(current.boundsMax, m_itemMax[slot]);
+        }
+    }
+    else
+    {
+        const BVH_NODE& left = m_nodes[node + 1];
+        const BVH_NODE& right = m_nodes[current.leftOrFirst];
+        current.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+        current.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+    }
+}
+
+/***********************************************************
+ *  Refit()
+ *
+ *  This method is called when an item has moved. Its leaf
+ *  and then each ancestor is refit to its contents, stopping
+ *  at the first node whose box does not change. The tree
+ *  keeps its shape, so it can slowly get less tight as
+ *  items wander away from where it was built.
+ ***********************************************************/
+void BoundingVolumeHierarchy::Refit(int item, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    if ((item < 0) || (item >= (int)m_itemSlots.size()))
+    {
+        return;
+    }
+
+    int slot = m_itemSlots[item];
+    m_itemMin[slot] = boundsMin;
+    m_itemMax[slot] = boundsMax;
+
+    int node = m_itemLeaves[item];
+    while (node >= 0)
+    {
+        glm::vec3 oldMin = m_nodes[node].boundsMin;
+        glm::vec3 oldMax = m_nodes[node].boundsMax;
+        UpdateNodeBounds(node);
+        if ((m_nodes[node].boundsMin == oldMin) && (m_nodes[node].boundsMax == oldMax))
+        {
+            break;
+        }
+        node = m_parents[node];
+    }
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method is called to find the items inside the
+ *  frustum of a view projection matrix. Subtrees outside a
+ *  plane are skipped, and planes a node is fully inside of
+ *  are not tested again below it.
+ ***********************************************************/
+int BoundingVolumeHierarchy::Cull(const glm::mat4& viewProjection, std::vector<unsigned char>& visible) const
+{
+    visible.assign(m_itemIndices.size(), 0);
+    if (m_nodes.empty())
+    {
+        return 0;
+    }
+
+    glm::vec4 planes[6];
+    FrustumCuller::ExtractPlanes(viewProjection, planes);
+
+    int visibleCount = 0;
+    std::vector<CULL_ENTRY> stack;
+    stack.reserve(m_depth + 1);
+    stack.push_back({ 0, 0x3F });
+
+    while (!stack.empty())
+    {
+        CULL_ENTRY entry = stack.back();
+        stack.pop_back();
+
+        const BVH_NODE& node = m_nodes[entry.node];
+        int planeMask = entry.planeMask;
+        if ((planeMask != 0) && IsOutsidePlanes(planes, node.boundsMin, node.boundsMax, planeMask))
+        {
+            continue;
+        }
+
+        if (node.itemCount == 0)
+        {
+            stack.push_back({ node.leftOrFirst, planeMask });
+            stack.push_back({ entry.node + 1, planeMask });
+            continue;
+        }
+
+        for (int slot = node.leftOrFirst; slot < node.leftOrFirst + node.itemCount; slot++)
+        {
+            int itemMask = planeMask;
+            if ((itemMask != 0) && IsOutsidePlanes(planes, m_itemMin[slot], m_itemMax[slot], itemMask))
+            {
+                continue;
+            }
+            visible[m_itemIndices[slot]] = 1;
+            visibleCount++;
+        }
+    }
+
+    return visibleCount;
+}
+
+/***********************************************************
+ *  QueryBox()
+ *
+ *  This method is called to find the items whose boxes
+ *  overlap a world space box.
+ ***********************************************************/
+void BoundingVolumeHierarchy::QueryBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<int>& items) const
+{
+    items.clear();
+    if (m_nodes.empty())
+    {
+        return;
+    }
+
+    std::vector<int> stack;
+    stack.reserve(m_depth + 1);
+    stack.push_back(0);
+
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        stack.pop_back();
+
+        const BVH_NODE& node = m_nodes[index];
+        if (!Overlaps(node.boundsMin, node.boundsMax, boundsMin, boundsMax))
+        {
+            continue;
+        }
+
+        if (node.itemCount == 0)
+        {
+            stack.push_back(node.leftOrFirst);
+            stack.push_back(index + 1);
+            continue;
+        }
+
+        for (int slot = node.leftOrFirst; slot < node.leftOrFirst + node.itemCount; slot++)
+        {
+            if (Overlaps(m_itemMin[slot], m_itemMax[slot], boundsMin, boundsMax))
+            {
+                items.push_back(m_itemIndices[slot]);
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+// boundingvolumehierarchy.h
+// ============
+// a tree of bounding boxes over the scene objects, built with the surface
+// area heuristic and flattened into one array of nodes, used to find the
+// objects inside a view frustum or a region of the scene
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class BoundingVolumeHierarchy
+{
+public:
+	// constructor
+	BoundingVolumeHierarchy();
+	// destructor
+	~BoundingVolumeHierarchy();
+
+	// one node of the flattened tree; an interior node's first
+	// child follows it in the array, and its second child is at
+	// leftOrFirst, while a leaf's items start at leftOrFirst
+	struct BVH_NODE
+	{
+		glm::vec3 boundsMin;
+		int leftOrFirst;
+		glm::vec3 boundsMax;
+		int itemCount;
+	};
+
+	// build the tree over one box per item, replacing any old one
+	void Build(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax);
+	// move one item's box, growing or shrinking its ancestors
+	// without rebuilding the tree
+	void Refit(int item, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	// test the items against the frustum of a view projection
+	// matrix; visible gets one entry per item, set to 1 when the
+	// item may be visible, and the number of those is returned
+	int Cull(const glm::mat4& viewProjection, std::vector<unsigned char>& visible) const;
+	// find the items whose boxes overlap a box
+	void QueryBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<int>& items) const;
+
+	int GetItemCount() const { return (int)m_itemIndices.size(); }
+	int GetNodeCount() const { return (int)m_nodes.size(); }
+	int GetDepth() const { return m_depth; }
+
+private:
+	std::vector<BVH_NODE> m_nodes;
+	// parent of each node, followed when refitting
+	std::vector<int> m_parents;
+	// item boxes and indices, in the order the leaves use them
+	std::vector<glm::vec3> m_itemMin;
+	std::vector<glm::vec3> m_itemMax;
+	std::vector<int> m_itemIndices;
+	// where each item ended up, by item index
+	std::vector<int> m_itemSlots;
+	std::vector<int> m_itemLeaves;
+	int m_depth;
+
+	// split a range of items into a subtree, returning its node
+	int BuildNode(int first, int count, int parent, int depth);
+	// set a node's box from its items or children
+	void UpdateNodeBounds(int node);
+};
@@ -0,0 +1,230 @@
+///////////////////////////////////////////////////////////////////////////////
+// frameringbuffer.cpp
+// ============
+// one persistently mapped buffer split into a region per frame in flight,
+// which the per-frame data is written straight into; fences keep a region
+// from being rewritten while the GPU may still be reading it
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameRingBuffer.h"
+
+#include <iostream>
+
+namespace
+{
+    // how long one wait on a fence lasts before trying again,
+    // in nanoseconds
+    const GLuint64 g_FenceWaitTimeout = 1000000;
+}
+
+/***********************************************************
+ *  FrameRingBuffer()
+ *
+ *  The constructor for the class.
+ ***********************************************************/
+FrameRingBuffer::FrameRingBuffer()
+{
+    m_buffer = 0;
+    m_mapped = NULL;
+    m_frameSize = 0;
+    m_frame = 0;
+    m_frameOffset = 0;
+    for (int i = 0; i < FRAME_COUNT; i++)
+    {
+        m_fences[i] = 0;
+    }
+    m_uniformAlignment = 256;
+    m_storageAlignment = 256;
+    m_stallCount = 0;
+}
+
+/***********************************************************
+ *  ~FrameRingBuffer()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+FrameRingBuffer::~FrameRingBuffer()
+{
+    Destroy();
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is called to find out whether buffers can be
+ *  created with glBufferStorage and mapped persistently.
+ ***********************************************************/
+bool FrameRingBuffer::IsSupported()
+{
+#ifdef __APPLE__
+    // macOS stops at OpenGL 4.1
+    return false;
+#else
+    return (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) ? true : false;
+#endif
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is called to create the buffer and map it
+ *  for the lifetime of the buffer. The mapping is coherent,
+ *  so writes reach the GPU without being flushed.
+ ***********************************************************/
+bool FrameRingBuffer::Create(size_t frameSize)
+{
+    Destroy();
+
+    if (!IsSupported() || (frameSize == 0))
+    {
+        return false;
+    }
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_uniformAlignment = (alignment > 0) ? (size_t)alignment : 256;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_storageAlignment = (alignment > 0) ? (size_t)alignment : 256;
+
+    // keep every region starting on an aligned offset
+    size_t largestAlignment = (m_uniformAlignment > m_storageAlignment) ? m_uniformAlignment : m_storageAlignment;
+    m_frameSize = (frameSize + largestAlignment - 1) / largestAlignment * largestAlignment;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr totalSize = (GLsizeiptr)(m_frameSize * FRAME_COUNT);
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, NULL, flags);
+    m_mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (m_mapped == NULL)
+    {
+        std::cout << "FrameRingBuffer: the buffer could not be mapped" << std::endl;
+        Destroy();
+        return false;
+    }
+
+    m_frame = 0;
+    m_frameOffset = 0;
+    return true;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is called to unmap and free the buffer and
+ *  its fences.
+ ***********************************************************/
+void FrameRingBuffer::Destroy()
+{
+    for (int i = 0; i < FRAME_COUNT; i++)
+    {
+        if (m_fences[i] != 0)
+        {
+            glDeleteSync(m_fences[i]);
+            m_fences[i] = 0;
+        }
+    }
+
+    if (m_buffer != 0)
+    {
+        if (m_mapped != NULL)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+    }
+    m_mapped = NULL;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is called at the start of a frame. The frame
+ *  reuses the region written FRAME_COUNT frames ago, so it
+ *  waits on that frame's fence, which is normally signalled
+ *  long before.
+ ***********************************************************/
+void FrameRingBuffer::BeginFrame()
+{
+    m_frameOffset = 0;
+
+    GLsync fence = m_fences[m_frame];
+    if (fence == 0)
+    {
+        return;
+    }
+
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if ((result == GL_TIMEOUT_EXPIRED) || (result == GL_WAIT_FAILED))
+    {
+        m_stallCount++;
+        GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        do
+        {
+            result = glClientWaitSync(fence, waitFlags, g_FenceWaitTimeout);
+            waitFlags = 0;
+        } while (result == GL_TIMEOUT_EXPIRED);
+    }
+
+    glDeleteSync(fence);
+    m_fences[m_frame] = 0;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is called once every command reading the
+ *  current region has been issued. The fence goes in after
+ *  them, and the next frame moves to the next region.
+ ***********************************************************/
+void FrameRingBuffer::EndFrame()
+{
+    if (m_mapped == NULL)
+    {
+        return;
+    }
+
+    if (m_fences[m_frame] != 0)
+    {
+        glDeleteSync(m_fences[m_frame]);
+    }
+    m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_frame = (m_frame + 1) % FRAME_COUNT;
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method is called to reserve memory in the current
+ *  region. Nothing is freed until the region comes around
+ *  again, so callers write each frame's data in full.
+ ***********************************************************/
+void* FrameRingBuffer::Allocate(size_t size, size_t alignment, GLintptr& offset)
+{
+    if ((m_mapped == NULL) || (size == 0))
+    {
+        return NULL;
+    }
+
+    if (alignment == 0)
+    {
+        alignment = 1;
+    }
+    size_t start = (m_frameOffset + alignment - 1) / alignment * alignment;
+    if (start + size > m_frameSize)
+    {
+        return NULL;
+    }
+
+    m_frameOffset = start + size;
+    offset = (GLintptr)(m_frame * m_frameSize + start);
+    return m_mapped + offset;
+}
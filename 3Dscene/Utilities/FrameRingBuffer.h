@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// frameringbuffer.h
+// ============
+// one persistently mapped buffer split into a region per frame in flight,
+// which the per-frame data is written straight into; fences keep a region
+// from being rewritten while the GPU may still be reading it
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+
+#include <cstddef>
+
+class FrameRingBuffer
+{
+public:
+	// constructor
+	FrameRingBuffer();
+	// destructor
+	~FrameRingBuffer();
+
+	// number of frames that can be in flight at once
+	static const int FRAME_COUNT = 3;
+
+	// whether the context can map buffers persistently
+	static bool IsSupported();
+
+	// create the buffer with frameSize bytes for each frame,
+	// returning false when it can't be mapped
+	bool Create(size_t frameSize);
+	// unmap and free the buffer
+	void Destroy();
+	bool IsMapped() const { return m_mapped != NULL; }
+
+	// wait until the GPU is done with the next region, then
+	// start handing out its memory
+	void BeginFrame();
+	// mark the end of the GPU's use of the current region
+	void EndFrame();
+
+	// reserve size bytes of the current region, returning where
+	// to write them, or NULL when the region is full; offset is
+	// set to their position in the buffer
+	void* Allocate(size_t size, size_t alignment, GLintptr& offset);
+
+	GLuint GetBuffer() const { return m_buffer; }
+	// offset alignments for uniform and shader storage ranges
+	size_t GetUniformAlignment() const { return m_uniformAlignment; }
+	size_t GetStorageAlignment() const { return m_storageAlignment; }
+	// number of frames that had to wait for the GPU
+	int GetStallCount() const { return m_stallCount; }
+
+private:
+	GLuint m_buffer;
+	unsigned char* m_mapped;
+	size_t m_frameSize;
+	// region written during the current frame
+	int m_frame;
+	size_t m_frameOffset;
+	// signalled once the GPU is done with each region
+	GLsync m_fences[FRAME_COUNT];
+	size_t m_uniformAlignment;
+	size_t m_storageAlignment;
+	int m_stallCount;
+};
@@ -0,0 +1,269 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.cpp
+// ============
+// world space bounding boxes stored as structure of arrays, tested against
+// the six planes of a view frustum several boxes at a time with SSE or AVX
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrustumCuller.h"
+
+#include <cmath>
+
+// pick the widest kernel the compiler targets; x64 always has SSE
+#if defined(__AVX__)
+#define FRUSTUM_CULLER_AVX
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define FRUSTUM_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+    // boxes tested per iteration, which the arrays are padded to
+#if defined(FRUSTUM_CULLER_AVX)
+    const int g_BoxesPerIteration = 8;
+#elif defined(FRUSTUM_CULLER_SSE)
+    const int g_BoxesPerIteration = 4;
+#else
+    const int g_BoxesPerIteration = 1;
+#endif
+
+    // the corner of each box furthest along a plane's normal; if it
+    // is behind the plane, the whole box is outside the frustum
+    struct PLANE_CORNER
+    {
+        const float* x;
+        const float* y;
+        const float* z;
+    };
+}
+
+/***********************************************************
+ *  FrustumCuller()
+ *
+ *  The constructor for the class.
+ ***********************************************************/
+FrustumCuller::FrustumCuller()
+{
+    m_count = 0;
+}
+
+/***********************************************************
+ *  ~FrustumCuller()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+FrustumCuller::~FrustumCuller()
+{
+}
+
+/***********************************************************
+ *  Resize()
+ *
+ *  This method is called to change the number of boxes.
+ *  New boxes are empty points at the origin.
+ ***********************************************************/
+void FrustumCuller::Resize(int count)
+{
+    m_count = (count > 0) ? count : 0;
+
+    size_t padded = (size_t)((m_count + g_BoxesPerIteration - 1) / g_BoxesPerIteration) * g_BoxesPerIteration;
+    m_minX.resize(padded, 0.0f);
+    m_minY.resize(padded, 0.0f);
+    m_minZ.resize(padded, 0.0f);
+    m_maxX.resize(padded, 0.0f);
+    m_maxY.resize(padded, 0.0f);
+    m_maxZ.resize(padded, 0.0f);
+}
+
+/***********************************************************
+ *  SetBounds()
+ *
+ *  This method is called to set the world space bounds of
+ *  one box.
+ ***********************************************************/
+void FrustumCuller::SetBounds(int index, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    if ((index < 0) || (index >= m_count))
+    {
+        return;
+    }
+
+    m_minX[index] = boundsMin.x;
+    m_minY[index] = boundsMin.y;
+    m_minZ[index] = boundsMin.z;
+    m_maxX[index] = boundsMax.x;
+    m_maxY[index] = boundsMax.y;
+    m_maxZ[index] = boundsMax.z;
+}
+
+/***********************************************************
+ *  GetBounds()
+ *
+ *  This method is called to read the world space bounds of
+ *  one box.
+ ***********************************************************/
+void FrustumCuller::GetBounds(int index, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+    if ((index < 0) || (index >= m_count))
+    {
+        boundsMin = glm::vec3(0.0f);
+        boundsMax = glm::vec3(0.0f);
+        return;
+    }
+
+    boundsMin = glm::vec3(m_minX[index], m_minY[index], m_minZ[index]);
+    boundsMax = glm::vec3(m_maxX[index], m_maxY[index], m_maxZ[index]);
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method is called to test every box against the six
+ *  frustum planes. Each plane picks, per axis, the min or
+ *  max array that holds the box corner furthest along its
+ *  normal, so the kernel is a run of multiply-adds and one
+ *  compare per plane for several boxes at once.
+ ***********************************************************/
+int FrustumCuller::Cull(const glm::mat4& viewProjection, std::vector<unsigned char>& visible) const
+{
+    visible.assign(m_count, 0);
+    if (m_count == 0)
+    {
+        return 0;
+    }
+
+    glm::vec4 planes[6];
+    ExtractPlanes(viewProjection, planes);
+
+    PLANE_CORNER corners[6];
+    for (int p = 0; p < 6; p++)
+    {
+        corners[p].x = (planes[p].x >= 0.0f) ? m_maxX.data() : m_minX.data();
+        corners[p].y = (planes[p].y >= 0.0f) ? m_maxY.data() : m_minY.data();
+        corners[p].z = (planes[p].z >= 0.0f) ? m_maxZ.data() : m_minZ.data();
+    }
+
+    int visibleCount = 0;
+    int padded = (int)m_minX.size();
+
+    for (int i = 0; i < padded; i += g_BoxesPerIteration)
+    {
+        int outsideMask = 0;
+
+#if defined(FRUSTUM_CULLER_AVX)
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; p++)
+        {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(planes[p].x), _mm256_loadu_ps(corners[p].x + i)),
+                    _mm256_mul_ps(_mm256_set1_ps(planes[p].y), _mm256_loadu_ps(corners[p].y + i))),
+                _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(planes[p].z), _mm256_loadu_ps(corners[p].z + i)),
+                    _mm256_set1_ps(planes[p].w)));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        outsideMask = _mm256_movemask_ps(outside);
+#elif defined(FRUSTUM_CULLER_SSE)
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(planes[p].x), _mm_loadu_ps(corners[p].x + i)),
+                    _mm_mul_ps(_mm_set1_ps(planes[p].y), _mm_loadu_ps(corners[p].y + i))),
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(planes[p].z), _mm_loadu_ps(corners[p].z + i)),
+                    _mm_set1_ps(planes[p].w)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+        }
+        outsideMask = _mm_movemask_ps(outside);
+#else
+        for (int p = 0; p < 6; p++)
+        {
+            float distance = planes[p].x * corners[p].x[i] +
+                planes[p].y * corners[p].y[i] +
+                planes[p].z * corners[p].z[i] + planes[p].w;
+            if (distance < 0.0f)
+            {
+                outsideMask = 1;
+                break;
+            }
+        }
+#endif
+
+        // the padding past the last box is ignored
+        for (int lane = 0; (lane < g_BoxesPerIteration) && (i + lane < m_count); lane++)
+        {
+            if ((outsideMask & (1 << lane)) == 0)
+            {
+                visible[i + lane] = 1;
+                visibleCount++;
+            }
+        }
+    }
+
+    return visibleCount;
+}
+
+/***********************************************************
+ *  ExtractPlanes()
+ *
+ *  This method is called to find the frustum planes of a
+ *  view projection matrix, from the sums and differences
+ *  of its rows. A point is inside a plane when
+ *  dot(plane.xyz, point) + plane.w is positive.
+ ***********************************************************/
+void FrustumCuller::ExtractPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    // glm matrices are indexed by column, then row
+    glm::vec4 rows[4];
+    for (int row = 0; row < 4; row++)
+    {
+        rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row],
+            viewProjection[2][row], viewProjection[3][row]);
+    }
+
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[3] + rows[2];
+    planes[5] = rows[3] - rows[2];
+}
+
+/***********************************************************
+ *  TransformBounds()
+ *
+ *  This method is called to find the world space box that
+ *  encloses a local box after it is scaled, rotated and
+ *  moved, by transforming its center and adding up the
+ *  absolute contributions of its extent along each axis.
+ ***********************************************************/
+void FrustumCuller::TransformBounds(
+    const glm::vec3& localMin,
+    const glm::vec3& localMax,
+    const glm::mat4& modelMatrix,
+    glm::vec3& worldMin,
+    glm::vec3& worldMax)
+{
+    glm::vec3 center = (localMin + localMax) * 0.5f;
+    glm::vec3 extent = (localMax - localMin) * 0.5f;
+
+    glm::vec3 worldCenter = glm::vec3(modelMatrix * glm::vec4(center, 1.0f));
+    glm::vec3 worldExtent;
+    for (int row = 0; row < 3; row++)
+    {
+        worldExtent[row] =
+            std::fabs(modelMatrix[0][row]) * extent.x +
+            std::fabs(modelMatrix[1][row]) * extent.y +
+            std::fabs(modelMatrix[2][row]) * extent.z;
+    }
+
+    worldMin = worldCenter - worldExtent;
+    worldMax = worldCenter + worldExtent;
+}
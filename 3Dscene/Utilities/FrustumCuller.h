@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.h
+// ============
+// world space bounding boxes stored as structure of arrays, tested against
+// the six planes of a view frustum several boxes at a time with SSE or AVX
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class FrustumCuller
+{
+public:
+	// constructor
+	FrustumCuller();
+	// destructor
+	~FrustumCuller();
+
+	// change the number of boxes, keeping the existing ones
+	void Resize(int count);
+	int GetCount() const { return m_count; }
+
+	// set the world space bounds of one box
+	void SetBounds(int index, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	// read back the world space bounds of one box
+	void GetBounds(int index, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+
+	// test every box against the frustum of a view projection
+	// matrix; visible gets one entry per box, set to 1 when the
+	// box may be visible, and the number of those is returned
+	int Cull(const glm::mat4& viewProjection, std::vector<unsigned char>& visible) const;
+
+	// the planes of a view projection matrix, pointing inward,
+	// in the order left, right, bottom, top, near, far
+	static void ExtractPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+	// the world space box around a transformed local box
+	static void TransformBounds(const glm::vec3& localMin, const glm::vec3& localMax,
+		const glm::mat4& modelMatrix, glm::vec3& worldMin, glm::vec3& worldMax);
+
+private:
+	int m_count;
+
+	// box corners, one array per component, padded to a
+	// multiple of the widest SIMD kernel
+	std::vector<float> m_minX;
+	std::vector<float> m_minY;
+	std::vector<float> m_minZ;
+	std::vector<float> m_maxX;
+	std::vector<float> m_maxY;
+	std::vector<float> m_maxZ;
+};
@@ -0,0 +1,363 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.cpp
+// ============
+// tracks the OpenGL binding and enable state the application changes, and
+// only calls into OpenGL when a requested state differs from the current one
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLStateCache.h"
+
+namespace
+{
+    // marks a binding whose current value is not known
+    const GLuint g_Unknown = 0xFFFFFFFF;
+}
+
+/***********************************************************
+ *  Get()
+ *
+ *  Returns the cache. The application has a single context,
+ *  so a single cache follows it.
+ ***********************************************************/
+GLStateCache& GLStateCache::Get()
+{
+    static GLStateCache cache;
+    return cache;
+}
+
+/***********************************************************
+ *  GLStateCache()
+ *
+ *  The constructor for the class. Nothing is known about
+ *  the context until the first state change.
+ ***********************************************************/
+GLStateCache::GLStateCache()
+{
+    m_issuedCalls = 0;
+    m_elidedCalls = 0;
+    m_lastIssuedCalls = 0;
+    m_lastElidedCalls = 0;
+    Invalidate();
+}
+
+/***********************************************************
+ *  Invalidate()
+ *
+ *  This method is called to forget all of the tracked
+ *  state, so the next change of each is always issued.
+ ***********************************************************/
+void GLStateCache::Invalidate()
+{
+    m_program = g_Unknown;
+    m_vertexArray = g_Unknown;
+    m_framebuffer = g_Unknown;
+    m_activeUnit = -1;
+    for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+    {
+        for (int target = 0; target < TARGET_COUNT; target++)
+        {
+            m_textures[unit][target] = g_Unknown;
+        }
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        m_viewport[i] = -1;
+    }
+    for (int i = 0; i < CAP_COUNT; i++)
+    {
+        m_enabled[i] = -1;
+    }
+    m_blendSource = g_Unknown;
+    m_blendDestination = g_Unknown;
+    m_colorMask = -1;
+    m_depthMask = -1;
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  This method is called to make a shader program current.
+ ***********************************************************/
+void GLStateCache::UseProgram(GLuint program)
+{
+    if (Changes(m_program != program))
+    {
+        glUseProgram(program);
+        m_program = program;
+    }
+}
+
+/***********************************************************
+ *  BindVertexArray()
+ *
+ *  This method is called to bind a vertex array object.
+ ***********************************************************/
+void GLStateCache::BindVertexArray(GLuint vertexArray)
+{
+    if (Changes(m_vertexArray != vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+        m_vertexArray = vertexArray;
+    }
+}
+
+/***********************************************************
+ *  SetActiveUnit()
+ *
+ *  This method is called to select the texture unit that
+ *  the next texture bind applies to.
+ ***********************************************************/
+void GLStateCache::SetActiveUnit(GLuint unit)
+{
+    if (Changes(m_activeUnit != (GLint)unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_activeUnit = (GLint)unit;
+    }
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is called to bind a texture to a texture
+ *  unit. Targets and units the cache doesn't track are
+ *  always passed on to OpenGL.
+ ***********************************************************/
+void GLStateCache::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    int targetIndex = FindTarget(target);
+    if ((targetIndex < 0) || (unit >= (GLuint)MAX_TEXTURE_UNITS))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        m_activeUnit = (GLint)unit;
+        m_issuedCalls += 2;
+        return;
+    }
+
+    if (Changes(m_textures[unit][targetIndex] != texture))
+    {
+        SetActiveUnit(unit);
+        glBindTexture(target, texture);
+        m_textures[unit][targetIndex] = texture;
+    }
+}
+
+/***********************************************************
+ *  BindFramebuffer()
+ *
+ *  This method is called to bind a framebuffer for both
+ *  drawing and reading. Zero is the window.
+ ***********************************************************/
+void GLStateCache::BindFramebuffer(GLuint framebuffer)
+{
+    if (Changes(m_framebuffer != framebuffer))
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        m_framebuffer = framebuffer;
+    }
+}
+
+/***********************************************************
+ *  Viewport()
+ *
+ *  This method is called to set the viewport rectangle.
+ ***********************************************************/
+void GLStateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    bool bChanged = (m_viewport[0] != x) || (m_viewport[1] != y) ||
+        (m_viewport[2] != (GLint)width) || (m_viewport[3] != (GLint)height);
+    if (Changes(bChanged))
+    {
+        glViewport(x, y, width, height);
+        m_viewport[0] = x;
+        m_viewport[1] = y;
+        m_viewport[2] = (GLint)width;
+        m_viewport[3] = (GLint)height;
+    }
+}
+
+/***********************************************************
+ *  SetEnabled()
+ *
+ *  This method is called to turn a capability on or off.
+ *  Capabilities the cache doesn't track are always passed
+ *  on to OpenGL.
+ ***********************************************************/
+void GLStateCache::SetEnabled(GLenum capability, bool bEnabled)
+{
+    int index = FindCapability(capability);
+    int value = bEnabled ? 1 : 0;
+    if (index >= 0)
+    {
+        if (!Changes(m_enabled[index] != value))
+        {
+            return;
+        }
+        m_enabled[index] = value;
+    }
+    else
+    {
+        m_issuedCalls++;
+    }
+
+    if (bEnabled)
+    {
+        glEnable(capability);
+    }
+    else
+    {
+        glDisable(capability);
+    }
+}
+
+/***********************************************************
+ *  BlendFunc()
+ *
+ *  This method is called to set the blending factors.
+ ***********************************************************/
+void GLStateCache::BlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+    if (Changes((m_blendSource != sourceFactor) || (m_blendDestination != destinationFactor)))
+    {
+        glBlendFunc(sourceFactor, destinationFactor);
+        m_blendSource = sourceFactor;
+        m_blendDestination = destinationFactor;
+    }
+}
+
+/***********************************************************
+ *  ColorMask()
+ *
+ *  This method is called to turn color writes on or off
+ *  for all four channels at once.
+ ***********************************************************/
+void GLStateCache::ColorMask(bool bWriteColor)
+{
+    if (Changes(m_colorMask != (bWriteColor ? 1 : 0)))
+    {
+        GLboolean write = bWriteColor ? GL_TRUE : GL_FALSE;
+        glColorMask(write, write, write, write);
+        m_colorMask = bWriteColor ? 1 : 0;
+    }
+}
+
+/***********************************************************
+ *  DepthMask()
+ *
+ *  This method is called to turn depth writes on or off.
+ *  Depth writes also gate glClear() of the depth buffer.
+ ***********************************************************/
+void GLStateCache::DepthMask(bool bWriteDepth)
+{
+    if (Changes(m_depthMask != (bWriteDepth ? 1 : 0)))
+    {
+        glDepthMask(bWriteDepth ? GL_TRUE : GL_FALSE);
+        m_depthMask = bWriteDepth ? 1 : 0;
+    }
+}
+
+/***********************************************************
+ *  InvalidateVertexArray()
+ *
+ *  This method is called after code outside the cache has
+ *  bound a vertex array of its own.
+ ***********************************************************/
+void GLStateCache::InvalidateVertexArray()
+{
+    m_vertexArray = g_Unknown;
+}
+
+/***********************************************************
+ *  ForgetTexture()
+ *
+ *  This method is called when a texture is deleted. OpenGL
+ *  unbinds it and may hand its name out again, so it must
+ *  not stay recorded as bound.
+ ***********************************************************/
+void GLStateCache::ForgetTexture(GLuint texture)
+{
+    for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+    {
+        for (int target = 0; target < TARGET_COUNT; target++)
+        {
+            if (m_textures[unit][target] == texture)
+            {
+                m_textures[unit][target] = 0;
+            }
+        }
+    }
+}
+
+/***********************************************************
+ *  ForgetVertexArray()
+ *
+ *  This method is called when a vertex array is deleted.
+ ***********************************************************/
+void GLStateCache::ForgetVertexArray(GLuint vertexArray)
+{
+    if (m_vertexArray == vertexArray)
+    {
+        m_vertexArray = 0;
+    }
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is called at the start of each frame to
+ *  keep the counts of the finished frame and start over.
+ ***********************************************************/
+void GLStateCache::BeginFrame()
+{
+    m_lastIssuedCalls = m_issuedCalls;
+    m_lastElidedCalls = m_elidedCalls;
+    m_issuedCalls = 0;
+    m_elidedCalls = 0;
+}
+
+/***********************************************************
+ *  FindTarget()
+ *
+ *  This method is called to find the slot of a texture
+ *  target, or -1 when it isn't tracked.
+ ***********************************************************/
+int GLStateCache::FindTarget(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D:
+        return TARGET_2D;
+    case GL_TEXTURE_2D_ARRAY:
+        return TARGET_2D_ARRAY;
+    case GL_TEXTURE_CUBE_MAP:
+        return TARGET_CUBE_MAP;
+    default:
+        return -1;
+    }
+}
+
+/***********************************************************
+ *  FindCapability()
+ *
+ *  This method is called to find the slot of a capability,
+ *  or -1 when it isn't tracked.
+ ***********************************************************/
+int GLStateCache::FindCapability(GLenum capability)
+{
+    switch (capability)
+    {
+    case GL_DEPTH_TEST:
+        return CAP_DEPTH_TEST;
+    case GL_BLEND:
+        return CAP_BLEND;
+    case GL_CULL_FACE:
+        return CAP_CULL_FACE;
+    case GL_DEPTH_CLAMP:
+        return CAP_DEPTH_CLAMP;
+    default:
+        return -1;
+    }
+}
@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.h
+// ============
+// tracks the OpenGL binding and enable state the application changes, and
+// only calls into OpenGL when a requested state differs from the current one
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+
+class GLStateCache
+{
+public:
+	// the cache of the current context
+	static GLStateCache& Get();
+
+	// texture units tracked by the cache
+	static const int MAX_TEXTURE_UNITS = 16;
+
+	// forget everything, for when code outside the cache may
+	// have changed the state
+	void Invalidate();
+
+	// state changes, skipped when the state is already set
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vertexArray);
+	void BindTexture(GLuint unit, GLenum target, GLuint texture);
+	void BindFramebuffer(GLuint framebuffer);
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+	void SetEnabled(GLenum capability, bool bEnabled);
+	void BlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+	void ColorMask(bool bWriteColor);
+	void DepthMask(bool bWriteDepth);
+
+	// forget a single binding that was changed, or an object
+	// that was deleted, behind the cache's back
+	void InvalidateVertexArray();
+	void ForgetTexture(GLuint texture);
+	void ForgetVertexArray(GLuint vertexArray);
+
+	// start counting the calls of a new frame
+	void BeginFrame();
+	// calls made and skipped during the previous frame
+	int GetIssuedCalls() const { return m_lastIssuedCalls; }
+	int GetElidedCalls() const { return m_lastElidedCalls; }
+
+private:
+	// constructor, the cache is only reached through Get()
+	GLStateCache();
+
+	// texture targets tracked on every unit
+	enum TEXTURE_TARGET
+	{
+		TARGET_2D = 0,
+		TARGET_2D_ARRAY,
+		TARGET_CUBE_MAP,
+		TARGET_COUNT
+	};
+
+	// capabilities tracked by SetEnabled()
+	enum CAPABILITY
+	{
+		CAP_DEPTH_TEST = 0,
+		CAP_BLEND,
+		CAP_CULL_FACE,
+		CAP_DEPTH_CLAMP,
+		CAP_COUNT
+	};
+
+	GLuint m_program;
+	GLuint m_vertexArray;
+	GLuint m_framebuffer;
+	GLint m_activeUnit;
+	GLuint m_textures[MAX_TEXTURE_UNITS][TARGET_COUNT];
+	GLint m_viewport[4];
+	// -1 while unknown, otherwise 0 or 1
+	int m_enabled[CAP_COUNT];
+	GLenum m_blendSource;
+	GLenum m_blendDestination;
+	int m_colorMask;
+	int m_depthMask;
+
+	int m_issuedCalls;
+	int m_elidedCalls;
+	int m_lastIssuedCalls;
+	int m_lastElidedCalls;
+
+	// count a call that reached OpenGL, or return false and
+	// count it as skipped when the state is unchanged
+	inline bool Changes(bool bChanged)
+	{
+		if (bChanged)
+		{
+			m_issuedCalls++;
+		}
+		else
+		{
+			m_elidedCalls++;
+		}
+		return(bChanged);
+	}
+
+	void SetActiveUnit(GLuint unit);
+	static int FindTarget(GLenum target);
+	static int FindCapability(GLenum capability);
+};
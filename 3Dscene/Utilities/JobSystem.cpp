@@ -0,0 +1,241 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.cpp
+// ============
+// a pool of worker threads that split loops between them; every thread owns
+// a queue of jobs it takes from the back of, and idle threads steal from the
+// front of the other queues
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace
+{
+    // most worker threads started, whatever the core count
+    const unsigned int g_MaxWorkers = 15;
+
+    // queue owned by the current thread, or -1 outside the pool
+    thread_local int t_queue = -1;
+}
+
+/***********************************************************
+ *  Get()
+ *
+ *  Returns the job system, starting its workers the first
+ *  time it is reached.
+ ***********************************************************/
+JobSystem& JobSystem::Get()
+{
+    static JobSystem jobSystem;
+    return jobSystem;
+}
+
+/***********************************************************
+ *  JobSystem()
+ *
+ *  The constructor for the class. One worker is started for
+ *  every core but the one the calling thread runs on.
+ ***********************************************************/
+JobSystem::JobSystem()
+    : m_queuedJobs(0), m_stolenJobs(0), m_bStopping(false)
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+    unsigned int workerCount = (cores > 1) ? std::min(cores - 1, g_MaxWorkers) : 0;
+
+    m_queueCount = (int)workerCount + 1;
+    m_queues.reset(new JOB_QUEUE[m_queueCount]);
+
+    for (unsigned int i = 0; i < workerCount; i++)
+    {
+        m_threads.push_back(std::thread(&JobSystem::WorkerLoop, this, (int)i));
+    }
+}
+
+/***********************************************************
+ *  ~JobSystem()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+JobSystem::~JobSystem()
+{
+    m_bStopping = true;
+    {
+        std::lock_guard<std::mutex> lock(m_sleepLock);
+    }
+    m_wake.notify_all();
+
+    for (size_t i = 0; i < m_threads.size(); i++)
+    {
+        m_threads[i].join();
+    }
+}
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  This method is called to split a loop into jobs. They go
+ *  on the calling thread's queue, where the idle workers
+ *  steal them from, while the calling thread runs them from
+ *  the other end until none are left.
+ ***********************************************************/
+void JobSystem::ParallelFor(size_t count, size_t grainSize, const RANGE_FUNCTION& function)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (grainSize == 0)
+    {
+        grainSize = 1;
+    }
+
+    size_t jobCount = (count + grainSize - 1) / grainSize;
+    if (m_threads.empty() || (jobCount == 1))
+    {
+        for (size_t begin = 0; begin < count; begin += grainSize)
+        {
+            function(begin, std::min(count, begin + grainSize));
+        }
+        return;
+    }
+
+    std::atomic<size_t> pending(jobCount);
+    int queue = GetThreadQueue();
+
+    m_queuedJobs += (int)jobCount;
+    {
+        std::lock_guard<std::mutex> lock(m_queues[queue].lock);
+        for (size_t begin = 0; begin < count; begin += grainSize)
+        {
+            JOB job;
+            job.function = &function;
+            job.begin = begin;
+            job.end = std::min(count, begin + grainSize);
+            job.pending = &pending;
+            m_queues[queue].jobs.push_back(job);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_sleepLock);
+    }
+    m_wake.notify_all();
+
+    // the last jobs may be running on other threads, which
+    // the caller can only wait out
+    while (pending.load() > 0)
+    {
+        if (!RunNextJob(queue))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ *
+ *  This method is run by each worker thread. It runs jobs
+ *  for as long as there are any, then sleeps until more
+ *  are queued.
+ ***********************************************************/
+void JobSystem::WorkerLoop(int queue)
+{
+    t_queue = queue;
+
+    while (!m_bStopping)
+    {
+        if (RunNextJob(queue))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepLock);
+        m_wake.wait(lock, [this]() { return m_bStopping || (m_queuedJobs.load() > 0); });
+    }
+}
+
+/***********************************************************
+ *  PopJob()
+ *
+ *  This method is called to take the most recently queued
+ *  job of a thread's own queue, whose data is likely still
+ *  in that core's cache.
+ ***********************************************************/
+bool JobSystem::PopJob(int queue, JOB& job)
+{
+    std::lock_guard<std::mutex> lock(m_queues[queue].lock);
+    if (m_queues[queue].jobs.empty())
+    {
+        return false;
+    }
+
+    job = m_queues[queue].jobs.back();
+    m_queues[queue].jobs.pop_back();
+    m_queuedJobs--;
+    return true;
+}
+
+/***********************************************************
+ *  StealJob()
+ *
+ *  This method is called to take the oldest job of another
+ *  thread's queue, looking at the queues after the thief's
+ *  own first so the thieves spread out.
+ ***********************************************************/
+bool JobSystem::StealJob(int thief, JOB& job)
+{
+    for (int i = 1; i < m_queueCount; i++)
+    {
+        JOB_QUEUE& victim = m_queues[(thief + i) % m_queueCount];
+
+        std::lock_guard<std::mutex> lock(victim.lock);
+        if (victim.jobs.empty())
+        {
+            continue;
+        }
+
+        job = victim.jobs.front();
+        victim.jobs.pop_front();
+        m_queuedJobs--;
+        m_stolenJobs++;
+        return true;
+    }
+
+    return false;
+}
+
+/***********************************************************
+ *  RunNextJob()
+ *
+ *  This method is called to run one job, from the thread's
+ *  own queue when it has any, returning false when there
+ *  was no job anywhere.
+ ***********************************************************/
+bool JobSystem::RunNextJob(int queue)
+{
+    JOB job;
+    if (!PopJob(queue, job) && !StealJob(queue, job))
+    {
+        return false;
+    }
+
+    (*job.function)(job.begin, job.end);
+    // the caller's counter may go away as soon as it reaches
+    // zero, so this is the job's last use of it
+    job.pending->fetch_sub(1);
+    return true;
+}
+
+/***********************************************************
+ *  GetThreadQueue()
+ *
+ *  This method is called to find the queue of the calling
+ *  thread. Threads outside the pool share the last queue.
+ ***********************************************************/
+int JobSystem::GetThreadQueue() const
+{
+    return (t_queue >= 0) ? t_queue : m_queueCount - 1;
+}
@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.h
+// ============
+// a pool of worker threads that split loops between them; every thread owns
+// a queue of jobs it takes from the back of, and idle threads steal from the
+// front of the other queues
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem
+{
+public:
+	// the job system shared by the application
+	static JobSystem& Get();
+	// destructor, waits for the workers to finish
+	~JobSystem();
+
+	// the work of one job, run over the indices [begin, end)
+	typedef std::function<void(size_t begin, size_t end)> RANGE_FUNCTION;
+
+	// run function over [0, count) in jobs of grainSize indices,
+	// returning once every job is done; job k always covers
+	// [k * grainSize, (k + 1) * grainSize), so callers can keep
+	// one output buffer per job. The calling thread runs jobs
+	// too while it waits, and jobs may call ParallelFor again.
+	void ParallelFor(size_t count, size_t grainSize, const RANGE_FUNCTION& function);
+
+	// worker threads, not counting the threads that call in
+	int GetWorkerCount() const { return (int)m_threads.size(); }
+	// jobs run by a thread other than the one that queued them
+	int GetStolenJobs() const { return m_stolenJobs.load(); }
+
+private:
+	// constructor, the job system is only reached through Get()
+	JobSystem();
+
+	struct JOB
+	{
+		const RANGE_FUNCTION* function;
+		size_t begin;
+		size_t end;
+		// jobs of the ParallelFor call still to finish
+		std::atomic<size_t>* pending;
+	};
+
+	// the jobs queued by one thread, locked only by that thread
+	// and by the threads stealing from it
+	struct JOB_QUEUE
+	{
+		std::mutex lock;
+		std::deque<JOB> jobs;
+	};
+
+	std::vector<std::thread> m_threads;
+	// one queue per worker, plus the last one, shared by the
+	// threads outside the pool
+	std::unique_ptr<JOB_QUEUE[]> m_queues;
+	int m_queueCount;
+	// jobs queued and not yet taken, so idle workers know when
+	// to go to sleep
+	std::atomic<int> m_queuedJobs;
+	std::atomic<int> m_stolenJobs;
+	std::atomic<bool> m_bStopping;
+	// only used to put idle workers to sleep and wake them
+	std::mutex m_sleepLock;
+	std::condition_variable m_wake;
+
+	// the loop each worker runs until the system is destroyed
+	void WorkerLoop(int queue);
+	// take a job from the back of a thread's own queue
+	bool PopJob(int queue, JOB& job);
+	// take a job from the front of another thread's queue
+	bool StealJob(int thief, JOB& job);
+	// run a job taken from any queue
+	bool RunNextJob(int queue);
+	// queue of the calling thread
+	int GetThreadQueue() const;
+};
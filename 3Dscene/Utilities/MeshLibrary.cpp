@@ -0,0 +1,733 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshlibrary.cpp
+// ============
+// primitive meshes stored in shared GPU buffers, with support for
+// drawing many copies of a mesh in a single instanced draw call, and
+// for baking static meshes into world space batches
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshLibrary.h"
+#include "GLStateCache.h"
+
+#include <cmath>
+#include <cstddef>
+
+namespace
+{
+    // vertex attribute locations used by the shaders
+    const GLuint g_PositionLocation = 0;
+    const GLuint g_NormalLocation = 1;
+    const GLuint g_TextureCoordinateLocation = 2;
+    const GLuint g_InstanceModelLocation = 3;   // uses locations 3 - 6
+    const GLuint g_InstanceColorLocation = 7;
+    const GLuint g_InstanceMaterialLocation = 8;
+
+    // number of segments around the round meshes, at each
+    // level of detail
+    const int g_LodSlices[MeshLibrary::LOD_COUNT] = { 36, 16, 8 };
+    // number of rings from pole to pole of the sphere, at
+    // each level of detail
+    const int g_LodSphereStacks[MeshLibrary::LOD_COUNT] = { 18, 8, 4 };
+    const float g_Pi = 3.14159265358979f;
+}
+
+/***********************************************************
+ *  MeshLibrary()
+ *
+ *  The constructor for the class.
+ ***********************************************************/
+MeshLibrary::MeshLibrary()
+{
+    m_vao = 0;
+    m_vertexBuffer = 0;
+    m_indexBuffer = 0;
+    m_planeMesh = MESH_INFO();
+    m_boxMesh = MESH_INFO();
+    for (int lod = 0; lod < LOD_COUNT; lod++)
+    {
+        m_cylinderMesh[lod] = MESH_INFO();
+        m_taperedCylinderMesh[lod] = MESH_INFO();
+        m_sphereMesh[lod] = MESH_INFO();
+    }
+    m_defaultInstanceBuffer = 0;
+    m_staticVao = 0;
+    m_staticVertexBuffer = 0;
+    m_staticIndexBuffer = 0;
+}
+
+/***********************************************************
+ *  ~MeshLibrary()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+MeshLibrary::~MeshLibrary()
+{
+    if (m_vao != 0)
+    {
+        GLStateCache::Get().ForgetVertexArray(m_vao);
+        glDeleteVertexArrays(1, &m_vao);
+        glDeleteBuffers(1, &m_vertexBuffer);
+        glDeleteBuffers(1, &m_indexBuffer);
+        glDeleteBuffers(1, &m_defaultInstanceBuffer);
+    }
+    if (m_staticVao != 0)
+    {
+        GLStateCache::Get().ForgetVertexArray(m_staticVao);
+        glDeleteVertexArrays(1, &m_staticVao);
+        glDeleteBuffers(1, &m_staticVertexBuffer);
+        glDeleteBuffers(1, &m_staticIndexBuffer);
+    }
+}
+
+/***********************************************************
+ *  AddMesh()
+ *
+ *  This method is called to append a mesh to the shared
+ *  vertex and index data.
+ ***********************************************************/
+MeshLibrary::MESH_INFO MeshLibrary::AddMesh(
+    const std::vector<VERTEX>& vertices,
+    const std::vector<GLuint>& indices)
+{
+    MESH_INFO mesh;
+    mesh.baseVertex = (GLint)m_vertices.size();
+    mesh.firstIndex = (GLuint)m_indices.size();
+    mesh.indexCount = (GLsizei)indices.size();
+
+    m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
+    m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+
+    return mesh;
+}
+
+/***********************************************************
+ *  LoadPlaneMesh()
+ *
+ *  This method is called to build a flat plane facing up,
+ *  spanning -1 to 1 on the x and z axes.
+ ***********************************************************/
+void MeshLibrary::LoadPlaneMesh()
+{
+    const float corners[4][2] = { { -1.0f, 1.0f }, { 1.0f, 1.0f }, { 1.0f, -1.0f }, { -1.0f, -1.0f } };
+
+    std::vector<VERTEX> vertices;
+    std::vector<GLuint> indices;
+
+    for (int corner = 0; corner < 4; corner++)
+    {
+        VERTEX vertex;
+        vertex.position = glm::vec3(corners[corner][0], 0.0f, corners[corner][1]);
+        vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        vertex.textureCoordinate = glm::vec2((corners[corner][0] + 1.0f) * 0.5f, (1.0f - corners[corner][1]) * 0.5f);
+        vertices.push_back(vertex);
+    }
+    indices.push_back(0);
+    indices.push_back(1);
+    indices.push_back(2);
+    indices.push_back(0);
+    indices.push_back(2);
+    indices.push_back(3);
+
+    m_planeMesh = AddMesh(vertices, indices);
+}
+
+/***********************************************************
+ *  LoadBoxMesh()
+ *
+ *  This method is called to build a unit box centered on
+ *  the origin, with one set of vertices per face.
+ ***********************************************************/
+void MeshLibrary::LoadBoxMesh()
+{
+    // normal, then the two axes spanning each face
+    const glm::vec3 faces[6][3] = {
+        { glm::vec3( 0.0f,  0.0f,  1.0f), glm::vec3(1.0f, 0.0f,  0.0f), glm::vec3(0.0f, 1.0f,  0.0f) },
+        { glm::vec3( 0.0f,  0.0f, -1.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f,  0.0f) },
+        { glm::vec3( 1.0f,  0.0f,  0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f,  0.0f) },
+        { glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, 0.0f,  1.0f), glm::vec3(0.0f, 1.0f,  0.0f) },
+        { glm::vec3( 0.0f,  1.0f,  0.0f), glm::vec3(1.0f, 0.0f,  0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+        { glm::vec3( 0.0f, -1.0f,  0.0f), glm::vec3(1.0f, 0.0f,  0.0f), glm::vec3(0.0f, 0.0f,  1.0f) }
+    };
+    const float corners[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+
+    std::vector<VERTEX> vertices;
+    std::vector<GLuint> indices;
+
+    for (int face = 0; face < 6; face++)
+    {
+        GLuint first = (GLuint)vertices.size();
+        for (int corner = 0; corner < 4; corner++)
+        {
+            VERTEX vertex;
+            vertex.position = faces[face][0] * 0.5f +
+                faces[face][1] * (corners[corner][0] - 0.5f) +
+                faces[face][2] * (corners[corner][1] - 0.5f);
+            vertex.normal = faces[face][0];
+            vertex.textureCoordinate = glm::vec2(corners[corner][0], corners[corner][1]);
+            vertices.push_back(vertex);
+        }
+        indices.push_back(first);
+        indices.push_back(first + 1);
+        indices.push_back(first + 2);
+        indices.push_back(first);
+        indices.push_back(first + 2);
+        indices.push_back(first + 3);
+    }
+
+    m_boxMesh = AddMesh(vertices, indices);
+}
+
+/***********************************************************
+ *  AddRoundMesh()
+ *
+ *  This method is called to build a cylinder standing from
+ *  y = 0 up to y = 1, with a radius of 1 at the bottom and
+ *  the given radius at the top, closed by both caps.
+ ***********************************************************/
+MeshLibrary::MESH_INFO MeshLibrary::AddRoundMesh(float topRadius, int slices)
+{
+    std::vector<VERTEX> vertices;
+    std::vector<GLuint> indices;
+
+    // the side leans in by the difference of the radii
+    // over a height of 1, which tilts its normals up
+    float slope = 1.0f - topRadius;
+
+    // side wall
+    for (int slice = 0; slice <= slices; slice++)
+    {
+        float u = (float)slice / slices;
+        float angle = u * 2.0f * g_Pi;
+        glm::vec3 direction(std::cos(angle), 0.0f, std::sin(angle));
+
+        VERTEX bottom;
+        bottom.position = direction;
+        bottom.normal = glm::normalize(glm::vec3(direction.x, slope, direction.z));
+        bottom.textureCoordinate = glm::vec2(u, 0.0f);
+
+        VERTEX top = bottom;
+        top.position = glm::vec3(direction.x * topRadius, 1.0f, direction.z * topRadius);
+        top.textureCoordinate.y = 1.0f;
+
+        vertices.push_back(bottom);
+        vertices.push_back(top);
+
+        if (slice < slices)
+        {
+            GLuint first = (GLuint)(slice * 2);
+            indices.push_back(first);
+            indices.push_back(first + 1);
+            indices.push_back(first + 3);
+            indices.push_back(first);
+            indices.push_back(first + 3);
+            indices.push_back(first + 2);
+        }
+    }
+
+    // bottom and top caps
+    for (int cap = 0; cap < 2; cap++)
+    {
+        float height = (float)cap;
+        float radius = (cap == 0) ? 1.0f : topRadius;
+        glm::vec3 normal(0.0f, (cap == 0) ? -1.0f : 1.0f, 0.0f);
+
+        GLuint center = (GLuint)vertices.size();
+        VERTEX centerVertex;
+        centerVertex.position = glm::vec3(0.0f, height, 0.0f);
+        centerVertex.normal = normal;
+        centerVertex.textureCoordinate = glm::vec2(0.5f, 0.5f);
+        vertices.push_back(centerVertex);
+
+        for (int slice = 0; slice <= slices; slice++)
+        {
+            float angle = (float)slice / slices * 2.0f * g_Pi;
+            VERTEX rim;
+            rim.position = glm::vec3(radius * std::cos(angle), height, radius * std::sin(angle));
+            rim.normal = normal;
+            rim.textureCoordinate = glm::vec2(0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::sin(angle));
+            vertices.push_back(rim);
+
+            if (slice < slices)
+            {
+                GLuint current = center + 1 + (GLuint)slice;
+                indices.push_back(center);
+                indices.push_back((cap == 0) ? current : current + 1);
+                indices.push_back((cap == 0) ? current + 1 : current);
+            }
+        }
+    }
+
+    return AddMesh(vertices, indices);
+}
+
+/***********************************************************
+ *  LoadCylinderMesh()
+ *
+ *  This method is called to build a unit cylinder with a
+ *  radius of 1, standing from y = 0 up to y = 1.
+ ***********************************************************/
+void MeshLibrary::LoadCylinderMesh()
+{
+    for (int lod = 0; lod < LOD_COUNT; lod++)
+    {
+        m_cylinderMesh[lod] = AddRoundMesh(1.0f, g_LodSlices[lod]);
+    }
+}
+
+/***********************************************************
+ *  LoadTaperedCylinderMesh()
+ *
+ *  This method is called to build a cylinder standing from
+ *  y = 0 up to y = 1, narrowing from a radius of 1 at the
+ *  bottom to 0.5 at the top.
+ ***********************************************************/
+void MeshLibrary::LoadTaperedCylinderMesh()
+{
+    for (int lod = 0; lod < LOD_COUNT; lod++)
+    {
+        m_taperedCylinderMesh[lod] = AddRoundMesh(0.5f, g_LodSlices[lod]);
+    }
+}
+
+/***********************************************************
+ *  AddSphereMesh()
+ *
+ *  This method is called to build a sphere with a radius
+ *  of 1, centered on the origin, from rings of slices.
+ ***********************************************************/
+MeshLibrary::MESH_INFO MeshLibrary::AddSphereMesh(int stacks, int slices)
+{
+    std::vector<VERTEX> vertices;
+    std::vector<GLuint> indices;
+
+    for (int stack = 0; stack <= stacks; stack++)
+    {
+        float v = (float)stack / stacks;
+        float polarAngle = v * g_Pi;
+
+        for (int slice = 0; slice <= slices; slice++)
+        {
+            float u = (float)slice / slices;
+            float angle = u * 2.0f * g_Pi;
+
+            VERTEX vertex;
+            vertex.position = glm::vec3(
+                std::sin(polarAngle) * std::cos(angle),
+                std::cos(polarAngle),
+                std::sin(polarAngle) * std::sin(angle));
+            vertex.normal = vertex.position;
+            vertex.textureCoordinate = glm::vec2(u, 1.0f - v);
+            vertices.push_back(vertex);
+
+            if ((stack < stacks) && (slice < slices))
+            {
+                GLuint first = (GLuint)(stack * (slices + 1) + slice);
+                GLuint below = first + slices + 1;
+                indices.push_back(first);
+                indices.push_back(first + 1);
+                indices.push_back(below + 1);
+                indices.push_back(first);
+                indices.push_back(below + 1);
+                indices.push_back(below);
+            }
+        }
+    }
+
+    return AddMesh(vertices, indices);
+}
+
+/***********************************************************
+ *  LoadSphereMesh()
+ *
+ *  This method is called to build a sphere with a radius
+ *  of 1, centered on the origin, at every level of detail.
+ ***********************************************************/
+void MeshLibrary::LoadSphereMesh()
+{
+    for (int lod = 0; lod < LOD_COUNT; lod++)
+    {
+        m_sphereMesh[lod] = AddSphereMesh(g_LodSphereStacks[lod], g_LodSlices[lod]);
+    }
+}
+
+/***********************************************************
+ *  UploadMeshes()
+ *
+ *  This method is called to copy the loaded meshes into the
+ *  GPU buffers and set up the vertex attributes.
+ ***********************************************************/
+void MeshLibrary::UploadMeshes()
+{
+    if (m_vao == 0)
+    {
+        glGenVertexArrays(1, &m_vao);
+        glGenBuffers(1, &m_vertexBuffer);
+        glGenBuffers(1, &m_indexBuffer);
+    }
+
+    GLStateCache::Get().BindVertexArray(m_vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(VERTEX), m_vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(GLuint), m_indices.data(), GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(g_PositionLocation);
+    glVertexAttribPointer(g_PositionLocation, 3, GL_FLOAT, GL_FALSE, sizeof(VERTEX), (void*)offsetof(VERTEX, position));
+    glEnableVertexAttribArray(g_NormalLocation);
+    glVertexAttribPointer(g_NormalLocation, 3, GL_FLOAT, GL_FALSE, sizeof(VERTEX), (void*)offsetof(VERTEX, normal));
+    glEnableVertexAttribArray(g_TextureCoordinateLocation);
+    glVertexAttribPointer(g_TextureCoordinateLocation, 2, GL_FLOAT, GL_FALSE, sizeof(VERTEX), (void*)offsetof(VERTEX, textureCoordinate));
+
+    // per-instance attributes advance once per instance; the buffer
+    // they read from is attached when each instanced draw is issued
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(g_InstanceModelLocation + column);
+        glVertexAttribDivisor(g_InstanceModelLocation + column, 1);
+    }
+    glEnableVertexAttribArray(g_InstanceColorLocation);
+    glVertexAttribDivisor(g_InstanceColorLocation, 1);
+    glEnableVertexAttribArray(g_InstanceMaterialLocation);
+    glVertexAttribDivisor(g_InstanceMaterialLocation, 1);
+
+    // until then they read a single identity instance, so draws
+    // that take their values from elsewhere, like the multi-draw
+    // path, never read from a missing buffer
+    if (m_defaultInstanceBuffer == 0)
+    {
+        std::vector<INSTANCE_DATA> instance(1);
+        instance[0].modelMatrix = glm::mat4(1.0f);
+        instance[0].color = glm::vec4(1.0f);
+        instance[0].materialIndex = 0;
+        m_defaultInstanceBuffer = CreateInstanceBuffer(instance);
+    }
+    BindInstanceAttributes(m_defaultInstanceBuffer, true);
+
+    GLStateCache::Get().BindVertexArray(0);
+}
+
+/***********************************************************
+ *  CreateInstanceBuffer()
+ *
+ *  This method is called to upload a set of per-instance
+ *  attributes for later instanced draws.
+ ***********************************************************/
+GLuint MeshLibrary::CreateInstanceBuffer(const std::vector<INSTANCE_DATA>& instances)
+{
+    GLuint instanceBuffer = 0;
+
+    glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(INSTANCE_DATA), instances.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return instanceBuffer;
+}
+
+/***********************************************************
+ *  DestroyInstanceBuffer()
+ *
+ *  This method is called to free a buffer of per-instance
+ *  attributes.
+ ***********************************************************/
+void MeshLibrary::DestroyInstanceBuffer(GLuint instanceBuffer)
+{
+    if (instanceBuffer != 0)
+    {
+        glDeleteBuffers(1, &instanceBuffer);
+    }
+}
+
+/***********************************************************
+ *  DrawMeshInstanced()
+ *
+ *  This method is called to draw a mesh once for every
+ *  entry in the instance buffer.
+ ***********************************************************/
+void MeshLibrary::DrawMeshInstanced(const MESH_INFO& mesh, GLsizei count, GLuint instanceBuffer)
+{
+    if ((m_vao == 0) || (count <= 0) || (mesh.indexCount == 0))
+    {
+        return;
+    }
+
+    GLStateCache::Get().BindVertexArray(m_vao);
+
+    BindInstanceAttributes(instanceBuffer, true);
+
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT,
+        (void*)(mesh.firstIndex * sizeof(GLuint)), count, mesh.baseVertex);
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method is called to draw one copy of a mesh. The
+ *  instance attributes are left as they are, since the
+ *  shader reads the uniforms instead.
+ ***********************************************************/
+void MeshLibrary::DrawMesh(const MESH_INFO& mesh)
+{
+    if ((m_vao == 0) || (mesh.indexCount == 0))
+    {
+        return;
+    }
+
+    GLStateCache::Get().BindVertexArray(m_vao);
+
+    glDrawElementsBaseVertex(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT,
+        (void*)(mesh.firstIndex * sizeof(GLuint)), mesh.baseVertex);
+}
+
+/***********************************************************
+ *  DrawBoxMeshInstanced()
+ *
+ *  This method is called to draw many copies of the box.
+ ***********************************************************/
+void MeshLibrary::DrawBoxMeshInstanced(GLsizei count, GLuint instanceBuffer)
+{
+    DrawMeshInstanced(m_boxMesh, count, instanceBuffer);
+}
+
+/***********************************************************
+ *  DrawCylinderMeshInstanced()
+ *
+ *  This method is called to draw many copies of the cylinder,
+ *  at one level of detail.
+ ***********************************************************/
+void MeshLibrary::DrawCylinderMeshInstanced(GLsizei count, GLuint instanceBuffer, int lod)
+{
+    DrawMeshInstanced(m_cylinderMesh[lod], count, instanceBuffer);
+}
+
+/***********************************************************
+ *  BindInstanceAttributes()
+ *
+ *  This method is called to point the per-instance vertex
+ *  attributes of the bound vertex array at an instance
+ *  buffer. The static batch keeps its material per vertex,
+ *  so it leaves the material attribute alone.
+ ***********************************************************/
+void MeshLibrary::BindInstanceAttributes(GLuint instanceBuffer, bool bWithMaterial)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glVertexAttribPointer(g_InstanceModelLocation + column, 4, GL_FLOAT, GL_FALSE, sizeof(INSTANCE_DATA),
+            (void*)(offsetof(INSTANCE_DATA, modelMatrix) + sizeof(glm::vec4) * column));
+    }
+    glVertexAttribPointer(g_InstanceColorLocation, 4, GL_FLOAT, GL_FALSE, sizeof(INSTANCE_DATA),
+        (void*)offsetof(INSTANCE_DATA, color));
+    if (bWithMaterial)
+    {
+        glVertexAttribIPointer(g_InstanceMaterialLocation, 1, GL_INT, sizeof(INSTANCE_DATA),
+            (void*)offsetof(INSTANCE_DATA, materialIndex));
+    }
+}
+
+/***********************************************************
+ *  ClearStaticBatch()
+ *
+ *  This method is called to remove every static group, so
+ *  the batch can be built again. The GPU buffers are kept
+ *  and refilled by the next upload.
+ ***********************************************************/
+void MeshLibrary::ClearStaticBatch()
+{
+    m_staticGroupVertices.clear();
+    m_staticGroupIndices.clear();
+    m_staticGroups.clear();
+}
+
+/***********************************************************
+ *  AddStaticGroup()
+ *
+ *  This method is called to start a new group of the static
+ *  batch. Each group is drawn with a single call.
+ ***********************************************************/
+int MeshLibrary::AddStaticGroup()
+{
+    m_staticGroupVertices.push_back(std::vector<STATIC_VERTEX>());
+    m_staticGroupIndices.push_back(std::vector<GLuint>());
+    m_staticGroups.push_back(MESH_INFO());
+
+    return (int)m_staticGroups.size() - 1;
+}
+
+/***********************************************************
+ *  AddStaticMesh()
+ *
+ *  This method is called to bake a copy of a loaded mesh
+ *  into a static group. Positions are moved into world
+ *  space and the UV scale is applied to the texture
+ *  coordinates. The normals are copied unchanged, since the
+ *  shaders light every mesh with its untransformed normals.
+ ***********************************************************/
+void MeshLibrary::AddStaticMesh(
+    const MESH_INFO& mesh,
+    int group,
+    const glm::mat4& modelMatrix,
+    const glm::vec2& uvScale,
+    GLint materialIndex)
+{
+    if ((group < 0) || (group >= (int)m_staticGroups.size()) || (mesh.indexCount == 0))
+    {
+        return;
+    }
+
+    std::vector<STATIC_VERTEX>& groupVertices = m_staticGroupVertices[group];
+    std::vector<GLuint>& groupIndices = m_staticGroupIndices[group];
+    GLuint firstVertex = (GLuint)groupVertices.size();
+
+    // the mesh's vertices are the ones between its base vertex
+    // and the next mesh, which its indices never reach past
+    GLuint vertexCount = 0;
+    for (GLsizei i = 0; i < mesh.indexCount; i++)
+    {
+        GLuint index = m_indices[mesh.firstIndex + i];
+        vertexCount = (index + 1 > vertexCount) ? index + 1 : vertexCount;
+    }
+
+    for (GLuint i = 0; i < vertexCount; i++)
+    {
+        const VERTEX& source = m_vertices[mesh.baseVertex + i];
+        STATIC_VERTEX vertex;
+        vertex.position = glm::vec3(modelMatrix * glm::vec4(source.position, 1.0f));
+        vertex.normal = source.normal;
+        vertex.textureCoordinate = source.textureCoordinate * uvScale;
+        vertex.materialIndex = materialIndex;
+        groupVertices.push_back(vertex);
+    }
+
+    for (GLsizei i = 0; i < mesh.indexCount; i++)
+    {
+        groupIndices.push_back(firstVertex + m_indices[mesh.firstIndex + i]);
+    }
+}
+
+/***********************************************************
+ *  AddStaticPlaneMesh()
+ *
+ *  This method is called to bake a plane into a group.
+ ***********************************************************/
+void MeshLibrary::AddStaticPlaneMesh(int group, const glm::mat4& modelMatrix, const glm::vec2& uvScale, GLint materialIndex)
+{
+    AddStaticMesh(m_planeMesh, group, modelMatrix, uvScale, materialIndex);
+}
+
+/***********************************************************
+ *  AddStaticBoxMesh()
+ *
+ *  This method is called to bake a box into a group.
+ ***********************************************************/
+void MeshLibrary::AddStaticBoxMesh(int group, const glm::mat4& modelMatrix, const glm::vec2& uvScale, GLint materialIndex)
+{
+    AddStaticMesh(m_boxMesh, group, modelMatrix, uvScale, materialIndex);
+}
+
+/***********************************************************
+ *  AddStaticCylinderMesh()
+ *
+ *  This method is called to bake a cylinder into a group.
+ ***********************************************************/
+void MeshLibrary::AddStaticCylinderMesh(int group, const glm::mat4& modelMatrix, const glm::vec2& uvScale, GLint materialIndex)
+{
+    AddStaticMesh(m_cylinderMesh[0], group, modelMatrix, uvScale, materialIndex);
+}
+
+/***********************************************************
+ *  UploadStaticBatch()
+ *
+ *  This method is called to copy every static group into
+ *  one vertex and one index buffer, one group after the
+ *  other, and set up the vertex attributes.
+ ***********************************************************/
+void MeshLibrary::UploadStaticBatch()
+{
+    std::vector<STATIC_VERTEX> vertices;
+    std::vector<GLuint> indices;
+
+    for (size_t group = 0; group < m_staticGroups.size(); group++)
+    {
+        m_staticGroups[group].baseVertex = (GLint)vertices.size();
+        m_staticGroups[group].firstIndex = (GLuint)indices.size();
+        m_staticGroups[group].indexCount = (GLsizei)m_staticGroupIndices[group].size();
+
+        vertices.insert(vertices.end(), m_staticGroupVertices[group].begin(), m_staticGroupVertices[group].end());
+        indices.insert(indices.end(), m_staticGroupIndices[group].begin(), m_staticGroupIndices[group].end());
+    }
+
+    // the baked data now lives on the GPU
+    m_staticGroupVertices.clear();
+    m_staticGroupIndices.clear();
+
+    if (vertices.empty())
+    {
+        return;
+    }
+
+    if (m_staticVao == 0)
+    {
+        glGenVertexArrays(1, &m_staticVao);
+        glGenBuffers(1, &m_staticVertexBuffer);
+        glGenBuffers(1, &m_staticIndexBuffer);
+    }
+
+    GLStateCache::Get().BindVertexArray(m_staticVao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_staticVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(STATIC_VERTEX), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_staticIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(g_PositionLocation);
+    glVertexAttribPointer(g_PositionLocation, 3, GL_FLOAT, GL_FALSE, sizeof(STATIC_VERTEX), (void*)offsetof(STATIC_VERTEX, position));
+    glEnableVertexAttribArray(g_NormalLocation);
+    glVertexAttribPointer(g_NormalLocation, 3, GL_FLOAT, GL_FALSE, sizeof(STATIC_VERTEX), (void*)offsetof(STATIC_VERTEX, normal));
+    glEnableVertexAttribArray(g_TextureCoordinateLocation);
+    glVertexAttribPointer(g_TextureCoordinateLocation, 2, GL_FLOAT, GL_FALSE, sizeof(STATIC_VERTEX), (void*)offsetof(STATIC_VERTEX, textureCoordinate));
+
+    // the material advances per vertex here, while the transform
+    // and color still come from a one-entry instance buffer
+    glEnableVertexAttribArray(g_InstanceMaterialLocation);
+    glVertexAttribIPointer(g_InstanceMaterialLocation, 1, GL_INT, sizeof(STATIC_VERTEX), (void*)offsetof(STATIC_VERTEX, materialIndex));
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(g_InstanceModelLocation + column);
+        glVertexAttribDivisor(g_InstanceModelLocation + column, 1);
+    }
+    glEnableVertexAttribArray(g_InstanceColorLocation);
+    glVertexAttribDivisor(g_InstanceColorLocation, 1);
+
+    GLStateCache::Get().BindVertexArray(0);
+}
+
+/***********************************************************
+ *  DrawStaticGroup()
+ *
+ *  This method is called to draw every mesh baked into a
+ *  static group with one call.
+ ***********************************************************/
+void MeshLibrary::DrawStaticGroup(int group, GLuint instanceBuffer)
+{
+    if ((m_staticVao == 0) || (group < 0) || (group >= (int)m_staticGroups.size()))
+    {
+        return;
+    }
+
+    const MESH_INFO& mesh = m_staticGroups[group];
+    if (mesh.indexCount == 0)
+    {
+        return;
+    }
+
+    GLStateCache::Get().BindVertexArray(m_staticVao);
+
+    BindInstanceAttributes(instanceBuffer, false);
+
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT,
+        (void*)(mesh.firstIndex * sizeof(GLuint)), 1, mesh.baseVertex);
+}
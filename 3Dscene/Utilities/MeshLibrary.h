@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshlibrary.h
+// ============
+// primitive meshes stored in shared GPU buffers, with support for
+// drawing many copies of a mesh in a single instanced draw call, and
+// for baking static meshes into world space batches
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class MeshLibrary
+{
+public:
+	// constructor
+	MeshLibrary();
+	// destructor
+	~MeshLibrary();
+
+	// vertex layout, matching the basic shape meshes
+	struct VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 textureCoordinate;
+	};
+
+	// per-instance vertex attributes
+	struct INSTANCE_DATA
+	{
+		glm::mat4 modelMatrix;
+		glm::vec4 color;
+		GLint materialIndex;
+	};
+
+	// vertex layout of the static batch, which carries the
+	// material of each vertex since one batch mixes materials
+	struct STATIC_VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 textureCoordinate;
+		GLint materialIndex;
+	};
+
+	// location of a mesh inside the shared buffers
+	struct MESH_INFO
+	{
+		GLint baseVertex;
+		GLuint firstIndex;
+		GLsizei indexCount;
+	};
+
+	// number of tessellation levels of the round meshes, from
+	// the full mesh at level 0 to the coarsest
+	static const int LOD_COUNT = 3;
+
+	// build the unit meshes, using the same dimensions
+	// as the basic shape meshes
+	void LoadPlaneMesh();
+	void LoadBoxMesh();
+	void LoadCylinderMesh();
+	void LoadTaperedCylinderMesh();
+	void LoadSphereMesh();
+
+	// where each mesh lives in the shared buffers, for
+	// callers that build their own draw commands; the round
+	// meshes take a tessellation level below LOD_COUNT
+	const MESH_INFO& GetPlaneMesh() const { return m_planeMesh; }
+	const MESH_INFO& GetBoxMesh() const { return m_boxMesh; }
+	const MESH_INFO& GetCylinderMesh(int lod = 0) const { return m_cylinderMesh[lod]; }
+	const MESH_INFO& GetTaperedCylinderMesh(int lod = 0) const { return m_taperedCylinderMesh[lod]; }
+	const MESH_INFO& GetSphereMesh(int lod = 0) const { return m_sphereMesh[lod]; }
+	// vertex array holding every mesh of the shared buffers
+	GLuint GetVertexArray() const { return m_vao; }
+
+	// copy the loaded meshes into the GPU buffers
+	void UploadMeshes();
+
+	// create and free buffers of per-instance attributes
+	GLuint CreateInstanceBuffer(const std::vector<INSTANCE_DATA>& instances);
+	void DestroyInstanceBuffer(GLuint instanceBuffer);
+
+	// draw one copy of a mesh, with the model matrix and the
+	// other per-object values taken from the shader uniforms
+	void DrawMesh(const MESH_INFO& mesh);
+	// draw many copies of a mesh in one call
+	void DrawBoxMeshInstanced(GLsizei count, GLuint instanceBuffer);
+	void DrawCylinderMeshInstanced(GLsizei count, GLuint instanceBuffer, int lod = 0);
+
+	// remove every group of the static batch
+	void ClearStaticBatch();
+	// start a new group of the static batch, returning its index
+	int AddStaticGroup();
+	// bake a copy of a mesh into a static group, in world space
+	void AddStaticPlaneMesh(int group, const glm::mat4& modelMatrix, const glm::vec2& uvScale, GLint materialIndex);
+	void AddStaticBoxMesh(int group, const glm::mat4& modelMatrix, const glm::vec2& uvScale, GLint materialIndex);
+	void AddStaticCylinderMesh(int group, const glm::mat4& modelMatrix, const glm::vec2& uvScale, GLint materialIndex);
+	// copy the static groups into their GPU buffers
+	void UploadStaticBatch();
+	// draw a whole static group in one call; the instance buffer
+	// holds a single identity transform and the group's color
+	void DrawStaticGroup(int group, GLuint instanceBuffer);
+
+private:
+	// vertex array and shared buffers
+	GLuint m_vao;
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+	// instance attributes read when no instance buffer is attached
+	GLuint m_defaultInstanceBuffer;
+
+	// mesh data waiting to be uploaded
+	std::vector<VERTEX> m_vertices;
+	std::vector<GLuint> m_indices;
+
+	MESH_INFO m_planeMesh;
+	MESH_INFO m_boxMesh;
+	MESH_INFO m_cylinderMesh[LOD_COUNT];
+	MESH_INFO m_taperedCylinderMesh[LOD_COUNT];
+	MESH_INFO m_sphereMesh[LOD_COUNT];
+
+	// static batch buffers, with one index range per group
+	GLuint m_staticVao;
+	GLuint m_staticVertexBuffer;
+	GLuint m_staticIndexBuffer;
+	std::vector< std::vector<STATIC_VERTEX> > m_staticGroupVertices;
+	std::vector< std::vector<GLuint> > m_staticGroupIndices;
+	std::vector<MESH_INFO> m_staticGroups;
+
+	// add a mesh to the shared vertex and index data
+	MESH_INFO AddMesh(const std::vector<VERTEX>& vertices, const std::vector<GLuint>& indices);
+	// build a cylinder, tapered when the top radius is below 1
+	MESH_INFO AddRoundMesh(float topRadius, int slices);
+	// build a sphere from rings of slices
+	MESH_INFO AddSphereMesh(int stacks, int slices);
+	// draw one of the meshes with per-instance attributes
+	void DrawMeshInstanced(const MESH_INFO& mesh, GLsizei count, GLuint instanceBuffer);
+	// attach an instance buffer to the instance attributes
+	void BindInstanceAttributes(GLuint instanceBuffer, bool bWithMaterial);
+	// bake a copy of a mesh into a static group
+	void AddStaticMesh(const MESH_INFO& mesh, int group, const glm::mat4& modelMatrix, const glm::vec2& uvScale, GLint materialIndex);
+};
@@ -0,0 +1,208 @@
+///////////////////////////////////////////////////////////////////////////////
+// multidrawlist.cpp
+// ============
+// indirect draw commands and per-draw values for the meshes of a
+// MeshLibrary, submitted many at a time with glMultiDrawElementsIndirect
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MultiDrawList.h"
+#include "GLStateCache.h"
+
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+    // smallest number of draws the GPU buffers are created for
+    const size_t g_MinimumCapacity = 64;
+}
+
+/***********************************************************
+ *  MultiDrawList()
+ *
+ *  The constructor for the class.
+ ***********************************************************/
+MultiDrawList::MultiDrawList()
+{
+    m_commandBuffer = 0;
+    m_drawDataBuffer = 0;
+    m_capacity = 0;
+    m_pRingBuffer = NULL;
+    m_uploadedCommandBuffer = 0;
+    m_uploadedDrawDataBuffer = 0;
+    m_commandOffset = 0;
+    m_drawDataOffset = 0;
+}
+
+/***********************************************************
+ *  ~MultiDrawList()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+MultiDrawList::~MultiDrawList()
+{
+    if (m_commandBuffer != 0)
+    {
+        glDeleteBuffers(1, &m_commandBuffer);
+        glDeleteBuffers(1, &m_drawDataBuffer);
+    }
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is called to remove the draws of the
+ *  previous frame. The GPU buffers are kept for reuse.
+ ***********************************************************/
+void MultiDrawList::Clear()
+{
+    m_commands.clear();
+    m_drawData.clear();
+}
+
+/***********************************************************
+ *  AddDraw()
+ *
+ *  This method is called to add one draw of a mesh from
+ *  the shared buffers, along with its per-draw values.
+ ***********************************************************/
+int MultiDrawList::AddDraw(const MeshLibrary::MESH_INFO& mesh, const DRAW_DATA& data)
+{
+    DRAW_COMMAND command;
+    command.count = (GLuint)mesh.indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = mesh.firstIndex;
+    command.baseVertex = mesh.baseVertex;
+    command.baseInstance = 0;
+
+    m_commands.push_back(command);
+    m_drawData.push_back(data);
+
+    return (int)m_commands.size() - 1;
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is called to copy the draws into the GPU
+ *  buffers, growing them when the list has outgrown them.
+ *  With a frame ring buffer, they are written straight into
+ *  mapped memory instead, and glBufferSubData() is only used
+ *  when the ring buffer is full.
+ ***********************************************************/
+void MultiDrawList::Upload()
+{
+    m_uploadedCommandBuffer = 0;
+    m_uploadedDrawDataBuffer = 0;
+
+    if (m_commands.empty())
+    {
+        return;
+    }
+
+    if (UploadToRingBuffer())
+    {
+        return;
+    }
+
+    if (m_commandBuffer == 0)
+    {
+        glGenBuffers(1, &m_commandBuffer);
+        glGenBuffers(1, &m_drawDataBuffer);
+    }
+
+    if (m_commands.size() > m_capacity)
+    {
+        m_capacity = (m_capacity < g_MinimumCapacity) ? g_MinimumCapacity : m_capacity;
+        while (m_capacity < m_commands.size())
+        {
+            m_capacity *= 2;
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, m_capacity * sizeof(DRAW_COMMAND), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawDataBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, m_capacity * sizeof(DRAW_DATA), NULL, GL_DYNAMIC_DRAW);
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, m_commands.size() * sizeof(DRAW_COMMAND), m_commands.data());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawDataBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_drawData.size() * sizeof(DRAW_DATA), m_drawData.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    m_uploadedCommandBuffer = m_commandBuffer;
+    m_uploadedDrawDataBuffer = m_drawDataBuffer;
+    m_commandOffset = 0;
+    m_drawDataOffset = 0;
+}
+
+/***********************************************************
+ *  UploadToRingBuffer()
+ *
+ *  This method is called to write the draws into the
+ *  current region of the frame ring buffer, returning false
+ *  when there is no ring buffer or it has no room left.
+ ***********************************************************/
+bool MultiDrawList::UploadToRingBuffer()
+{
+    if ((m_pRingBuffer == NULL) || !m_pRingBuffer->IsMapped())
+    {
+        return false;
+    }
+
+    size_t commandSize = m_commands.size() * sizeof(DRAW_COMMAND);
+    size_t drawDataSize = m_drawData.size() * sizeof(DRAW_DATA);
+    GLintptr commandOffset = 0;
+    GLintptr drawDataOffset = 0;
+
+    void* drawData = m_pRingBuffer->Allocate(drawDataSize, m_pRingBuffer->GetStorageAlignment(), drawDataOffset);
+    if (drawData == NULL)
+    {
+        return false;
+    }
+    // indirect commands only need to be four byte aligned
+    void* commands = m_pRingBuffer->Allocate(commandSize, sizeof(GLuint), commandOffset);
+    if (commands == NULL)
+    {
+        return false;
+    }
+
+    std::memcpy(drawData, m_drawData.data(), drawDataSize);
+    std::memcpy(commands, m_commands.data(), commandSize);
+
+    m_uploadedCommandBuffer = m_pRingBuffer->GetBuffer();
+    m_uploadedDrawDataBuffer = m_pRingBuffer->GetBuffer();
+    m_commandOffset = commandOffset;
+    m_drawDataOffset = drawDataOffset;
+    return true;
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method is called to submit a range of the uploaded
+ *  draws with a single glMultiDrawElementsIndirect call.
+ ***********************************************************/
+void MultiDrawList::Draw(GLuint vertexArray, int firstDraw, int drawCount)
+{
+    if ((m_uploadedCommandBuffer == 0) || (vertexArray == 0) || (drawCount <= 0) ||
+        (firstDraw < 0) || (firstDraw + drawCount > (int)m_commands.size()))
+    {
+        return;
+    }
+
+    GLStateCache::Get().BindVertexArray(vertexArray);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_uploadedCommandBuffer);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_uploadedDrawDataBuffer,
+        m_drawDataOffset, (GLsizeiptr)(m_drawData.size() * sizeof(DRAW_DATA)));
+
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+        (void*)(m_commandOffset + firstDraw * sizeof(DRAW_COMMAND)), drawCount, 0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
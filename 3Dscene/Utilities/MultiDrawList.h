@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// multidrawlist.h
+// ============
+// indirect draw commands and per-draw values for the meshes of a
+// MeshLibrary, submitted many at a time with glMultiDrawElementsIndirect
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshLibrary.h"
+#include "FrameRingBuffer.h"
+
+#include <GL/glew.h>        // GLEW library
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class MultiDrawList
+{
+public:
+	// constructor
+	MultiDrawList();
+	// destructor
+	~MultiDrawList();
+
+	// shader storage binding point of the per-draw values
+	static const GLuint DRAW_DATA_BINDING = 0;
+
+	// the layout glMultiDrawElementsIndirect reads
+	struct DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// bits of DRAW_DATA::flags
+	enum DRAW_FLAGS
+	{
+		DRAW_USE_TEXTURE = 1,
+		DRAW_USE_LIGHTING = 2
+	};
+
+	// values of one draw, following the std430 layout rules to
+	// mirror the DrawBlock storage block in vertexShader.glsl
+	struct DRAW_DATA
+	{
+		glm::mat4 modelMatrix;
+		glm::vec4 color;
+		glm::vec2 uvScale;
+		GLint materialIndex;
+		GLint textureLayer;
+		GLint flags;
+		float tintIntensity;
+		GLint padding[2];
+	};
+
+	// write the draws into a frame ring buffer instead of the
+	// list's own buffers, whenever it has room
+	void SetRingBuffer(FrameRingBuffer* pRingBuffer) { m_pRingBuffer = pRingBuffer; }
+
+	// remove the draws of the previous frame
+	void Clear();
+	// add a draw of a mesh, returning its index in the list
+	int AddDraw(const MeshLibrary::MESH_INFO& mesh, const DRAW_DATA& data);
+	// copy the draws into the GPU buffers
+	void Upload();
+	// submit a range of the uploaded draws with one call; the
+	// shader finds each draw's values at firstDraw + gl_DrawID
+	void Draw(GLuint vertexArray, int firstDraw, int drawCount);
+
+	int GetDrawCount() const { return (int)m_commands.size(); }
+
+private:
+	GLuint m_commandBuffer;
+	GLuint m_drawDataBuffer;
+	// number of draws the GPU buffers have room for
+	size_t m_capacity;
+
+	FrameRingBuffer* m_pRingBuffer;
+	// where the uploaded draws are, either in the list's own
+	// buffers at offset 0, or in the ring buffer
+	GLuint m_uploadedCommandBuffer;
+	GLuint m_uploadedDrawDataBuffer;
+	GLintptr m_commandOffset;
+	GLintptr m_drawDataOffset;
+
+	// write the draws into the frame ring buffer
+	bool UploadToRingBuffer();
+
+	std::vector<DRAW_COMMAND> m_commands;
+	std::vector<DRAW_DATA> m_drawData;
+};
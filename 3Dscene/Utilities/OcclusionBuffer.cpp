@@ -0,0 +1,379 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionbuffer.cpp
+// ============
+// a small depth buffer the large occluders of the scene are rasterized into
+// on the CPU, so objects hidden behind them can be skipped before they are
+// submitted to the GPU
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionBuffer.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// x64 always has SSE, see FrustumCuller.cpp
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define OCCLUSION_BUFFER_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+    // rows of the buffer filled by each job
+    const int g_RowsPerJob = 16;
+    // below this many triangles, splitting the rows into jobs
+    // costs more than it saves
+    const int g_ThreadedTriangles = 32;
+    // boxes with a corner this close to the camera plane are
+    // never treated as hidden
+    const float g_MinClipW = 0.0001f;
+
+    // corners of a box, indexed by bits x, y and z
+    glm::vec3 BoxCorner(const glm::vec3& boundsMin, const glm::vec3& boundsMax, int corner)
+    {
+        return glm::vec3(
+            (corner & 1) ? boundsMax.x : boundsMin.x,
+            (corner & 2) ? boundsMax.y : boundsMin.y,
+            (corner & 4) ? boundsMax.z : boundsMin.z);
+    }
+
+    // the twelve triangles of a box, as corner indices
+    const int g_BoxTriangles[12][3] =
+    {
+        { 0, 2, 3 }, { 0, 3, 1 },  // -z
+        { 4, 5, 7 }, { 4, 7, 6 },  // +z
+        { 0, 4, 6 }, { 0, 6, 2 },  // -x
+        { 1, 3, 7 }, { 1, 7, 5 },  // +x
+        { 0, 1, 5 }, { 0, 5, 4 },  // -y
+        { 2, 6, 7 }, { 2, 7, 3 }   // +y
+    };
+}
+
+// the sizes are passed by reference to std::min
+const int OcclusionBuffer::WIDTH;
+const int OcclusionBuffer::HEIGHT;
+
+/***********************************************************
+ *  OcclusionBuffer()
+ *
+ *  The constructor for the class.
+ ***********************************************************/
+OcclusionBuffer::OcclusionBuffer()
+{
+    m_depth.assign(WIDTH * HEIGHT, 1.0f);
+    m_viewProjection = glm::mat4(1.0f);
+}
+
+/***********************************************************
+ *  ~OcclusionBuffer()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+OcclusionBuffer::~OcclusionBuffer()
+{
+}
+
+/***********************************************************
+ *  ClearOccluders()
+ *
+ *  This method is called to forget every occluder, before
+ *  the occluders of a new frame are added.
+ ***********************************************************/
+void OcclusionBuffer::ClearOccluders()
+{
+    m_occluderCorners.clear();
+}
+
+/***********************************************************
+ *  AddOccluder()
+ *
+ *  This method is called to add a box to be rasterized as
+ *  an occluder. A box with no thickness, like a scaled
+ *  plane, still occludes from both sides.
+ ***********************************************************/
+void OcclusionBuffer::AddOccluder(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& modelMatrix)
+{
+    for (int corner = 0; corner < 8; corner++)
+    {
+        m_occluderCorners.push_back(glm::vec3(modelMatrix * glm::vec4(BoxCorner(localMin, localMax, corner), 1.0f)));
+    }
+}
+
+/***********************************************************
+ *  Render()
+ *
+ *  This method is called to rasterize the occluders. The
+ *  triangles are projected once, then the rows of the buffer
+ *  are split into bands that are filled by separate jobs,
+ *  so no two jobs write the same pixels.
+ ***********************************************************/
+void OcclusionBuffer::Render(const glm::mat4& viewProjection)
+{
+    m_viewProjection = viewProjection;
+    std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+
+    m_triangles.clear();
+    for (size_t box = 0; box + 8 <= m_occluderCorners.size(); box += 8)
+    {
+        glm::vec4 clip[8];
+        for (int corner = 0; corner < 8; corner++)
+        {
+            clip[corner] = viewProjection * glm::vec4(m_occluderCorners[box + corner], 1.0f);
+        }
+        for (int t = 0; t < 12; t++)
+        {
+            AddClipTriangle(clip[g_BoxTriangles[t][0]], clip[g_BoxTriangles[t][1]], clip[g_BoxTriangles[t][2]]);
+        }
+    }
+
+    if ((int)m_triangles.size() < g_ThreadedTriangles)
+    {
+        RasterizeRows(0, HEIGHT);
+        return;
+    }
+
+    JobSystem::Get().ParallelFor(HEIGHT, g_RowsPerJob, [this](size_t begin, size_t end)
+    {
+        RasterizeRows((int)begin, (int)end);
+    });
+}
+
+/***********************************************************
+ *  AddClipTriangle()
+ *
+ *  This method is called to clip a triangle against the
+ *  near plane and store what is left in pixels and depth.
+ *  The other planes need no clipping, since the rasterizer
+ *  only visits pixels inside the buffer.
+ ***********************************************************/
+void OcclusionBuffer::AddClipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c)
+{
+    const glm::vec4 input[3] = { a, b, c };
+    glm::vec4 clipped[4];
+    int clippedCount = 0;
+
+    // keep the part where z >= -w
+    for (int i = 0; i < 3; i++)
+    {
+        const glm::vec4& current = input[i];
+        const glm::vec4& next = input[(i + 1) % 3];
+        float currentDistance = current.z + current.w;
+        float nextDistance = next.z + next.w;
+
+        if (currentDistance >= 0.0f)
+        {
+            clipped[clippedCount++] = current;
+        }
+        if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+        {
+            float t = currentDistance / (currentDistance - nextDistance);
+            clipped[clippedCount++] = current + (next - current) * t;
+        }
+    }
+
+    if (clippedCount < 3)
+    {
+        return;
+    }
+
+    glm::vec3 screen[4];
+    for (int i = 0; i < clippedCount; i++)
+    {
+        float w = std::max(clipped[i].w, g_MinClipW);
+        screen[i] = glm::vec3(
+            (clipped[i].x / w * 0.5f + 0.5f) * WIDTH,
+            (clipped[i].y / w * 0.5f + 0.5f) * HEIGHT,
+            clipped[i].z / w * 0.5f + 0.5f);
+    }
+
+    // fan the clipped polygon into one or two triangles
+    for (int i = 1; i + 1 < clippedCount; i++)
+    {
+        SCREEN_TRIANGLE triangle;
+        triangle.v[0] = screen[0];
+        triangle.v[1] = screen[i];
+        triangle.v[2] = screen[i + 1];
+        m_triangles.push_back(triangle);
+    }
+}
+
+/***********************************************************
+ *  RasterizeRows()
+ *
+ *  This method is called to rasterize every triangle into
+ *  the rows firstRow up to endRow. Pixels are covered when
+ *  their centers are inside all three edges, and depth is
+ *  interpolated across the triangle as a plane in screen
+ *  space. Four pixels of a row are handled at once.
+ ***********************************************************/
+void OcclusionBuffer::RasterizeRows(int firstRow, int endRow)
+{
+    for (size_t t = 0; t < m_triangles.size(); t++)
+    {
+        glm::vec3 v0 = m_triangles[t].v[0];
+        glm::vec3 v1 = m_triangles[t].v[1];
+        glm::vec3 v2 = m_triangles[t].v[2];
+
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (std::fabs(area) < 1e-6f)
+        {
+            continue;
+        }
+        // both sides of an occluder are drawn, so wind every
+        // triangle the same way
+        if (area < 0.0f)
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        int minX = std::max(0, (int)std::floor(std::min(v0.x, std::min(v1.x, v2.x))));
+        int maxX = std::min(WIDTH - 1, (int)std::ceil(std::max(v0.x, std::max(v1.x, v2.x))));
+        int minY = std::max(firstRow, (int)std::floor(std::min(v0.y, std::min(v1.y, v2.y))));
+        int maxY = std::min(endRow - 1, (int)std::ceil(std::max(v0.y, std::max(v1.y, v2.y))));
+        if ((minX > maxX) || (minY > maxY))
+        {
+            continue;
+        }
+        // start on a group of four pixels
+        minX &= ~3;
+
+        // edge functions, written as e = a * x + b * y + c, and
+        // the depth plane, written the same way
+        float edgeA[3], edgeB[3], edgeC[3];
+        const glm::vec3* from[3] = { &v1, &v2, &v0 };
+        const glm::vec3* to[3] = { &v2, &v0, &v1 };
+        for (int e = 0; e < 3; e++)
+        {
+            edgeA[e] = from[e]->y - to[e]->y;
+            edgeB[e] = to[e]->x - from[e]->x;
+            edgeC[e] = from[e]->x * to[e]->y - from[e]->y * to[e]->x;
+            // moved in by half a pixel, so only pixels the triangle
+            // covers completely pass the test at their centers; a
+            // partly covered pixel could still show an object
+            edgeC[e] -= 0.5f * (std::fabs(edgeA[e]) + std::fabs(edgeB[e]));
+        }
+        float depthA = (edgeA[1] * (v1.z - v0.z) + edgeA[2] * (v2.z - v0.z)) / area;
+        float depthB = (edgeB[1] * (v1.z - v0.z) + edgeB[2] * (v2.z - v0.z)) / area;
+        // for the same reason, each pixel gets the farthest depth
+        // the triangle has anywhere in it rather than at its center
+        float depthC = v0.z - depthA * v0.x - depthB * v0.y + 0.5f * (std::fabs(depthA) + std::fabs(depthB));
+
+        for (int y = minY; y <= maxY; y++)
+        {
+            float centerY = y + 0.5f;
+            float* row = m_depth.data() + y * WIDTH;
+
+#if defined(OCCLUSION_BUFFER_SSE)
+            const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+            for (int x = minX; x <= maxX; x += 4)
+            {
+                __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                __m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+                for (int e = 0; e < 3; e++)
+                {
+                    __m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[e]), centerX),
+                        _mm_set1_ps(edgeB[e] * centerY + edgeC[e]));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, _mm_setzero_ps()));
+                }
+                if (_mm_movemask_ps(inside) == 0)
+                {
+                    continue;
+                }
+
+                __m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depthA), centerX),
+                    _mm_set1_ps(depthB * centerY + depthC));
+                __m128 current = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(current, depth);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+            }
+#else
+            for (int x = minX; x <= maxX; x++)
+            {
+                float centerX = x + 0.5f;
+                bool inside = true;
+                for (int e = 0; (e < 3) && inside; e++)
+                {
+                    inside = (edgeA[e] * centerX + edgeB[e] * centerY + edgeC[e]) >= 0.0f;
+                }
+                if (inside)
+                {
+                    row[x] = std::min(row[x], depthA * centerX + depthB * centerY + depthC);
+                }
+            }
+#endif
+        }
+    }
+}
+
+/***********************************************************
+ *  IsOccluded()
+ *
+ *  This method is called to test a world space box against
+ *  the buffer. The box's corners are projected, and the box
+ *  is hidden only if every pixel under their screen bounds
+ *  holds an occluder nearer than the box's nearest point.
+ ***********************************************************/
+bool OcclusionBuffer::IsOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+    glm::vec2 screenMin(FLT_MAX), screenMax(-FLT_MAX);
+    float nearestDepth = FLT_MAX;
+
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec4 clip = m_viewProjection * glm::vec4(BoxCorner(boundsMin, boundsMax, corner), 1.0f);
+        // a box reaching behind the camera covers too much of
+        // the screen to be worth testing
+        if (clip.w < g_MinClipW)
+        {
+            return false;
+        }
+
+        glm::vec2 screen(
+            (clip.x / clip.w * 0.5f + 0.5f) * WIDTH,
+            (clip.y / clip.w * 0.5f + 0.5f) * HEIGHT);
+        screenMin = glm::min(screenMin, screen);
+        screenMax = glm::max(screenMax, screen);
+        nearestDepth = std::min(nearestDepth, clip.z / clip.w * 0.5f + 0.5f);
+    }
+
+    int minX = std::max(0, (int)std::floor(screenMin.x));
+    int maxX = std::min(WIDTH - 1, (int)std::floor(screenMax.x));
+    int minY = std::max(0, (int)std::floor(screenMin.y));
+    int maxY = std::min(HEIGHT - 1, (int)std::floor(screenMax.y));
+    if ((minX > maxX) || (minY > maxY))
+    {
+        // off screen, which the frustum culling deals with
+        return false;
+    }
+
+    for (int y = minY; y <= maxY; y++)
+    {
+        const float* row = m_depth.data() + y * WIDTH;
+        int x = minX;
+
+#if defined(OCCLUSION_BUFFER_SSE)
+        __m128 boxDepth = _mm_set1_ps(nearestDepth);
+        for (; x + 3 <= maxX; x += 4)
+        {
+            if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)) != 0)
+            {
+                return false;
+            }
+        }
+#endif
+        for (; x <= maxX; x++)
+        {
+            if (row[x] >= nearestDepth)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionbuffer.h
+// ============
+// a small depth buffer the large occluders of the scene are rasterized into
+// on the CPU, so objects hidden behind them can be skipped before they are
+// submitted to the GPU
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class OcclusionBuffer
+{
+public:
+	// constructor
+	OcclusionBuffer();
+	// destructor
+	~OcclusionBuffer();
+
+	// size of the depth buffer; the width is a multiple of four
+	// so each row splits evenly into SIMD groups
+	static const int WIDTH = 256;
+	static const int HEIGHT = 128;
+
+	// forget the occluders of the last frame
+	void ClearOccluders();
+	// add a box, scaled, rotated and moved by a model matrix,
+	// to be rasterized as an occluder
+	void AddOccluder(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& modelMatrix);
+	int GetOccluderCount() const { return (int)m_occluderCorners.size() / 8; }
+
+	// rasterize the occluders as seen through a view projection
+	// matrix, which the following tests also use
+	void Render(const glm::mat4& viewProjection);
+	// whether a world space box is hidden behind the occluders
+	bool IsOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+	// read the depth of one pixel, from 0 at the near plane
+	// to 1 at the far plane
+	float GetDepth(int x, int y) const { return m_depth[y * WIDTH + x]; }
+
+private:
+	// occluder triangle after projection, in pixels and depth
+	struct SCREEN_TRIANGLE
+	{
+		glm::vec3 v[3];
+	};
+
+	// world space corners of every occluder box
+	std::vector<glm::vec3> m_occluderCorners;
+	// occluder triangles of the current frame
+	std::vector<SCREEN_TRIANGLE> m_triangles;
+	// nearest occluder depth of each pixel
+	std::vector<float> m_depth;
+	glm::mat4 m_viewProjection;
+
+	// project and clip one clip space triangle
+	void AddClipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+	// rasterize every triangle into a band of rows
+	void RasterizeRows(int firstRow, int endRow);
+};
@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+// pointshadowscheduler.cpp
+// ============
+// decides which faces of the point lights' cube shadow maps are rendered
+// each frame; only a fixed number are, picked by how far their light has
+// moved since they were drawn and how much of them the camera can see
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PointShadowScheduler.h"
+#include "FrustumCuller.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+    // direction each face looks in, and its up vector
+    const glm::vec3 g_FaceDirections[PointShadowScheduler::FACE_COUNT] =
+    {
+        glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+        glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+    };
+    const glm::vec3 g_FaceUps[PointShadowScheduler::FACE_COUNT] =
+    {
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+        glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+    };
+
+    // distance a light has to move before its faces are out of date
+    const float g_MoveThreshold = 0.001f;
+    // how out of date moved casters make a face, as a distance
+    // the light could have moved
+    const float g_CasterChangeWeight = 1.0f;
+    // how much more out of date a face gets for every frame
+    // it waits, so faces off screen are still drawn eventually
+    const float g_WaitWeight = 0.05f;
+    // importance of a face the camera can't see, against one it can
+    const float g_OffscreenWeight = 0.2f;
+}
+
+/***********************************************************
+ *  PointShadowScheduler()
+ *
+ *  The constructor for the class.
+ ***********************************************************/
+PointShadowScheduler::PointShadowScheduler()
+{
+}
+
+/***********************************************************
+ *  ~PointShadowScheduler()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+PointShadowScheduler::~PointShadowScheduler()
+{
+}
+
+/***********************************************************
+ *  Resize()
+ *
+ *  This method is called to set the number of lights. No
+ *  face of any light counts as rendered afterwards.
+ ***********************************************************/
+void PointShadowScheduler::Resize(int lightCount)
+{
+    FACE_STATE face;
+    face.renderedPosition = glm::vec3(0.0f);
+    face.bRendered = false;
+    face.bCastersChanged = false;
+    face.waitedFrames = 0;
+
+    m_faces.assign(lightCount * FACE_COUNT, face);
+}
+
+/***********************************************************
+ *  InvalidateAll()
+ *
+ *  This method is called when the shadow casters changed,
+ *  so every face has to be rendered again.
+ ***********************************************************/
+void PointShadowScheduler::InvalidateAll()
+{
+    for (size_t i = 0; i < m_faces.size(); i++)
+    {
+        m_faces[i].bCastersChanged = true;
+    }
+}
+
+/***********************************************************
+ *  Schedule()
+ *
+ *  This method is called once a frame to pick the faces to
+ *  render. Faces never rendered go first, so a light's
+ *  shadows show up as soon as possible; the others are
+ *  ranked by how far their light moved since they were
+ *  drawn, how long they have waited, and how much they
+ *  matter on screen, where nearer lights and faces facing
+ *  into the view count for more.
+ ***********************************************************/
+void PointShadowScheduler::Schedule(const glm::vec3* lightPositions, const bool* castsShadow,
+    const glm::mat4& viewProjection, const glm::vec3& viewPosition, float lightRange,
+    int budget, std::vector<FACE_UPDATE>& updates)
+{
+    updates.clear();
+    m_candidates.clear();
+    m_priorities.resize(m_faces.size());
+
+    glm::vec4 planes[6];
+    FrustumCuller::ExtractPlanes(viewProjection, planes);
+
+    for (size_t i = 0; i < m_faces.size(); i++)
+    {
+        int light = (int)i / FACE_COUNT;
+        int face = (int)i % FACE_COUNT;
+        FACE_STATE& state = m_faces[i];
+        if (!castsShadow[light])
+        {
+            continue;
+        }
+
+        glm::vec3 position = lightPositions[light];
+        float moved = glm::length(position - state.renderedPosition);
+        if (state.bRendered && !state.bCastersChanged && (moved < g_MoveThreshold))
+        {
+            state.waitedFrames = 0;
+            continue;
+        }
+
+        float priority = FLT_MAX;
+        if (state.bRendered)
+        {
+            float staleness = moved + g_WaitWeight * (float)state.waitedFrames;
+            if (state.bCastersChanged)
+            {
+                staleness += g_CasterChangeWeight;
+            }
+
+            // a sphere in front of the face stands in for its
+            // frustum when testing whether the camera sees it
+            glm::vec3 center = position + g_FaceDirections[face] * (lightRange * 0.5f);
+            float radius = lightRange * 0.5f;
+            bool bOnScreen = true;
+            for (int plane = 0; plane < 6; plane++)
+            {
+                // the extracted planes aren't normalized
+                glm::vec3 normal = glm::vec3(planes[plane]);
+                if (glm::dot(normal, center) + planes[plane].w < -radius * glm::length(normal))
+                {
+                    bOnScreen = false;
+                    break;
+                }
+            }
+
+            float distanceWeight = lightRange / (lightRange + glm::length(position - viewPosition));
+            priority = staleness * distanceWeight * (bOnScreen ? 1.0f : g_OffscreenWeight);
+        }
+
+        m_priorities[i] = priority;
+        m_candidates.push_back((int)i);
+    }
+
+    size_t pickCount = std::min(m_candidates.size(), (size_t)std::max(budget, 0));
+    std::partial_sort(m_candidates.begin(), m_candidates.begin() + pickCount, m_candidates.end(),
+        [this](int a, int b) { return m_priorities[a] > m_priorities[b]; });
+
+    for (size_t i = 0; i < m_candidates.size(); i++)
+    {
+        int index = m_candidates[i];
+        if (i >= pickCount)
+        {
+            m_faces[index].waitedFrames++;
+            continue;
+        }
+
+        FACE_UPDATE update;
+        update.light = index / FACE_COUNT;
+        update.face = index % FACE_COUNT;
+        update.position = lightPositions[update.light];
+        updates.push_back(update);
+    }
+}
+
+/***********************************************************
+ *  MarkRendered()
+ *
+ *  This method is called once a picked face was rendered
+ *  with the light where it was for the frame.
+ ***********************************************************/
+void PointShadowScheduler::MarkRendered(const FACE_UPDATE& update)
+{
+    FACE_STATE& state = m_faces[update.light * FACE_COUNT + update.face];
+    state.renderedPosition = update.position;
+    state.bRendered = true;
+    state.bCastersChanged = false;
+    state.waitedFrames = 0;
+}
+
+/***********************************************************
+ *  IsLightReady()
+ *
+ *  This method is called to find out whether every face of
+ *  a light has been rendered at least once.
+ ***********************************************************/
+bool PointShadowScheduler::IsLightReady(int light) const
+{
+    for (int face = 0; face < FACE_COUNT; face++)
+    {
+        if (!m_faces[light * FACE_COUNT + face].bRendered)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/***********************************************************
+ *  GetFaceMatrix()
+ *
+ *  This method is called to build the view and projection
+ *  of one face: a square 90 degree frustum looking along
+ *  the face's axis, so the six faces together see all
+ *  around the light.
+ ***********************************************************/
+glm::mat4 PointShadowScheduler::GetFaceMatrix(const glm::vec3& position, int face, float nearPlane, float farPlane)
+{
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, nearPlane, farPlane);
+    glm::mat4 view = glm::lookAt(position, position + g_FaceDirections[face], g_FaceUps[face]);
+    return projection * view;
+}
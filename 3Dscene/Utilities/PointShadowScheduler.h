@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// pointshadowscheduler.h
+// ============
+// decides which faces of the point lights' cube shadow maps are rendered
+// each frame; only a fixed number are, picked by how far their light has
+// moved since they were drawn and how much of them the camera can see
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class PointShadowScheduler
+{
+public:
+	// constructor
+	PointShadowScheduler();
+	// destructor
+	~PointShadowScheduler();
+
+	// faces of each light's cube, in the order +X, -X, +Y, -Y, +Z, -Z
+	static const int FACE_COUNT = 6;
+
+	// a face picked to be rendered this frame
+	struct FACE_UPDATE
+	{
+		int light;
+		int face;
+		// where the light is for this frame
+		glm::vec3 position;
+	};
+
+	// set the number of lights, forgetting every rendered face
+	void Resize(int lightCount);
+	// mark every face out of date, such as when a caster moved
+	void InvalidateAll();
+
+	// pick at most budget out of date faces of the lights that
+	// cast shadows, most important first; the faces that are
+	// not picked wait for a later frame
+	void Schedule(const glm::vec3* lightPositions, const bool* castsShadow,
+		const glm::mat4& viewProjection, const glm::vec3& viewPosition, float lightRange,
+		int budget, std::vector<FACE_UPDATE>& updates);
+	// record that a picked face has been rendered
+	void MarkRendered(const FACE_UPDATE& update);
+
+	// whether every face of a light has been rendered, so its
+	// shadows can be sampled
+	bool IsLightReady(int light) const;
+
+	// view and projection of one face of a light at a position
+	static glm::mat4 GetFaceMatrix(const glm::vec3& position, int face, float nearPlane, float farPlane);
+
+private:
+	struct FACE_STATE
+	{
+		// where the light was when the face was rendered
+		glm::vec3 renderedPosition;
+		bool bRendered;
+		// set when the casters changed since it was rendered
+		bool bCastersChanged;
+		// frames the face has waited while out of date
+		int waitedFrames;
+	};
+
+	// every face of every light, six per light
+	std::vector<FACE_STATE> m_faces;
+	// out of date faces of the frame being scheduled, and
+	// how important each one is
+	std::vector<int> m_candidates;
+	std::vector<float> m_priorities;
+};
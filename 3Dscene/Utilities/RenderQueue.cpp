@@ -0,0 +1,277 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.cpp
+// ============
+// collects the draws for a frame as packets with a 64-bit sort key, and
+// orders them so that draws sharing the same state are submitted together
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderQueue.h"
+
+#include <cstddef>
+
+namespace
+{
+    // sort key layout, from the most significant bit down
+    //
+    //  63 - 61  pass
+    //  60       transparency
+    //  opaque draws:
+    //  59 - 57  depth slab, front to back
+    //  56 - 53  program
+    //  52 - 45  texture
+    //  44 - 37  material
+    //  36 - 33  mesh
+    //  23 - 0   depth, front to back
+    //  transparent draws:
+    //  59 - 36  depth, back to front
+    //  35 - 12  program, texture, material and mesh
+    const int g_PassShift = 61;
+    const int g_TransparentShift = 60;
+    const int g_SlabShift = 57;
+    const int g_ProgramShift = 53;
+    const int g_TextureShift = 45;
+    const int g_MaterialShift = 37;
+    const int g_MeshShift = 33;
+    const int g_TransparentDepthShift = 36;
+    const int g_TransparentStateShift = 12;
+
+    const uint64_t g_ProgramMask = 0xF;
+    const uint64_t g_TextureMask = 0xFF;
+    const uint64_t g_MaterialMask = 0xFF;
+    const uint64_t g_MeshMask = 0xF;
+    const uint64_t g_DepthMask = 0xFFFFFF;
+    // opaque draws are sorted by state within each of a few
+    // slabs of depth, so the nearest draws still go first and
+    // fill the depth buffer for the ones behind them
+    const int g_SlabBits = 3;
+
+    // bits sorted by each pass of the radix sort
+    const int g_RadixBits = 8;
+    const int g_RadixBuckets = 1 << g_RadixBits;
+}
+
+/***********************************************************
+ *  RenderQueue()
+ *
+ *  The constructor for the class.
+ ***********************************************************/
+RenderQueue::RenderQueue()
+{
+    m_unsortedStateChanges = 0;
+    m_sortedStateChanges = 0;
+    for (int pass = 0; pass <= PASS_COUNT; pass++)
+    {
+        m_passBegin[pass] = 0;
+    }
+}
+
+/***********************************************************
+ *  ~RenderQueue()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+RenderQueue::~RenderQueue()
+{
+    m_packets.clear();
+    m_sortBuffer.clear();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  Removes the packets of the previous frame. The storage
+ *  is kept so later frames don't allocate.
+ ***********************************************************/
+void RenderQueue::Clear()
+{
+    m_packets.clear();
+    m_unsortedStateChanges = 0;
+    m_sortedStateChanges = 0;
+    for (int pass = 0; pass <= PASS_COUNT; pass++)
+    {
+        m_passBegin[pass] = 0;
+    }
+}
+
+/***********************************************************
+ *  AddPacket()
+ *
+ *  Adds one draw to the queue.
+ ***********************************************************/
+void RenderQueue::AddPacket(RENDER_PASS pass, bool bTransparent, const DRAW_STATE& state,
+    float depth, unsigned int objectIndex)
+{
+    m_packets.push_back(MakePacket(pass, bTransparent, state, depth, objectIndex));
+}
+
+/***********************************************************
+ *  MakePacket()
+ *
+ *  Builds the packet of one draw, sort key included. It
+ *  only touches its arguments, so any thread can call it.
+ ***********************************************************/
+RenderQueue::DRAW_PACKET RenderQueue::MakePacket(RENDER_PASS pass, bool bTransparent, const DRAW_STATE& state,
+    float depth, unsigned int objectIndex)
+{
+    DRAW_PACKET packet;
+    packet.key = MakeKey(pass, bTransparent, state, depth);
+    packet.pass = pass;
+    packet.state = state;
+    packet.objectIndex = objectIndex;
+    packet.bTransparent = bTransparent;
+    return packet;
+}
+
+/***********************************************************
+ *  AddPackets()
+ *
+ *  Adds packets built ahead of time, in the order given.
+ ***********************************************************/
+void RenderQueue::AddPackets(const std::vector<DRAW_PACKET>& packets)
+{
+    m_packets.insert(m_packets.end(), packets.begin(), packets.end());
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  Packs the pass, transparency, state and depth of a draw
+ *  into a key. Opaque draws are sorted front to back by
+ *  slab, grouped by state within a slab and then sorted
+ *  front to back, while transparent draws have to be sorted
+ *  back to front before anything else.
+ ***********************************************************/
+uint64_t RenderQueue::MakeKey(RENDER_PASS pass, bool bTransparent, const DRAW_STATE& state, float depth)
+{
+    if (depth < 0.0f)
+    {
+        depth = 0.0f;
+    }
+    if (depth > 1.0f)
+    {
+        depth = 1.0f;
+    }
+    uint64_t depthBits = (uint64_t)(depth * (float)g_DepthMask) & g_DepthMask;
+
+    uint64_t stateBits =
+        ((state.program & g_ProgramMask) << (g_ProgramShift - g_MeshShift)) |
+        ((state.texture & g_TextureMask) << (g_TextureShift - g_MeshShift)) |
+        ((state.material & g_MaterialMask) << (g_MaterialShift - g_MeshShift)) |
+        (state.mesh & g_MeshMask);
+
+    uint64_t key = ((uint64_t)pass << g_PassShift);
+    if (bTransparent)
+    {
+        key |= ((uint64_t)1 << g_TransparentShift);
+        key |= ((g_DepthMask - depthBits) << g_TransparentDepthShift);
+        key |= (stateBits << g_TransparentStateShift);
+    }
+    else
+    {
+        key |= ((depthBits >> (24 - g_SlabBits)) << g_SlabShift);
+        key |= (stateBits << g_MeshShift);
+        key |= depthBits;
+    }
+
+    return key;
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  Orders the packets with a least significant digit radix
+ *  sort, eight bits at a time. Passes where every key has
+ *  the same digit are skipped, which is most of them since
+ *  only a few of the key bits are in use.
+ ***********************************************************/
+void RenderQueue::Sort()
+{
+    m_unsortedStateChanges = CountStateChanges(m_packets);
+
+    size_t count = m_packets.size();
+    m_sortBuffer.resize(count);
+
+    for (int shift = 0; shift < 64; shift += g_RadixBits)
+    {
+        size_t offsets[g_RadixBuckets] = { 0 };
+        for (size_t i = 0; i < count; i++)
+        {
+            offsets[(m_packets[i].key >> shift) & (g_RadixBuckets - 1)]++;
+        }
+
+        // every packet falls in the same bucket, so this
+        // pass wouldn't change the order
+        bool bSingleBucket = false;
+        for (int bucket = 0; bucket < g_RadixBuckets; bucket++)
+        {
+            if (offsets[bucket] == count)
+            {
+                bSingleBucket = true;
+                break;
+            }
+        }
+        if (bSingleBucket)
+        {
+            continue;
+        }
+
+        size_t total = 0;
+        for (int bucket = 0; bucket < g_RadixBuckets; bucket++)
+        {
+            size_t bucketCount = offsets[bucket];
+            offsets[bucket] = total;
+            total += bucketCount;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t bucket = (m_packets[i].key >> shift) & (g_RadixBuckets - 1);
+            m_sortBuffer[offsets[bucket]++] = m_packets[i];
+        }
+        m_packets.swap(m_sortBuffer);
+    }
+
+    m_sortedStateChanges = CountStateChanges(m_packets);
+
+    size_t packet = 0;
+    for (int pass = 0; pass < PASS_COUNT; pass++)
+    {
+        m_passBegin[pass] = packet;
+        while ((packet < count) && (m_packets[packet].pass == pass))
+        {
+            packet++;
+        }
+    }
+    m_passBegin[PASS_COUNT] = count;
+}
+
+/***********************************************************
+ *  CountStateChanges()
+ *
+ *  Counts how many program, texture, material and mesh
+ *  changes submitting the packets in this order needs.
+ ***********************************************************/
+int RenderQueue::CountStateChanges(const std::vector<DRAW_PACKET>& packets)
+{
+    int changes = 0;
+
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        const DRAW_STATE& state = packets[i].state;
+        if (i == 0)
+        {
+            changes += 4;
+            continue;
+        }
+
+        const DRAW_STATE& previous = packets[i - 1].state;
+        changes += (state.program != previous.program) ? 1 : 0;
+        changes += (state.texture != previous.texture) ? 1 : 0;
+        changes += (state.material != previous.material) ? 1 : 0;
+        changes += (state.mesh != previous.mesh) ? 1 : 0;
+    }
+
+    return changes;
+}
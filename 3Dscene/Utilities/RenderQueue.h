@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.h
+// ============
+// collects the draws for a frame as packets with a 64-bit sort key, and
+// orders them so that draws sharing the same state are submitted together
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class RenderQueue
+{
+public:
+	// constructor
+	RenderQueue();
+	// destructor
+	~RenderQueue();
+
+	// most views the shadow pass is drawn from in one frame,
+	// such as the cascades of a shadow map
+	static const int MAX_SHADOW_VIEWS = 4;
+
+	// the pass a draw belongs to, in submission order; every
+	// shadow view has a pass of its own, PASS_SHADOW + view
+	enum RENDER_PASS
+	{
+		PASS_SHADOW = 0,
+		PASS_MAIN = PASS_SHADOW + MAX_SHADOW_VIEWS,
+		PASS_COUNT
+	};
+
+	// the state a draw needs bound before it is submitted
+	struct DRAW_STATE
+	{
+		unsigned int program;
+		unsigned int texture;
+		unsigned int material;
+		unsigned int mesh;
+	};
+
+	// one draw, referring back to the caller's object list
+	struct DRAW_PACKET
+	{
+		uint64_t key;
+		RENDER_PASS pass;
+		DRAW_STATE state;
+		unsigned int objectIndex;
+		// drawn blended, after every opaque draw of its pass
+		bool bTransparent;
+	};
+
+	// remove the packets of the previous frame
+	void Clear();
+	// add a draw; depth is the normalized 0 - 1 distance to the viewer
+	void AddPacket(RENDER_PASS pass, bool bTransparent, const DRAW_STATE& state,
+		float depth, unsigned int objectIndex);
+	// build a packet without adding it, so packets can be built
+	// on several threads into buffers of their own
+	static DRAW_PACKET MakePacket(RENDER_PASS pass, bool bTransparent, const DRAW_STATE& state,
+		float depth, unsigned int objectIndex);
+	// add packets built with MakePacket()
+	void AddPackets(const std::vector<DRAW_PACKET>& packets);
+	// order the packets by their sort keys
+	void Sort();
+
+	// the packets, in sorted order once Sort() has been called
+	const std::vector<DRAW_PACKET>& GetPackets() const { return m_packets; }
+	// the sorted packets of one pass, which are consecutive since
+	// the pass is the top of the key
+	size_t GetPassBegin(RENDER_PASS pass) const { return m_passBegin[pass]; }
+	size_t GetPassEnd(RENDER_PASS pass) const { return m_passBegin[pass + 1]; }
+
+	// state changes needed in the order the packets were added,
+	// and in the sorted order
+	int GetUnsortedStateChanges() const { return m_unsortedStateChanges; }
+	int GetSortedStateChanges() const { return m_sortedStateChanges; }
+	int GetStateChangesSaved() const { return m_unsortedStateChanges - m_sortedStateChanges; }
+
+private:
+	std::vector<DRAW_PACKET> m_packets;
+	// scratch space for the radix sort
+	std::vector<DRAW_PACKET> m_sortBuffer;
+
+	int m_unsortedStateChanges;
+	int m_sortedStateChanges;
+	// index of the first sorted packet of each pass, followed
+	// by the packet count
+	size_t m_passBegin[PASS_COUNT + 1];
+
+	// build the sort key for one draw
+	static uint64_t MakeKey(RENDER_PASS pass, bool bTransparent, const DRAW_STATE& state, float depth);
+	// count the state changes between consecutive packets
+	static int CountStateChanges(const std::vector<DRAW_PACKET>& packets);
+};
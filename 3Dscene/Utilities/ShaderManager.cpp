@@ -23,17 +23,55 @@ using namespace std;
 
 #include "ShaderManager.h"
 
+namespace
+{
+    // insert lines of code right after the #version line, so
+    // that defines from the application reach the shader; a
+    // preamble starting with its own #version line replaces the
+    // shader's one, to build a variant for a newer context
+    void InsertPreamble(std::string& shaderCode, const char* preamble)
+    {
+        if ((preamble == NULL) || (*preamble == '\0'))
+        {
+            return;
+        }
+
+        size_t insertAt = 0;
+        if (shaderCode.compare(0, 8, "#version") == 0)
+        {
+            insertAt = shaderCode.find('\n');
+            insertAt = (insertAt == std::string::npos) ? shaderCode.size() : insertAt + 1;
+            if (strncmp(preamble, "#version", 8) == 0)
+            {
+                shaderCode.erase(0, insertAt);
+                insertAt = 0;
+            }
+        }
+        shaderCode.insert(insertAt, preamble);
+    }
+}
+
 /***********************************************************
  *  LoadShaders()
  *
  *  This method is called to load the shader data from 
- *  external GLSL compatible files.
+ *  external GLSL compatible files. The fragment shader
+ *  path may be NULL for a vertex-only (depth) program,
+ *  the optional geometry shader sits between the two,
+ *  and the optional preamble is added to every shader.
  ***********************************************************/
-GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fragment_file_path,const char * preamble,const char * geometry_file_path){
 
     // Create the shaders
     GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-    GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+    GLuint FragmentShaderID = 0;
+    if (fragment_file_path != NULL){
+        FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+    }
+    GLuint GeometryShaderID = 0;
+    if (geometry_file_path != NULL){
+        GeometryShaderID = glCreateShader(GL_GEOMETRY_SHADER);
+    }
 
     // Read the Vertex Shader code from the file
     std::string VertexShaderCode;
@@ -51,14 +89,32 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 
     // Read the Fragment Shader code from the file
     std::string FragmentShaderCode;
-    std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-    if(FragmentShaderStream.is_open()){
-        std::stringstream sstr;
-        sstr << FragmentShaderStream.rdbuf();
-        FragmentShaderCode = sstr.str();
-        FragmentShaderStream.close();
+    if (fragment_file_path != NULL){
+        std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
+        if(FragmentShaderStream.is_open()){
+            std::stringstream sstr;
+            sstr << FragmentShaderStream.rdbuf();
+            FragmentShaderCode = sstr.str();
+            FragmentShaderStream.close();
+        }
     }
 
+    // Read the Geometry Shader code from the file
+    std::string GeometryShaderCode;
+    if (geometry_file_path != NULL){
+        std::ifstream GeometryShaderStream(geometry_file_path, std::ios::in);
+        if(GeometryShaderStream.is_open()){
+            std::stringstream sstr;
+            sstr << GeometryShaderStream.rdbuf();
+            GeometryShaderCode = sstr.str();
+            GeometryShaderStream.close();
+        }
+    }
+
+    InsertPreamble(VertexShaderCode, preamble);
+    InsertPreamble(FragmentShaderCode, preamble);
+    InsertPreamble(GeometryShaderCode, preamble);
+
     GLint Result = GL_FALSE;
     int InfoLogLength;
 
@@ -79,29 +135,55 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 
     printf("success\n");
 
-    // Compile Fragment Shader
-    printf("Compiling shader : %s...", fragment_file_path);
-    char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-    glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-    glCompileShader(FragmentShaderID);
+    if (FragmentShaderID != 0){
+        // Compile Fragment Shader
+        printf("Compiling shader : %s...", fragment_file_path);
+        char const * FragmentSourcePointer = FragmentShaderCode.c_str();
+        glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
+        glCompileShader(FragmentShaderID);
 
-    // Check Fragment Shader
-    glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-    glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-    if ( InfoLogLength > 0 ){
-        std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
-        glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-        printf("\n%s\n", &FragmentShaderErrorMessage[0]);
+        // Check Fragment Shader
+        glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
+        glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+        if ( InfoLogLength > 0 ){
+            std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
+            glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
+            printf("\n%s\n", &FragmentShaderErrorMessage[0]);
+        }
+
+        printf("success\n");
     }
 
-    printf("success\n");
+    if (GeometryShaderID != 0){
+        // Compile Geometry Shader
+        printf("Compiling shader : %s...", geometry_file_path);
+        char const * GeometrySourcePointer = GeometryShaderCode.c_str();
+        glShaderSource(GeometryShaderID, 1, &GeometrySourcePointer , NULL);
+        glCompileShader(GeometryShaderID);
+
+        // Check Geometry Shader
+        glGetShaderiv(GeometryShaderID, GL_COMPILE_STATUS, &Result);
+        glGetShaderiv(GeometryShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+        if ( InfoLogLength > 0 ){
+            std::vector<char> GeometryShaderErrorMessage(InfoLogLength+1);
+            glGetShaderInfoLog(GeometryShaderID, InfoLogLength, NULL, &GeometryShaderErrorMessage[0]);
+            printf("\n%s\n", &GeometryShaderErrorMessage[0]);
+        }
+
+        printf("success\n");
+    }
 
     // Link the program
     printf("Linking shader program...");
     GLuint ProgramID = glCreateProgram();
     m_programID = ProgramID; // Store the program ID in the class
     glAttachShader(ProgramID, VertexShaderID);
-    glAttachShader(ProgramID, FragmentShaderID);
+    if (FragmentShaderID != 0){
+        glAttachShader(ProgramID, FragmentShaderID);
+    }
+    if (GeometryShaderID != 0){
+        glAttachShader(ProgramID, GeometryShaderID);
+    }
     glLinkProgram(ProgramID);
 
     // Check the program
@@ -114,12 +196,163 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
     }
 
     printf("success\n");
+
+    // look up every active uniform once, instead of on every set call
+    ReflectUniforms(ProgramID);
     
     glDetachShader(ProgramID, VertexShaderID);
-    glDetachShader(ProgramID, FragmentShaderID);
+    if (FragmentShaderID != 0){
+        glDetachShader(ProgramID, FragmentShaderID);
+    }
+    if (GeometryShaderID != 0){
+        glDetachShader(ProgramID, GeometryShaderID);
+    }
     
     glDeleteShader(VertexShaderID);
-    glDeleteShader(FragmentShaderID);
+    if (FragmentShaderID != 0){
+        glDeleteShader(FragmentShaderID);
+    }
+    if (GeometryShaderID != 0){
+        glDeleteShader(GeometryShaderID);
+    }
 
     return ProgramID;
 }
+
+/***********************************************************
+ *  setUniformBlockBinding()
+ *
+ *  This method is called to attach a uniform block of the
+ *  program to a buffer binding point. The size of the block
+ *  is returned so the caller can check it against its own
+ *  copy of the layout, or -1 if the block is not active.
+ ***********************************************************/
+GLint ShaderManager::setUniformBlockBinding(const char* name, GLuint bindingPoint) const
+{
+    GLuint blockIndex = glGetUniformBlockIndex(m_programID, name);
+    if (blockIndex == GL_INVALID_INDEX)
+    {
+        return(-1);
+    }
+
+    glUniformBlockBinding(m_programID, blockIndex, bindingPoint);
+
+    GLint blockSize = 0;
+    glGetActiveUniformBlockiv(m_programID, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+    return(blockSize);
+}
+
+namespace
+{
+    // FNV-1a hash of a uniform name
+    unsigned int HashUniformName(const char* name)
+    {
+        unsigned int hash = 2166136261u;
+        while (*name != '\0')
+        {
+            hash ^= (unsigned char)(*name++);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+}
+
+/***********************************************************
+ *  ReflectUniforms()
+ *
+ *  This method is called after linking to record the
+ *  location of every active uniform in the program.
+ ***********************************************************/
+void ShaderManager::ReflectUniforms(GLuint programID)
+{
+    m_uniforms.clear();
+
+    GLint uniformCount = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    if (maxNameLength <= 0)
+    {
+        return;
+    }
+
+    std::vector<char> nameBuffer(maxNameLength + 1);
+    for (GLint i = 0; i < uniformCount; i++)
+    {
+        GLsizei nameLength = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(programID, (GLuint)i, maxNameLength, &nameLength, &size, &type, &nameBuffer[0]);
+
+        std::string name(&nameBuffer[0], nameLength);
+        GLint location = glGetUniformLocation(programID, name.c_str());
+        // members of uniform blocks have no location
+        if (location < 0)
+        {
+            continue;
+        }
+
+        // arrays of basic types are reported once as "name[0]",
+        // so add an entry for each element and for the bare name,
+        // which the array setters use
+        size_t arraySuffix = name.rfind("[0]");
+        if ((arraySuffix != std::string::npos) && (arraySuffix + 3 == name.size()))
+        {
+            std::string baseName = name.substr(0, arraySuffix);
+            AddUniform(baseName, location);
+            for (GLint element = 0; element < size; element++)
+            {
+                std::string elementName = baseName + "[" + std::to_string(element) + "]";
+                AddUniform(elementName, glGetUniformLocation(programID, elementName.c_str()));
+            }
+        }
+        else
+        {
+            AddUniform(name, location);
+        }
+    }
+
+    std::sort(m_uniforms.begin(), m_uniforms.end(),
+        [](const UNIFORM_INFO& a, const UNIFORM_INFO& b) { return a.hash < b.hash; });
+}
+
+/***********************************************************
+ *  AddUniform()
+ *
+ *  This method is called to add a uniform to the lookup table.
+ ***********************************************************/
+void ShaderManager::AddUniform(const std::string& name, GLint location)
+{
+    UNIFORM_INFO uniform;
+    uniform.name = name;
+    uniform.hash = HashUniformName(name.c_str());
+    uniform.location = location;
+    uniform.bHasValue = false;
+    memset(uniform.value, 0, sizeof(uniform.value));
+    m_uniforms.push_back(uniform);
+}
+
+/***********************************************************
+ *  FindUniform()
+ *
+ *  This method is called to find an active uniform by name
+ *  without building any temporary strings.
+ ***********************************************************/
+ShaderManager::UNIFORM_INFO* ShaderManager::FindUniform(const char* name) const
+{
+    unsigned int hash = HashUniformName(name);
+
+    std::vector<UNIFORM_INFO>::iterator it = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), hash,
+        [](const UNIFORM_INFO& uniform, unsigned int value) { return uniform.hash < value; });
+
+    while ((it != m_uniforms.end()) && (it->hash == hash))
+    {
+        if (strcmp(it->name.c_str(), name) == 0)
+        {
+            return &(*it);
+        }
+        ++it;
+    }
+
+    return NULL;
+}
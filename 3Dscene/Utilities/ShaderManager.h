@@ -11,11 +11,15 @@
 
 #include <GL/glew.h>        // GLEW library
 
+#include "GLStateCache.h"
+
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <string>
+#include <vector>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -27,86 +31,196 @@ public:
 	
 	GLuint LoadShaders(
 		const char* vertex_file_path, 
-		const char* fragment_file_path);
+		const char* fragment_file_path,
+		const char* preamble = NULL,
+		const char* geometry_file_path = NULL);
 
 	// activate the shader
 	// ------------------------------------------------------------------------
 	inline void use()
 	{
-		glUseProgram(m_programID);
+		GLStateCache::Get().UseProgram(m_programID);
 	}
 
 	// utility uniform functions
 	// ------------------------------------------------------------------------
-	inline void setBoolValue(const std::string &name, bool value) const
+	inline void setBoolValue(const char* name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), (int)value);
+		setIntValue(name, (int)value);
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setIntValue(const std::string &name, int value) const
+	inline void setIntValue(const char* name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), value);
+		UNIFORM_INFO* uniform = FindUniform(name);
+		if (UpdateUniformValue(uniform, &value, sizeof(value)))
+		{
+			glUniform1i(uniform->location, value);
+		}
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setFloatValue(const std::string &name, float value) const
+	inline void setFloatValue(const char* name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(m_programID, name.c_str()), value);
+		UNIFORM_INFO* uniform = FindUniform(name);
+		if (UpdateUniformValue(uniform, &value, sizeof(value)))
+		{
+			glUniform1f(uniform->location, value);
+		}
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setVec2Value(const std::string &name, const glm::vec2 &value) const
+	inline void setVec2Value(const char* name, const glm::vec2 &value) const
 	{
-		glUniform2fv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+		UNIFORM_INFO* uniform = FindUniform(name);
+		if (UpdateUniformValue(uniform, &value[0], sizeof(value)))
+		{
+			glUniform2fv(uniform->location, 1, &value[0]);
+		}
 	}
 
-	inline void setVec2Value(const std::string &name, float x, float y) const
+	inline void setVec2Value(const char* name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(m_programID, name.c_str()), x, y);
+		setVec2Value(name, glm::vec2(x, y));
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setVec3Value(const std::string &name, const glm::vec3 &value) const
+	inline void setVec3Value(const char* name, const glm::vec3 &value) const
+	{
+		UNIFORM_INFO* uniform = FindUniform(name);
+		if (UpdateUniformValue(uniform, &value[0], sizeof(value)))
+		{
+			glUniform3fv(uniform->location, 1, &value[0]);
+		}
+	}
+	inline void setVec3Value(const char* name, float x, float y, float z) const
+	{
+		setVec3Value(name, glm::vec3(x, y, z));
+	}
+
+	// ------------------------------------------------------------------------
+	inline void setVec4Value(const char* name, const glm::vec4 &value) const
+	{
+		UNIFORM_INFO* uniform = FindUniform(name);
+		if (UpdateUniformValue(uniform, &value[0], sizeof(value)))
+		{
+			glUniform4fv(uniform->location, 1, &value[0]);
+		}
+	}
+	inline void setVec4Value(const char* name, float x, float y, float z, float w)
 	{
-		glUniform3fv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+		setVec4Value(name, glm::vec4(x, y, z, w));
 	}
-	inline void setVec3Value(const std::string &name, float x, float y, float z) const
+
+	// ------------------------------------------------------------------------
+	inline void setMat2Value(const char* name, const glm::mat2 &mat) const
 	{
-		glUniform3f(glGetUniformLocation(m_programID, name.c_str()), x, y, z);
+		UNIFORM_INFO* uniform = FindUniform(name);
+		if (UpdateUniformValue(uniform, &mat[0][0], sizeof(mat)))
+		{
+			glUniformMatrix2fv(uniform->location, 1, GL_FALSE, &mat[0][0]);
+		}
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setVec4Value(const std::string &name, const glm::vec4 &value) const
+	inline void setMat3Value(const char* name, const glm::mat3 &mat) const
 	{
-		glUniform4fv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+		UNIFORM_INFO* uniform = FindUniform(name);
+		if (UpdateUniformValue(uniform, &mat[0][0], sizeof(mat)))
+		{
+			glUniformMatrix3fv(uniform->location, 1, GL_FALSE, &mat[0][0]);
+		}
 	}
-	inline void setVec4Value(const std::string &name, float x, float y, float z, float w)
+
+	// ------------------------------------------------------------------------
+	inline void setMat4Value(const char* name, const glm::mat4 &mat) const
 	{
-		glUniform4f(glGetUniformLocation(m_programID, name.c_str()), x, y, z, w);
+		UNIFORM_INFO* uniform = FindUniform(name);
+		if (UpdateUniformValue(uniform, glm::value_ptr(mat), sizeof(mat)))
+		{
+			glUniformMatrix4fv(uniform->location, 1, GL_FALSE, glm::value_ptr(mat));
+		}
 	}
 
+	// whole arrays, uploaded with one call through the location
+	// of element [0]; the values are not compared with the last
+	// ones, so the elements of an array set this way shouldn't
+	// also be set one at a time
 	// ------------------------------------------------------------------------
-	inline void setMat2Value(const std::string &name, const glm::mat2 &mat) const
+	inline void setIntArrayValue(const char* name, const int* values, int count) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(m_programID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		UNIFORM_INFO* uniform = FindUniform(name);
+		if ((uniform != NULL) && (count > 0))
+		{
+			glUniform1iv(uniform->location, count, values);
+		}
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setMat3Value(const std::string &name, const glm::mat3 &mat) const
+	inline void setFloatArrayValue(const char* name, const float* values, int count) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(m_programID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		UNIFORM_INFO* uniform = FindUniform(name);
+		if ((uniform != NULL) && (count > 0))
+		{
+			glUniform1fv(uniform->location, count, values);
+		}
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setMat4Value(const std::string &name, const glm::mat4 &mat) const
+	inline void setMat4ArrayValue(const char* name, const glm::mat4* values, int count) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(m_programID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+		UNIFORM_INFO* uniform = FindUniform(name);
+		if ((uniform != NULL) && (count > 0))
+		{
+			glUniformMatrix4fv(uniform->location, count, GL_FALSE, glm::value_ptr(values[0]));
+		}
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setSampler2DValue(const std::string& name, const int &value) const
+	inline void setSampler2DValue(const char* name, const int &value) const
+	{
+		setIntValue(name, value);
+	}
+
+	// attach a uniform block to a buffer binding point, returning
+	// the block size in bytes, or -1 if the block is not active
+	GLint setUniformBlockBinding(const char* name, GLuint bindingPoint) const;
+
+private:
+	// an active uniform reflected from the linked program, along
+	// with a copy of the last value that was uploaded to it
+	struct UNIFORM_INFO
+	{
+		std::string name;
+		unsigned int hash;
+		GLint location;
+		bool bHasValue;
+		unsigned char value[sizeof(glm::mat4)];
+	};
+
+	// active uniforms sorted by name hash
+	mutable std::vector<UNIFORM_INFO> m_uniforms;
+
+	// build the uniform table for a newly linked program
+	void ReflectUniforms(GLuint programID);
+	void AddUniform(const std::string& name, GLint location);
+	// find an active uniform by name, or NULL if it is not active
+	UNIFORM_INFO* FindUniform(const char* name) const;
+
+	// record a new uniform value, returning false when nothing
+	// needs to be uploaded because the value has not changed
+	inline bool UpdateUniformValue(UNIFORM_INFO* uniform, const void* value, size_t size) const
 	{
-		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), value);
+		if (uniform == NULL)
+		{
+			return(false);
+		}
+		if (uniform->bHasValue && (memcmp(uniform->value, value, size) == 0))
+		{
+			return(false);
+		}
+		memcpy(uniform->value, value, size);
+		uniform->bHasValue = true;
+		return(true);
 	}
 };
\ No newline at end of file
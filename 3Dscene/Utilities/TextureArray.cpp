@@ -0,0 +1,225 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturearray.cpp
+// ============
+// loads every scene texture into the layers of one GL_TEXTURE_2D_ARRAY,
+// resized to a shared layer size, so draws pick a layer instead of a unit
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureArray.h"
+#include "GLStateCache.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    // channels of every layer
+    const int g_Channels = 4;
+    // largest width or height of a layer; bigger images are scaled down
+    const int g_MaxLayerSize = 1024;
+
+    /***********************************************************
+     *  ResizeImage()
+     *
+     *  Scales an image to a new size with bilinear filtering.
+     *  The texture coordinates keep mapping to the same part
+     *  of the image, whatever its new aspect ratio.
+     ***********************************************************/
+    void ResizeImage(
+        const std::vector<unsigned char>& source, int sourceWidth, int sourceHeight,
+        std::vector<unsigned char>& target, int targetWidth, int targetHeight)
+    {
+        target.resize((size_t)targetWidth * targetHeight * g_Channels);
+
+        if ((sourceWidth == targetWidth) && (sourceHeight == targetHeight))
+        {
+            std::memcpy(target.data(), source.data(), target.size());
+            return;
+        }
+
+        for (int y = 0; y < targetHeight; y++)
+        {
+            float sourceY = ((y + 0.5f) * sourceHeight / targetHeight) - 0.5f;
+            sourceY = std::max(0.0f, std::min(sourceY, (float)(sourceHeight - 1)));
+            int y0 = (int)sourceY;
+            int y1 = std::min(y0 + 1, sourceHeight - 1);
+            float fy = sourceY - y0;
+
+            for (int x = 0; x < targetWidth; x++)
+            {
+                float sourceX = ((x + 0.5f) * sourceWidth / targetWidth) - 0.5f;
+                sourceX = std::max(0.0f, std::min(sourceX, (float)(sourceWidth - 1)));
+                int x0 = (int)sourceX;
+                int x1 = std::min(x0 + 1, sourceWidth - 1);
+                float fx = sourceX - x0;
+
+                for (int c = 0; c < g_Channels; c++)
+                {
+                    float top = source[((size_t)y0 * sourceWidth + x0) * g_Channels + c] * (1.0f - fx) +
+                        source[((size_t)y0 * sourceWidth + x1) * g_Channels + c] * fx;
+                    float bottom = source[((size_t)y1 * sourceWidth + x0) * g_Channels + c] * (1.0f - fx) +
+                        source[((size_t)y1 * sourceWidth + x1) * g_Channels + c] * fx;
+                    target[((size_t)y * targetWidth + x) * g_Channels + c] =
+                        (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+                }
+            }
+        }
+    }
+}
+
+/***********************************************************
+ *  TextureArray()
+ *
+ *  The constructor for the class.
+ ***********************************************************/
+TextureArray::TextureArray()
+{
+    m_texture = 0;
+}
+
+/***********************************************************
+ *  ~TextureArray()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+TextureArray::~TextureArray()
+{
+    if (m_texture != 0)
+    {
+        GLStateCache::Get().ForgetTexture(m_texture);
+        glDeleteTextures(1, &m_texture);
+    }
+}
+
+/***********************************************************
+ *  AddImage()
+ *
+ *  This method is called to load an image file as the next
+ *  layer of the array. Loading a tag a second time keeps
+ *  the first image.
+ ***********************************************************/
+bool TextureArray::AddImage(const char* filename, std::string tag)
+{
+    if (m_layers.find(tag) != m_layers.end())
+    {
+        std::cout << "Texture " << tag << " is already loaded, skipping " << filename << std::endl;
+        return true;
+    }
+
+    int width = 0;
+    int height = 0;
+    int colorChannels = 0;
+
+    // images are stored bottom row first, as OpenGL expects
+    stbi_set_flip_vertically_on_load(true);
+
+    // every image is expanded to four channels, so all
+    // the layers can share one format
+    unsigned char* image = stbi_load(filename, &width, &height, &colorChannels, g_Channels);
+    if (image == NULL)
+    {
+        std::cout << "Could not load image:" << filename << std::endl;
+        return false;
+    }
+
+    std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
+
+    IMAGE loaded;
+    loaded.width = width;
+    loaded.height = height;
+    loaded.pixels.assign(image, image + (size_t)width * height * g_Channels);
+    stbi_image_free(image);
+
+    m_layers[tag] = (int)m_images.size();
+    m_images.push_back(loaded);
+
+    return true;
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is called to copy the loaded images into
+ *  the texture array. The layer size is the largest width
+ *  and height of the images, up to g_MaxLayerSize, and
+ *  the other images are scaled to fit.
+ ***********************************************************/
+void TextureArray::Upload()
+{
+    if (m_images.empty())
+    {
+        return;
+    }
+
+    int layerWidth = 1;
+    int layerHeight = 1;
+    for (size_t i = 0; i < m_images.size(); i++)
+    {
+        layerWidth = std::max(layerWidth, std::min(m_images[i].width, g_MaxLayerSize));
+        layerHeight = std::max(layerHeight, std::min(m_images[i].height, g_MaxLayerSize));
+    }
+
+    if (m_texture == 0)
+    {
+        glGenTextures(1, &m_texture);
+    }
+    GLStateCache::Get().BindTexture(0, GL_TEXTURE_2D_ARRAY, m_texture);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerWidth, layerHeight, (GLsizei)m_images.size(),
+        0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    std::vector<unsigned char> layer;
+    for (size_t i = 0; i < m_images.size(); i++)
+    {
+        ResizeImage(m_images[i].pixels, m_images[i].width, m_images[i].height, layer, layerWidth, layerHeight);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)i, layerWidth, layerHeight, 1,
+            GL_RGBA, GL_UNSIGNED_BYTE, layer.data());
+    }
+
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+    std::cout << "Texture array: " << m_images.size() << " layers of " << layerWidth << "x" << layerHeight << std::endl;
+
+    // the pixels now live on the GPU, only their sizes are kept
+    for (size_t i = 0; i < m_images.size(); i++)
+    {
+        std::vector<unsigned char>().swap(m_images[i].pixels);
+    }
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is called to bind the texture array to a
+ *  texture unit.
+ ***********************************************************/
+void TextureArray::Bind(GLuint unit) const
+{
+    GLStateCache::Get().BindTexture(unit, GL_TEXTURE_2D_ARRAY, m_texture);
+}
+
+/***********************************************************
+ *  FindLayer()
+ *
+ *  This method is called to find the layer holding the
+ *  image loaded with a tag.
+ ***********************************************************/
+int TextureArray::FindLayer(std::string tag) const
+{
+    std::map<std::string, int>::const_iterator found = m_layers.find(tag);
+    if (found == m_layers.end())
+    {
+        return -1;
+    }
+    return found->second;
+}
@@ -0,0 +1,52 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturearray.h
+// ============
+// loads every scene texture into the layers of one GL_TEXTURE_2D_ARRAY,
+// resized to a shared layer size, so draws pick a layer instead of a unit
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+
+#include <map>
+#include <string>
+#include <vector>
+
+class TextureArray
+{
+public:
+	// constructor
+	TextureArray();
+	// destructor
+	~TextureArray();
+
+	// load an image file as the next layer, returning false
+	// when it can't be read
+	bool AddImage(const char* filename, std::string tag);
+	// resize the loaded images to one layer size and copy
+	// them into the texture array
+	void Upload();
+	// bind the texture array to a texture unit
+	void Bind(GLuint unit) const;
+
+	// find the layer of a loaded image, or -1
+	int FindLayer(std::string tag) const;
+	int GetLayerCount() const { return (int)m_images.size(); }
+
+private:
+	// an image waiting to be uploaded, always with four channels
+	struct IMAGE
+	{
+		int width;
+		int height;
+		std::vector<unsigned char> pixels;
+	};
+
+	GLuint m_texture;
+	std::vector<IMAGE> m_images;
+	// layer indices by tag
+	std::map<std::string, int> m_layers;
+};
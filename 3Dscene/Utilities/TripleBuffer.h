@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+// triplebuffer.h
+// ============
+// hands values from one thread to another without locks; the writer fills
+// one copy while the reader holds another, and the third sits between them
+// holding the latest value
+//
+//  Created for CS-330-Computational Graphics and Visualization
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer
+{
+public:
+	// constructor
+	TripleBuffer()
+		: m_write(0), m_read(1), m_shared(2)
+	{
+	}
+
+	// writer: the copy to fill before calling Publish(); it holds
+	// whatever was last written into it, not the latest value
+	T& GetWriteBuffer() { return m_buffers[m_write]; }
+
+	// writer: make the filled copy the latest value, replacing
+	// the previous one if the reader never took it
+	void Publish()
+	{
+		int previous = m_shared.exchange(m_write | FRESH_BIT, std::memory_order_acq_rel);
+		m_write = previous & INDEX_MASK;
+	}
+
+	// writer: whether the reader has taken the last published value
+	bool IsConsumed() const
+	{
+		return (m_shared.load(std::memory_order_acquire) & FRESH_BIT) == 0;
+	}
+
+	// reader: take the latest value if one was published since
+	// the last call, returning false when there is nothing new
+	bool Acquire()
+	{
+		if ((m_shared.load(std::memory_order_acquire) & FRESH_BIT) == 0)
+		{
+			return false;
+		}
+
+		int previous = m_shared.exchange(m_read, std::memory_order_acq_rel);
+		m_read = previous & INDEX_MASK;
+		return true;
+	}
+
+	// reader: the value taken by the last successful Acquire()
+	const T& GetReadBuffer() const { return m_buffers[m_read]; }
+
+private:
+	// the shared index holds a copy number and whether the copy
+	// was published since the reader last took one
+	static const int INDEX_MASK = 3;
+	static const int FRESH_BIT = 4;
+
+	T m_buffers[3];
+	// copies owned by the writer and by the reader
+	int m_write;
+	int m_read;
+	// the copy between them
+	std::atomic<int> m_shared;
+};
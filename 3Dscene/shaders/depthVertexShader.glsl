@@ -0,0 +1,46 @@
+#version 330 core
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 3) in mat4 inInstanceModel;  // per-instance model matrix (locations 3 - 6)
+
+uniform mat4 model;
+uniform mat4 lightSpaceMatrix;  // identity for the point light pass, whose geometry shader projects
+uniform bool bUseInstancing = false;
+
+// the application defines USE_MULTI_DRAW, along with a newer
+// #version, in the shader preamble when the context supports it
+#ifdef USE_MULTI_DRAW
+// per-draw values laid out for std430, mirroring DRAW_DATA in MultiDrawList.h
+struct DrawData {
+    mat4 model;
+    vec4 color;
+    vec2 uvScale;
+    int materialIndex;
+    int textureLayer;
+    int flags;
+    float tintIntensity;
+};
+
+// the draws recorded for the frame, shared with the main pass
+layout (std430, binding = 0) readonly buffer DrawBlock {
+    DrawData draws[];
+};
+
+uniform bool bUseMultiDraw = false;  // take the model matrix from the draw list
+uniform int drawBase = 0;  // draw list index of the first draw in the call
+#endif
+
+// depth only - transforms the scene into the light's view for the shadow map
+void main()
+{
+    mat4 modelMatrix = bUseInstancing ? inInstanceModel : model;
+
+#ifdef USE_MULTI_DRAW
+    if (bUseMultiDraw)
+    {
+        // gl_DrawID counts the draws of the current call from zero
+        modelMatrix = draws[drawBase + gl_DrawID].model;
+    }
+#endif
+
+    gl_Position = lightSpaceMatrix * modelMatrix * vec4(inVertexPosition, 1.0f);
+}
@@ -4,34 +4,61 @@ out vec4 fragmentColor;
 in vec3 fragmentPosition;
 in vec3 fragmentVertexNormal;
 in vec2 fragmentTextureCoordinate;
-in vec4 FragPosLightSpace;
-
+in float fragmentViewDepth;
+flat in vec4 fragmentObjectColor;
+flat in int fragmentMaterialIndex;
+flat in int fragmentDrawFlags;
+flat in vec2 fragmentUVScale;
+flat in float fragmentTintIntensity;
+flat in int fragmentTextureLayer;
+
+// laid out for std140, mirroring MATERIAL_DATA in SceneManager.h
 struct Material {
     vec3 diffuseColor;
-    vec3 specularColor;
     float shininess;
+    vec3 specularColor;
     vec3 emissiveColor; // Include emissive color
 };
 
+// the application defines the table size in the shader preamble
+#ifndef MAX_MATERIALS
+#define MAX_MATERIALS 256
+#endif
+
+// the application defines the shadow cascade count and the PCF
+// kernel's fetches per side in the shader preamble
+#ifndef SHADOW_CASCADES
+#define SHADOW_CASCADES 3
+#endif
+#ifndef SHADOW_FILTER_SIZE
+#define SHADOW_FILTER_SIZE 2
+#endif
+
+// every defined material, written once at startup
+layout (std140) uniform MaterialBlock {
+    Material materials[MAX_MATERIALS];
+};
+
+// the light structures are laid out for std140 and mirror the
+// LIGHT_BLOCK structure in SceneManager.h, so the order of the
+// members matters
 struct DirectionalLight {
     vec3 direction;
-    
+    bool bActive;
+
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
-
-    bool bActive;
 };
 
 struct PointLight {
     vec3 position;
-    
     float constant;
-    float linear;
-    float quadratic;
-    
+
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 
     bool bActive;
@@ -39,51 +66,73 @@ struct PointLight {
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
     float cutOff;
+    vec3 direction;
     float outerCutOff;
   
+    vec3 ambient;
     float constant;
+    vec3 diffuse;
     float linear;
+    vec3 specular;
     float quadratic;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;       
 
     bool bActive;
 };
 
+// the application defines the light count in the shader preamble
+#ifndef TOTAL_POINT_LIGHTS
 #define TOTAL_POINT_LIGHTS 4
+#endif
+
+// every light, updated by the application with one buffer write
+layout (std140) uniform LightBlock {
+    DirectionalLight directionalLight;
+    SpotLight spotLight;
+    PointLight pointLights[TOTAL_POINT_LIGHTS];
+};
 
-uniform bool bUseTexture = false;
-uniform bool bUseLighting = false;
-uniform vec4 objectColor = vec4(1.0f);
 uniform vec3 viewPosition;
-uniform DirectionalLight directionalLight;
-uniform PointLight pointLights[TOTAL_POINT_LIGHTS];
-uniform SpotLight spotLight;
-uniform Material material;
-uniform sampler2D objectTexture;
-uniform sampler2D shadowMap;
-uniform vec2 UVscale = vec2(1.0f, 1.0f);
-uniform float tintIntensity = 0.0; // Default to no tint
+
+// the drawing state of the current fragment, passed on by the
+// vertex shader so it can come from uniforms or the draw list
+Material material;
+bool bUseTexture;
+bool bUseLighting;
+vec2 UVscale;
+float tintIntensity;
+int textureLayer;
+// every scene texture, one per layer
+uniform sampler2DArray objectTextures;
+uniform sampler2DArrayShadow shadowMap;  // one layer per shadow cascade, compared by the texture unit
+uniform mat4 cascadeMatrices[SHADOW_CASCADES];  // light view and projection of each cascade
+uniform float cascadeSplits[SHADOW_CASCADES];  // view space depth where each cascade ends
+uniform sampler2DArrayShadow pointShadowMaps;  // six layers per point light, one per cube face
+uniform mat4 pointShadowMatrices[TOTAL_POINT_LIGHTS * 6];  // view and projection of each cube face
+uniform int pointShadowMask = 0;  // bit set for each point light whose cube shadows are ready
 uniform vec3 tintColor = vec3(0.0, 0.0, 0.0); // Tint color (default to black)
 
 // function prototypes
 vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-float ShadowCalculation(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir, out vec3 projCoords);
+float ShadowCalculation(vec3 fragPos, float viewDepth, vec3 normal, vec3 lightDir, out vec3 projCoords);
+float PointShadowCalculation(int lightIndex, vec3 fragPos);
+vec4 SampleObjectTexture(vec2 uv);
 
 void main()
 {    
+    material = materials[fragmentMaterialIndex];
+    bUseTexture = (fragmentDrawFlags & 1) != 0;
+    bUseLighting = (fragmentDrawFlags & 2) != 0;
+    UVscale = fragmentUVScale;
+    tintIntensity = fragmentTintIntensity;
+    textureLayer = fragmentTextureLayer;
+
     vec4 finalColor;
     vec3 projCoords;  // Declare projCoords in main function scope
     float shadow = 0.0;  // Declare and initialize shadow variable
 
-    vec3 lightDir = normalize(directionalLight.direction); // Assuming directionalLight is your main light source
-
     if (bUseLighting == true)
     {
         vec3 phongResult = vec3(0.0f);
@@ -99,7 +148,11 @@ void main()
         // phase 2: point lights
         for (int i = 0; i < TOTAL_POINT_LIGHTS; i++) {
             if (pointLights[i].bActive) {
-                phongResult += CalcPointLight(pointLights[i], norm, fragmentPosition, viewDir);
+                float pointShadow = 0.0;
+                if ((pointShadowMask & (1 << i)) != 0) {
+                    pointShadow = PointShadowCalculation(i, fragmentPosition);
+                }
+                phongResult += CalcPointLight(pointLights[i], norm, fragmentPosition, viewDir, pointShadow);
             }
         }
         // phase 3: spot light
@@ -108,20 +161,22 @@ void main()
             phongResult += CalcSpotLight(spotLight, norm, fragmentPosition, viewDir);    
         }
 
-        // Calculate shadow
-        shadow = ShadowCalculation(FragPosLightSpace, fragmentVertexNormal, lightDir, projCoords);
+        // Calculate shadow, which the spot light casts; the slope
+        // bias uses the direction toward it
+        vec3 lightDir = normalize(spotLight.position - fragmentPosition);
+        shadow = ShadowCalculation(fragmentPosition, fragmentViewDepth, norm, lightDir, projCoords);
 
         vec3 emissive = material.emissiveColor; // Get emissive color
 
         if (bUseTexture)
         {
-            vec4 textureColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+            vec4 textureColor = SampleObjectTexture(fragmentTextureCoordinate * UVscale);
             vec3 tintedTextureColor = mix(textureColor.rgb, tintColor, tintIntensity); // Apply tint
             finalColor = vec4(phongResult * tintedTextureColor * (1.0 - shadow) + emissive, textureColor.a);
         }
         else
         {
-            finalColor = vec4(phongResult * objectColor.rgb * (1.0 - shadow) + emissive, objectColor.a);
+            finalColor = vec4(phongResult * fragmentObjectColor.rgb * (1.0 - shadow) + emissive, fragmentObjectColor.a);
         }
     }
     else
@@ -130,13 +185,13 @@ void main()
 
         if (bUseTexture)
         {
-            vec4 textureColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+            vec4 textureColor = SampleObjectTexture(fragmentTextureCoordinate * UVscale);
             vec3 tintedTextureColor = mix(textureColor.rgb, tintColor, tintIntensity); // Apply tint
             finalColor = vec4(tintedTextureColor + emissive, textureColor.a);
         }
         else
         {
-            finalColor = vec4(objectColor.rgb + emissive, objectColor.a);
+            finalColor = vec4(fragmentObjectColor.rgb + emissive, fragmentObjectColor.a);
         }
 
         shadow = 0.0;  // Set shadow to 0 if lighting is not used
@@ -161,8 +216,8 @@ vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir)
     // combine results
     if (bUseTexture == true)
     {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
+        ambient = light.ambient * vec3(SampleObjectTexture(fragmentTextureCoordinate));
+        diffuse = light.diffuse * diff * material.diffuseColor * vec3(SampleObjectTexture(fragmentTextureCoordinate));
     }
     else
     {
@@ -173,8 +228,9 @@ vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir)
     return (ambient + diffuse + specular);
 }
 
-// calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+// calculates the color when using a point light; shadow only
+// takes away the diffuse and specular light
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow)
 {
     vec3 ambient = vec3(0.0f);
     vec3 diffuse = vec3(0.0f);
@@ -194,8 +250,8 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
         // combine results
         if (bUseTexture == true)
         {
-            ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-            diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
+            ambient = light.ambient * vec3(SampleObjectTexture(fragmentTextureCoordinate));
+            diffuse = light.diffuse * diff * material.diffuseColor * vec3(SampleObjectTexture(fragmentTextureCoordinate));
         }
         else
         {
@@ -207,7 +263,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
         diffuse *= attenuation;
         specular *= attenuation;
     }
-    return (ambient + diffuse + specular);
+    return (ambient + (diffuse + specular) * (1.0 - shadow));
 }
 
 // calculates the color when using a spot light.
@@ -233,8 +289,8 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // combine results
     if (bUseTexture == true)
     {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
+        ambient = light.ambient * vec3(SampleObjectTexture(fragmentTextureCoordinate));
+        diffuse = light.diffuse * diff * material.diffuseColor * vec3(SampleObjectTexture(fragmentTextureCoordinate));
     }
     else
     {
@@ -248,9 +304,29 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     return (ambient + diffuse + specular);
 }
 
+// samples the object's layer of the texture array
+vec4 SampleObjectTexture(vec2 uv)
+{
+    return texture(objectTextures, vec3(uv, float(textureLayer)));
+}
+
 // Shadow calculation function
-float ShadowCalculation(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir, out vec3 projCoords)
+float ShadowCalculation(vec3 fragPos, float viewDepth, vec3 normal, vec3 lightDir, out vec3 projCoords)
 {
+    // the nearest cascade reaching past the fragment has the
+    // most detail; past the last one there is no shadow
+    int cascade = 0;
+    while ((cascade < SHADOW_CASCADES) && (viewDepth > cascadeSplits[cascade]))
+    {
+        cascade++;
+    }
+    if (cascade == SHADOW_CASCADES)
+    {
+        projCoords = vec3(0.0);
+        return 0.0;
+    }
+
+    vec4 fragPosLightSpace = cascadeMatrices[cascade] * vec4(fragPos, 1.0);
     projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     projCoords = projCoords * 0.5 + 0.5;
 
@@ -259,18 +335,55 @@ float ShadowCalculation(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir, out
 
     float bias = max(0.005 * (1.0 - dot(normal, lightDir)), 0.005);
 
+    // each fetch compares the four nearest texels and blends
+    // the results, so the fetches are spaced a texel apart
     float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float kernelOffset = float(SHADOW_FILTER_SIZE - 1) * 0.5;
 
-    for (int x = -1; x <= 1; ++x)
+    for (int x = 0; x < SHADOW_FILTER_SIZE; ++x)
     {
-        for (int y = -1; y <= 1; ++y)
+        for (int y = 0; y < SHADOW_FILTER_SIZE; ++y)
         {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r;
-            shadow += projCoords.z - bias > pcfDepth ? 1.0 : 0.0;
+            vec2 offset = (vec2(x, y) - kernelOffset) * texelSize;
+            // the fraction of the texels the fragment is in front of
+            float lit = texture(shadowMap, vec4(projCoords.xy + offset, float(cascade), projCoords.z - bias));
+            shadow += 1.0 - lit;
         }
     }
-    shadow /= 9.0;
+    shadow /= float(SHADOW_FILTER_SIZE * SHADOW_FILTER_SIZE);
+
+    return shadow;
+}
+
+// Point light shadow calculation function
+float PointShadowCalculation(int lightIndex, vec3 fragPos)
+{
+    // the face is the one looking along the major axis of the
+    // direction from the light, in the order +X, -X, +Y, -Y, +Z, -Z
+    vec3 toFragment = fragPos - pointLights[lightIndex].position;
+    vec3 absolute = abs(toFragment);
+    int face;
+    if ((absolute.x >= absolute.y) && (absolute.x >= absolute.z))
+        face = (toFragment.x > 0.0) ? 0 : 1;
+    else if (absolute.y >= absolute.z)
+        face = (toFragment.y > 0.0) ? 2 : 3;
+    else
+        face = (toFragment.z > 0.0) ? 4 : 5;
+
+    // moving the fragment a little toward the light is the bias,
+    // which holds up better than a depth offset under the
+    // perspective of the faces
+    int layer = lightIndex * 6 + face;
+    vec3 biasedPos = fragPos - toFragment * 0.02;
+    vec4 fragPosLightSpace = pointShadowMatrices[layer] * vec4(biasedPos, 1.0);
+    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+    projCoords = projCoords * 0.5 + 0.5;
+
+    if (projCoords.z > 1.0)
+        return 0.0;
 
-    return 0;
+    // a single fetch, which the texture unit already blends
+    // between the four nearest texels
+    return 1.0 - texture(pointShadowMaps, vec4(projCoords.xy, float(layer), projCoords.z));
 }
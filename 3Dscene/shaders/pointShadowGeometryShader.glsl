@@ -0,0 +1,54 @@
+#version 330 core
+// the application defines how many faces are rendered in one pass
+// in the shader preamble
+#ifndef POINT_SHADOW_FACE_BUDGET
+#define POINT_SHADOW_FACE_BUDGET 4
+#endif
+
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3 * POINT_SHADOW_FACE_BUDGET) out;
+
+// the vertex shader is given an identity lightSpaceMatrix, so
+// gl_in[].gl_Position holds the world space position
+
+uniform int faceCount = 0;  // faces being rendered in this pass
+uniform int faceLayers[POINT_SHADOW_FACE_BUDGET];  // shadow map layer of each face
+uniform mat4 faceMatrices[POINT_SHADOW_FACE_BUDGET];  // view and projection of each face
+
+// whether all three vertices are outside the same clip plane
+bool OutsideFace(vec4 a, vec4 b, vec4 c)
+{
+    return (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+        (a.x > a.w && b.x > b.w && c.x > c.w) ||
+        (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+        (a.y > a.w && b.y > b.w && c.y > c.w) ||
+        (a.z < -a.w && b.z < -b.w && c.z < -c.w) ||
+        (a.z > a.w && b.z > b.w && c.z > c.w);
+}
+
+void main()
+{
+    // every triangle is sent to each face it can land on, so
+    // the faces picked for the frame are drawn in one pass
+    for (int face = 0; face < faceCount; ++face)
+    {
+        vec4 a = faceMatrices[face] * gl_in[0].gl_Position;
+        vec4 b = faceMatrices[face] * gl_in[1].gl_Position;
+        vec4 c = faceMatrices[face] * gl_in[2].gl_Position;
+        if (OutsideFace(a, b, c))
+        {
+            continue;
+        }
+
+        gl_Layer = faceLayers[face];
+        gl_Position = a;
+        EmitVertex();
+        gl_Layer = faceLayers[face];
+        gl_Position = b;
+        EmitVertex();
+        gl_Layer = faceLayers[face];
+        gl_Position = c;
+        EmitVertex();
+        EndPrimitive();
+    }
+}
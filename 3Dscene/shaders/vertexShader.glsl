@@ -2,22 +2,95 @@
 layout (location = 0) in vec3 inVertexPosition;
 layout (location = 1) in vec3 inVertexNormal;
 layout (location = 2) in vec2 inTextureCoordinate;
+layout (location = 3) in mat4 inInstanceModel;  // per-instance model matrix (locations 3 - 6)
+layout (location = 7) in vec4 inInstanceColor;  // per-instance object color
+layout (location = 8) in int inInstanceMaterial;  // per-instance material table index
 
 out vec3 fragmentPosition;
 out vec3 fragmentVertexNormal;
 out vec2 fragmentTextureCoordinate;
-out vec4 FragPosLightSpace;  // Output for shadow mapping
+out float fragmentViewDepth;  // view space depth, picks the shadow cascade
+flat out vec4 fragmentObjectColor;
+flat out int fragmentMaterialIndex;
+flat out int fragmentDrawFlags;  // DRAW_USE_TEXTURE and DRAW_USE_LIGHTING bits
+flat out vec2 fragmentUVScale;
+flat out float fragmentTintIntensity;
+flat out int fragmentTextureLayer;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
-uniform mat4 lightSpaceMatrix;  // Uniform for light space matrix
+uniform vec4 objectColor = vec4(1.0f);
+uniform int materialIndex = 0;  // index into the material table
+uniform bool bUseInstancing = false;  // take the model matrix, color and material from the instance attributes
+uniform bool bUseTexture = false;
+uniform bool bUseLighting = false;
+uniform vec2 UVscale = vec2(1.0f, 1.0f);
+uniform float tintIntensity = 0.0; // Default to no tint
+uniform int textureLayer = 0;  // layer of the texture array
+
+// bits of the draw flags, mirroring DRAW_FLAGS in MultiDrawList.h
+const int DRAW_USE_TEXTURE = 1;
+const int DRAW_USE_LIGHTING = 2;
+
+// the application defines USE_MULTI_DRAW, along with a newer
+// #version, in the shader preamble when the context supports it
+#ifdef USE_MULTI_DRAW
+// per-draw values laid out for std430, mirroring DRAW_DATA in MultiDrawList.h
+struct DrawData {
+    mat4 model;
+    vec4 color;
+    vec2 uvScale;
+    int materialIndex;
+    int textureLayer;
+    int flags;
+    float tintIntensity;
+};
+
+// the values of every draw in the multi-draw list
+layout (std430, binding = 0) readonly buffer DrawBlock {
+    DrawData draws[];
+};
+
+uniform bool bUseMultiDraw = false;  // take every per-object value from the draw list
+uniform int drawBase = 0;  // draw list index of the first draw in the call
+#endif
 
 void main()
 {
-    fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
-    gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
+    mat4 modelMatrix = bUseInstancing ? inInstanceModel : model;
+    vec4 color = bUseInstancing ? inInstanceColor : objectColor;
+    int drawMaterial = bUseInstancing ? inInstanceMaterial : materialIndex;
+    int drawFlags = (bUseTexture ? DRAW_USE_TEXTURE : 0) | (bUseLighting ? DRAW_USE_LIGHTING : 0);
+    vec2 uvScale = UVscale;
+    float tint = tintIntensity;
+    int layer = textureLayer;
+
+#ifdef USE_MULTI_DRAW
+    if (bUseMultiDraw)
+    {
+        // gl_DrawID counts the draws of the current call from zero
+        DrawData draw = draws[drawBase + gl_DrawID];
+        modelMatrix = draw.model;
+        color = draw.color;
+        drawMaterial = draw.materialIndex;
+        drawFlags = draw.flags;
+        uvScale = draw.uvScale;
+        tint = draw.tintIntensity;
+        layer = draw.textureLayer;
+    }
+#endif
+
+    fragmentPosition = vec3(modelMatrix * vec4(inVertexPosition, 1.0));
+    vec4 viewSpacePosition = view * vec4(fragmentPosition, 1.0);
+    gl_Position = projection * viewSpacePosition;
     fragmentVertexNormal = inVertexNormal;
     fragmentTextureCoordinate = inTextureCoordinate;
-    FragPosLightSpace = lightSpaceMatrix * vec4(fragmentPosition, 1.0);  // Compute light space position
+    fragmentViewDepth = -viewSpacePosition.z;
+    fragmentObjectColor = color;
+    fragmentMaterialIndex = drawMaterial;
+    fragmentDrawFlags = drawFlags;
+    fragmentUVScale = uvScale;
+    fragmentTintIntensity = tint;
+    fragmentTextureLayer = layer;
 }